@@ -1,11 +1,53 @@
+// read() and ssize_t are POSIX, not C99.
+#define _POSIX_C_SOURCE 200809L
+
 #include "c_string.h"
 
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _MSC_VER
+#include <io.h>
+typedef int ssize_t;
+#define read(fd, buffer, count) _read((fd), (buffer), (unsigned int)(count))
+#else
+#include <unistd.h>
+#endif
+
+// Windows has no mmap; string_from_file_mmap reads the file instead.
+#if defined(_WIN32)
+#define CSTRING_HAVE_MMAP 0
+#else
+#define CSTRING_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Large UTF-8 buffers are validated on several threads where pthreads exist.
+#if defined(_WIN32)
+#define CSTRING_HAVE_THREADS 0
+#else
+#define CSTRING_HAVE_THREADS 1
+#include <pthread.h>
+#endif
+
+#include "c_string_case_tables.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CSTRING_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define CSTRING_X86_SIMD 0
+#endif
+
 // ANSI Escape Codes for colours
 #define ANSI_COLOR_RED "\x1b[31m"
 #define ANSI_COLOR_GREEN "\x1b[32m"
@@ -29,9 +71,11 @@ typedef struct {
 } Utf8Analysis;
 
 // Attempt to parse a single UTF-8 sequence starting at *index. Advances the
-// index on success.
-static bool consume_utf8_sequence(const char* data, size_t length,
-                                  size_t* index, size_t* sequence_length_out) {
+// index on success and optionally reports the sequence length and the decoded
+// code point.
+static bool decode_utf8_sequence(const char* data, size_t length,
+                                 size_t* index, size_t* sequence_length_out,
+                                 uint32_t* codepoint_out) {
   if (!data || !index || *index >= length) {
     return false;
   }
@@ -99,11 +143,19 @@ static bool consume_utf8_sequence(const char* data, size_t length,
   if (sequence_length_out) {
     *sequence_length_out = sequence_length;
   }
+  if (codepoint_out) {
+    *codepoint_out = codepoint;
+  }
   *index = i + sequence_length;
   return true;
 }
 
-static Utf8Analysis analyze_utf8(const char* data, size_t length) {
+static bool consume_utf8_sequence(const char* data, size_t length,
+                                  size_t* index, size_t* sequence_length_out) {
+  return decode_utf8_sequence(data, length, index, sequence_length_out, NULL);
+}
+
+static Utf8Analysis analyze_utf8_scalar(const char* data, size_t length) {
   Utf8Analysis result = {.valid = false, .codepoints = 0};
 
   if (!data) {
@@ -131,663 +183,7644 @@ static Utf8Analysis analyze_utf8(const char* data, size_t length) {
   return result;
 }
 
-static bool update_utf8_metadata(c_string* s) {
-  if (!s) {
-    return false;
+/* Vectorized UTF-8 Validation */
+
+// When false, analyze_utf8 always takes the scalar path. Tests and the fuzz
+// harness flip this to compare both implementations.
+static bool simd_enabled = true;
+
+void cstring_set_simd_enabled(bool enabled) { simd_enabled = enabled; }
+
+#if CSTRING_X86_SIMD
+
+// SSE2 is part of the x86-64 baseline: skip 16 ASCII bytes at a time and hand
+// any block containing a non-ASCII byte to the scalar decoder.
+static Utf8Analysis analyze_utf8_sse2(const char* data, size_t length) {
+  Utf8Analysis result = {.valid = false, .codepoints = 0};
+  size_t i = 0;
+  size_t codepoints = 0;
+
+  while (i + 16 <= length) {
+    __m128i block = _mm_loadu_si128((const __m128i*)(const void*)(data + i));
+    if (_mm_movemask_epi8(block) == 0) {
+      codepoints += 16;
+      i += 16;
+      continue;
+    }
+
+    // Decode until we are past this block; the last sequence may spill over.
+    size_t block_end = i + 16;
+    while (i < block_end) {
+      if (!consume_utf8_sequence(data, length, &i, NULL)) {
+        return result;
+      }
+      codepoints += 1;
+    }
   }
 
-  if (s->length == 0 || !s->string) {
-    // Zero-length strings are trivially valid and contain zero code points.
-    s->codepoint_length = 0;
-    s->utf8_valid = (s->length == 0);
-    return s->utf8_valid;
+  while (i < length) {
+    if (!consume_utf8_sequence(data, length, &i, NULL)) {
+      return result;
+    }
+    codepoints += 1;
   }
 
-  // Analyze once and cache the derived metadata on the string object.
-  Utf8Analysis analysis = analyze_utf8(s->string, s->length);
-  s->codepoint_length = analysis.codepoints;
-  s->utf8_valid = analysis.valid;
-  return analysis.valid;
+  result.valid = true;
+  result.codepoints = codepoints;
+  return result;
 }
 
-// Create string from an input
-void create_string(c_string* s, size_t length, char* input) {
-  s->length = length;
-  memcpy(s->string, input, s->length);
-  if (!update_utf8_metadata(s)) {
-    // Leave the string allocated but mark the metadata so callers can see the
-    // parse failed.
-    s->codepoint_length = 0;
-    s->utf8_valid = false;
+// Error classes for the lookup-table validator (Keiser & Lemire, "Validating
+// UTF-8 In Less Than One Instruction Per Byte"). Each table below flags the
+// errors a given nibble could take part in; an error survives only when all
+// three nibbles agree on it.
+#define UTF8_TOO_SHORT (1 << 0)    // lead byte not followed by a continuation
+#define UTF8_TOO_LONG (1 << 1)     // ASCII followed by a continuation
+#define UTF8_OVERLONG_3 (1 << 2)   // 1110_0000 100_____
+#define UTF8_TOO_LARGE (1 << 3)    // above U+10FFFF
+#define UTF8_SURROGATE (1 << 4)    // 1110_1101 101_____
+#define UTF8_OVERLONG_2 (1 << 5)   // 1100_000_ 10______
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4 (1 << 6)   // 1111_0000 1000____
+#define UTF8_TWO_CONTS (1 << 7)    // continuation without a lead byte
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#define UTF8_LOOKUP16(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+#define UTF8_B(x) ((char)(x))
+
+typedef struct {
+  __m256i error;
+  __m256i prev_input;
+  __m256i prev_incomplete;
+} Utf8Avx2State;
+
+__attribute__((target("avx2"))) static __m256i utf8_avx2_prev(__m256i input,
+                                                             __m256i prev,
+                                                             int n) {
+  __m256i shifted = _mm256_permute2x128_si256(prev, input, 0x21);
+  switch (n) {
+    case 1:
+      return _mm256_alignr_epi8(input, shifted, 15);
+    case 2:
+      return _mm256_alignr_epi8(input, shifted, 14);
+    default:
+      return _mm256_alignr_epi8(input, shifted, 13);
   }
 }
 
-// Initialize string buffer
-CStringResult initialize_buffer(size_t length) {
-  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+__attribute__((target("avx2"))) static __m256i utf8_avx2_high_nibble(
+    __m256i v) {
+  return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
 
-  c_string* data = calloc(1, sizeof(c_string));
-  if (!data) {
-    result.status = CSTRING_ERR_NO_MEMORY;
-    return result;
+__attribute__((target("avx2"))) static void utf8_avx2_check_block(
+    Utf8Avx2State* state, __m256i input) {
+  if (_mm256_movemask_epi8(input) == 0) {
+    // An ASCII block can only be wrong if the previous one ended mid-sequence.
+    state->error = _mm256_or_si256(state->error, state->prev_incomplete);
+    state->prev_incomplete = _mm256_setzero_si256();
+    state->prev_input = input;
+    return;
   }
 
-  data->length = length;
+  const __m256i byte_1_high = UTF8_LOOKUP16(
+      UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+      UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_B(UTF8_TWO_CONTS),
+      UTF8_B(UTF8_TWO_CONTS), UTF8_B(UTF8_TWO_CONTS), UTF8_B(UTF8_TWO_CONTS),
+      UTF8_TOO_SHORT | UTF8_OVERLONG_2, UTF8_TOO_SHORT,
+      UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+      UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4);
+  const __m256i byte_1_low = UTF8_LOOKUP16(
+      UTF8_B(UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4),
+      UTF8_B(UTF8_CARRY | UTF8_OVERLONG_2), UTF8_B(UTF8_CARRY),
+      UTF8_B(UTF8_CARRY), UTF8_B(UTF8_CARRY | UTF8_TOO_LARGE),
+      UTF8_B(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+      UTF8_B(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+      UTF8_B(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+      UTF8_B(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+      UTF8_B(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+      UTF8_B(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+      UTF8_B(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+      UTF8_B(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+      UTF8_B(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 |
+             UTF8_SURROGATE),
+      UTF8_B(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+      UTF8_B(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000));
+  const __m256i byte_2_high = UTF8_LOOKUP16(
+      UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+      UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+      UTF8_B(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+             UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4),
+      UTF8_B(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+             UTF8_OVERLONG_3 | UTF8_TOO_LARGE),
+      UTF8_B(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+             UTF8_SURROGATE | UTF8_TOO_LARGE),
+      UTF8_B(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+             UTF8_SURROGATE | UTF8_TOO_LARGE),
+      UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
 
-  if (length == 0) {
-    data->string = NULL;
-    data->codepoint_length = 0;
-    data->utf8_valid = true;
-    result.value = data;
-    return result;
-  }
+  __m256i prev1 = utf8_avx2_prev(input, state->prev_input, 1);
+  __m256i special = _mm256_and_si256(
+      _mm256_and_si256(
+          _mm256_shuffle_epi8(byte_1_high, utf8_avx2_high_nibble(prev1)),
+          _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(
+                                              prev1, _mm256_set1_epi8(0x0F)))),
+      _mm256_shuffle_epi8(byte_2_high, utf8_avx2_high_nibble(input)));
 
-  data->string = malloc(length);
-  if (!data->string) {
-    free(data);
-    result.status = CSTRING_ERR_NO_MEMORY;
-    return result;
-  }
+  // Third and fourth bytes of a sequence must be continuations; those are the
+  // only positions the two-byte check above cannot see.
+  __m256i prev2 = utf8_avx2_prev(input, state->prev_input, 2);
+  __m256i prev3 = utf8_avx2_prev(input, state->prev_input, 3);
+  __m256i must_be_continuation = _mm256_and_si256(
+      _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8(0x60)),
+                      _mm256_subs_epu8(prev3, _mm256_set1_epi8(0x70))),
+      _mm256_set1_epi8(UTF8_B(0x80)));
 
-  // Caller must write valid UTF-8 into the buffer before the metadata can be
-  // trusted.
-  data->codepoint_length = 0;
-  data->utf8_valid = false;
-  result.value = data;
-  return result;
+  state->error = _mm256_or_si256(
+      state->error, _mm256_xor_si256(must_be_continuation, special));
+
+  // A lead byte in the last three positions needs bytes from the next block.
+  const __m256i max_complete = _mm256_setr_epi8(
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, UTF8_B(0xF0 - 1),
+      UTF8_B(0xE0 - 1), UTF8_B(0xC0 - 1));
+  state->prev_incomplete = _mm256_subs_epu8(input, max_complete);
+  state->prev_input = input;
 }
 
-// Copy contents of a c_string into a new one ("Copy Constructor")
-CStringResult string_new(const c_string* s) {
-  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+// Code points are counted as bytes that are not continuation bytes, which is
+// exact once the whole buffer is known to be valid.
+__attribute__((target("avx2"))) static unsigned int utf8_avx2_lead_mask(
+    __m256i input) {
+  return (unsigned int)_mm256_movemask_epi8(
+      _mm256_cmpgt_epi8(input, _mm256_set1_epi8(-65)));
+}
 
-  if (!s) {
-    result.status = CSTRING_ERR_INVALID_ARG;
-    return result;
+__attribute__((target("avx2"))) static Utf8Analysis analyze_utf8_avx2(
+    const char* data, size_t length) {
+  Utf8Analysis result = {.valid = false, .codepoints = 0};
+  Utf8Avx2State state = {.error = _mm256_setzero_si256(),
+                         .prev_input = _mm256_setzero_si256(),
+                         .prev_incomplete = _mm256_setzero_si256()};
+  size_t codepoints = 0;
+  size_t i = 0;
+
+  for (; i + 32 <= length; i += 32) {
+    __m256i input = _mm256_loadu_si256((const __m256i*)(const void*)(data + i));
+    utf8_avx2_check_block(&state, input);
+    codepoints += (size_t)__builtin_popcount(utf8_avx2_lead_mask(input));
   }
 
-  if (s->length > 0 && !s->string) {
-    result.status = CSTRING_ERR_INVALID_ARG;
-    return result;
+  if (i < length) {
+    // Zero padding is ASCII, so a sequence cut off by the end of the buffer
+    // is reported as TOO_SHORT.
+    char tail[32] = {0};
+    size_t remaining = length - i;
+    memcpy(tail, data + i, remaining);
+
+    __m256i input = _mm256_loadu_si256((const __m256i*)(const void*)tail);
+    utf8_avx2_check_block(&state, input);
+    unsigned int mask =
+        utf8_avx2_lead_mask(input) & ((1u << (unsigned int)remaining) - 1u);
+    codepoints += (size_t)__builtin_popcount(mask);
   }
 
-  c_string* new_s = calloc(1, sizeof(c_string));
-  if (!new_s) {
-    result.status = CSTRING_ERR_NO_MEMORY;
+  state.error = _mm256_or_si256(state.error, state.prev_incomplete);
+  if (!_mm256_testz_si256(state.error, state.error)) {
     return result;
   }
 
-  new_s->length = s->length;
+  result.valid = true;
+  result.codepoints = codepoints;
+  return result;
+}
 
-  if (s->length == 0) {
-    new_s->string = NULL;
-    new_s->codepoint_length = 0;
-    new_s->utf8_valid = true;
-    result.value = new_s;
-    return result;
+#endif  // CSTRING_X86_SIMD
+
+// Validate and count code points on the calling thread, using the widest
+// instruction set the CPU offers. Every path returns exactly what
+// analyze_utf8_scalar would.
+static Utf8Analysis analyze_utf8_block(const char* data, size_t length) {
+#if CSTRING_X86_SIMD
+  if (data && simd_enabled) {
+    if (__builtin_cpu_supports("avx2")) {
+      return analyze_utf8_avx2(data, length);
+    }
+    return analyze_utf8_sse2(data, length);
   }
+#endif
+  return analyze_utf8_scalar(data, length);
+}
 
-  new_s->string = malloc(new_s->length);
-  if (!new_s->string) {
-    free(new_s);
-    result.status = CSTRING_ERR_NO_MEMORY;
-    return result;
+// Byte offset of the first sequence that fails to decode, or `length` when
+// every sequence is valid.
+static size_t find_utf8_error(const char* data, size_t length) {
+  size_t i = 0;
+  while (i < length) {
+    size_t start = i;
+    if (!consume_utf8_sequence(data, length, &i, NULL)) {
+      return start;
+    }
   }
+  return length;
+}
 
-  memcpy(new_s->string, s->string, new_s->length);
+/* Code Point Counting */
 
-  if (!update_utf8_metadata(new_s)) {
-    // Copy succeeded at the byte level, but the contents are invalid UTF-8.
-    free(new_s->string);
-    free(new_s);
-    result.status = CSTRING_ERR_INVALID_UTF8;
-    return result;
+// Count code points in bytes that are already known to be valid UTF-8, i.e.
+// every byte that is not a continuation byte. Strings derived from a valid
+// source use this in place of a full validation pass.
+static size_t count_codepoints_scalar(const char* data, size_t length) {
+  size_t codepoints = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (((unsigned char)data[i] & 0xC0) != 0x80) {
+      codepoints += 1;
+    }
   }
-
-  result.value = new_s;
-  return result;
+  return codepoints;
 }
 
-CStringResult string_from_char(const char* s, const int length) {
-  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+#if CSTRING_X86_SIMD
 
-  if (length < 0) {
-    result.status = CSTRING_ERR_INVALID_ARG;
-    return result;
-  }
+static size_t count_codepoints_sse2(const char* data, size_t length) {
+  const __m128i last_continuation = _mm_set1_epi8(-65);  // 0xBF
+  size_t codepoints = 0;
+  size_t i = 0;
 
-  c_string* new_s = calloc(1, sizeof(c_string));
-  if (!new_s) {
-    result.status = CSTRING_ERR_NO_MEMORY;
-    return result;
+  for (; i + 16 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)(const void*)(data + i));
+    __m128i leads = _mm_cmpgt_epi8(block, last_continuation);
+    codepoints +=
+        (size_t)__builtin_popcount((unsigned int)_mm_movemask_epi8(leads));
   }
 
-  if (length == 0) {
-    new_s->string = NULL;
-    new_s->length = 0;
-    new_s->codepoint_length = 0;
-    new_s->utf8_valid = true;
-    result.value = new_s;
-    return result;
-  }
+  return codepoints + count_codepoints_scalar(data + i, length - i);
+}
 
-  if (!s) {
-    // Non-zero length with NULL data is undefined; treat as invalid input.
-    free(new_s);
-    result.status = CSTRING_ERR_INVALID_ARG;
-    return result;
-  }
+__attribute__((target("avx2"))) static size_t count_codepoints_avx2(
+    const char* data, size_t length) {
+  size_t codepoints = 0;
+  size_t i = 0;
 
-  new_s->length = (size_t)length;
-  new_s->string = malloc(new_s->length);
-  if (!new_s->string) {
-    free(new_s);
-    result.status = CSTRING_ERR_NO_MEMORY;
-    return result;
-  }
-  memcpy(new_s->string, s, new_s->length);
-  if (!update_utf8_metadata(new_s)) {
-    // Reject malformed UTF-8 so we never hand back an invalid `c_string`.
-    free(new_s->string);
-    free(new_s);
-    result.status = CSTRING_ERR_INVALID_UTF8;
-    return result;
+  for (; i + 32 <= length; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i*)(const void*)(data + i));
+    codepoints += (size_t)__builtin_popcount(utf8_avx2_lead_mask(block));
   }
 
-  result.value = new_s;
-  return result;
+  return codepoints + count_codepoints_sse2(data + i, length - i);
 }
 
-// Start and end are inclusive bounds.
-// This method will error in case the resulting sub-string is an invalid
-// UTF8 construct.
-CStringResult sub_string_checked(c_string* s, size_t start, size_t end) {
-  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+#endif  // CSTRING_X86_SIMD
 
-  if (!s || !s->string) {
-    result.status = CSTRING_ERR_INVALID_ARG;
-    return result;
+static size_t count_codepoints(const char* data, size_t length) {
+#if CSTRING_X86_SIMD
+  if (data && simd_enabled) {
+    if (__builtin_cpu_supports("avx2")) {
+      return count_codepoints_avx2(data, length);
+    }
+    return count_codepoints_sse2(data, length);
   }
+#endif
+  return count_codepoints_scalar(data, length);
+}
 
-  if (s->length == 0) {
-    result.status = CSTRING_ERR_INVALID_ARG;
-    return result;
+// Code points in a slice of a valid source that holds `source_codepoints` code
+// points in `source_length` bytes. Slices of pure ASCII need no counting.
+static size_t count_slice_codepoints(const char* data, size_t length,
+                                     size_t source_length,
+                                     size_t source_codepoints) {
+  if (source_codepoints == source_length) {
+    return length;
   }
+  return count_codepoints(data, length);
+}
 
-  if (start > end || end >= s->length) {
-    result.status = CSTRING_ERR_INVALID_ARG;
-    return result;
-  }
+// True when `offset` falls between two code points of valid UTF-8 `data`, so
+// cutting there leaves both sides valid.
+static bool is_codepoint_boundary(const char* data, size_t length,
+                                  size_t offset) {
+  return offset == 0 || offset >= length ||
+         ((unsigned char)data[offset] & 0xC0) != 0x80;
+}
 
-  size_t length = end - start + 1;
-  c_string* new_s = calloc(1, sizeof(c_string));
-  if (!new_s) {
-    result.status = CSTRING_ERR_NO_MEMORY;
-    return result;
-  }
+/* Parallel Scans */
 
-  new_s->length = length;
+#define PARALLEL_DEFAULT_THRESHOLD ((size_t)8 * 1024 * 1024)
+// Smaller chunks cost more to hand to a thread than to scan.
+#define PARALLEL_MIN_CHUNK ((size_t)256 * 1024)
+#define PARALLEL_MAX_THREADS 16
 
-  if (length == 0) {
-    new_s->string = NULL;
-    new_s->codepoint_length = 0;
-    new_s->utf8_valid = true;
-    result.value = new_s;
-    return result;
-  }
+static size_t parallel_threshold = PARALLEL_DEFAULT_THRESHOLD;
+static size_t parallel_thread_count = 0;  // 0: one per online CPU
 
-  new_s->string = malloc(length);
-  if (!new_s->string) {
-    free(new_s);
-    result.status = CSTRING_ERR_NO_MEMORY;
-    return result;
-  }
+void cstring_set_parallel_threshold(size_t bytes) {
+  parallel_threshold = bytes;
+}
 
-  memcpy(new_s->string, s->string + start, length);
+void cstring_set_thread_count(size_t threads) {
+  parallel_thread_count = threads;
+}
 
-  if (!update_utf8_metadata(new_s)) {
-    free(new_s->string);
-    free(new_s);
-    result.status = CSTRING_ERR_INVALID_UTF8;
-    return result;
+// Number of threads worth using to scan a `length`-byte buffer
+static size_t parallel_threads_for(size_t length) {
+#if CSTRING_HAVE_THREADS
+  if (length < parallel_threshold) {
+    return 1;
   }
 
-  result.value = new_s;
-  return result;
+  size_t threads = parallel_thread_count;
+  if (threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? (size_t)cpus : 1;
+  }
+  if (threads > length / PARALLEL_MIN_CHUNK) {
+    threads = length / PARALLEL_MIN_CHUNK;
+  }
+  if (threads > PARALLEL_MAX_THREADS) {
+    threads = PARALLEL_MAX_THREADS;
+  }
+  return threads > 1 ? threads : 1;
+#else
+  (void)length;
+  return 1;
+#endif
 }
 
-// start and end refer to codepoint lengths.
-// In case the input string contains a codepoint with a length > 1, we want
-// to make it easier for the user to fetch a sub-string without having to think
-// about actual byte lengths.
-CStringResult sub_string_codepoint(c_string* s, size_t start, size_t end) {
-  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+#if CSTRING_HAVE_THREADS
 
-  if (!s || !s->string) {
-    result.status = CSTRING_ERR_INVALID_ARG;
-    return result;
+// Run `work` on each of the `count` tasks (an array of `task_size`-byte
+// elements): the first on the calling thread and the rest on threads of their
+// own. A task whose thread cannot be started runs on the calling thread.
+static void run_in_parallel(void* (*work)(void*), void* tasks,
+                            size_t task_size, size_t count) {
+  pthread_t workers[PARALLEL_MAX_THREADS];
+  bool started[PARALLEL_MAX_THREADS] = {false};
+  char* base = tasks;
+
+  for (size_t t = 1; t < count; t++) {
+    started[t] =
+        pthread_create(&workers[t], NULL, work, base + t * task_size) == 0;
   }
+  work(base);
 
-  if (s->codepoint_length == 0) {
-    result.status = CSTRING_ERR_INVALID_ARG;
-    return result;
+  for (size_t t = 1; t < count; t++) {
+    if (started[t]) {
+      pthread_join(workers[t], NULL);
+    } else {
+      work(base + t * task_size);
+    }
   }
+}
 
-  if (!s->utf8_valid) {
-    result.status = CSTRING_ERR_INVALID_ARG;
-    return result;
+typedef struct {
+  const char* data;
+  size_t length;
+  Utf8Analysis analysis;
+} Utf8Chunk;
+
+static void* analyze_utf8_chunk(void* arg) {
+  Utf8Chunk* chunk = arg;
+  chunk->analysis = analyze_utf8_block(chunk->data, chunk->length);
+  return NULL;
+}
+
+// Move a chunk boundary back onto the first byte of a sequence so no sequence
+// straddles two chunks. Four continuation bytes in a row are invalid anyway,
+// so stop looking after three.
+static size_t align_to_lead_byte(const char* data, size_t offset) {
+  for (int i = 0; i < 3 && ((unsigned char)data[offset] & 0xC0) == 0x80; i++) {
+    offset -= 1;
   }
+  return offset;
+}
 
-  // end is now compared against the string's codepoint length instead of the
-  // byte one.
-  if (start > end || end >= s->codepoint_length) {
-    result.status = CSTRING_ERR_INVALID_ARG;
-    return result;
+// Validate `threads` chunks concurrently. Chunks start on sequence
+// boundaries, so the buffer is valid exactly when every chunk is, and the
+// first error lies in the first invalid chunk.
+static Utf8Analysis analyze_utf8_parallel(const char* data, size_t length,
+                                          size_t threads,
+                                          size_t* error_offset) {
+  Utf8Chunk chunks[PARALLEL_MAX_THREADS] = {{.data = NULL}};
+
+  size_t start = 0;
+  for (size_t t = 0; t < threads; t++) {
+    size_t end = t + 1 == threads
+                     ? length
+                     : align_to_lead_byte(data, length / threads * (t + 1));
+    chunks[t].data = data + start;
+    chunks[t].length = end - start;
+    start = end;
   }
 
-  // Parse input string and create a codepoint array length
-  size_t i = 0;
-  size_t codepoints = 0;
+  run_in_parallel(analyze_utf8_chunk, chunks, sizeof(Utf8Chunk), threads);
 
-  // Store the distance in bytes from the beginning of the string until the
-  // `start` index.
-  // This helps us track where the memcpy has to start from.
-  size_t byte_distance_until_start = 0;
-  // Store the distance in bytes from the beginning of the string until the
-  // `end` index.
-  // This helps us calculate the total byte length of the resulting sub-string.
-  size_t byte_distance_until_end = 0;
-
-  // Walk the buffer one UTF-8 sequence at a time until all bytes are
-  // consumed.
-  while (i < s->length) {
-    size_t codepoint_length = 0;
-    if (!consume_utf8_sequence(s->string, s->length, &i, &codepoint_length)) {
-      // TODO: At this point, we know that we have a valid UTF-8 string because
-      // the input c_string has already been created and checked at a previous
-      // point in time.
-      result.status = CSTRING_ERR_INVALID_UTF8;
+  Utf8Analysis result = {.valid = true, .codepoints = 0};
+  for (size_t t = 0; t < threads; t++) {
+    if (!chunks[t].analysis.valid) {
+      result.valid = false;
+      result.codepoints = 0;
+      if (error_offset) {
+        *error_offset = (size_t)(chunks[t].data - data) +
+                        find_utf8_error(chunks[t].data, chunks[t].length);
+      }
       return result;
     }
+    result.codepoints += chunks[t].analysis.codepoints;
+  }
+  return result;
+}
 
-    if (codepoints < start) {
-      byte_distance_until_start += codepoint_length;
-    }
-    if (codepoints <= end) {
-      byte_distance_until_end += codepoint_length;
-    }
+#endif  // CSTRING_HAVE_THREADS
 
-    // Successful sequence: advance to the next lead byte and bump the total.
-    codepoints += 1;
+// Validate and count code points, splitting buffers above the parallel
+// threshold across threads. When `error_offset` is non-NULL and the data is
+// invalid, it receives the offset of the first bad sequence.
+static Utf8Analysis analyze_utf8_locate(const char* data, size_t length,
+                                        size_t* error_offset) {
+#if CSTRING_HAVE_THREADS
+  size_t threads = data ? parallel_threads_for(length) : 1;
+  if (threads > 1) {
+    return analyze_utf8_parallel(data, length, threads, error_offset);
   }
+#endif
 
-  size_t length = byte_distance_until_end - byte_distance_until_start;
-  c_string* new_s = calloc(1, sizeof(c_string));
-  if (!new_s) {
-    result.status = CSTRING_ERR_NO_MEMORY;
-    return result;
+  Utf8Analysis analysis = analyze_utf8_block(data, length);
+  if (!analysis.valid && error_offset) {
+    *error_offset = data ? find_utf8_error(data, length) : 0;
   }
+  return analysis;
+}
 
-  new_s->length = length;
+static Utf8Analysis analyze_utf8(const char* data, size_t length) {
+  return analyze_utf8_locate(data, length, NULL);
+}
 
-  if (length == 0) {
-    new_s->string = NULL;
-    new_s->codepoint_length = 0;
-    new_s->utf8_valid = true;
-    result.value = new_s;
-    return result;
+CStringStatus cstring_validate_utf8(const char* data, size_t length,
+                                    size_t* codepoints, size_t* error_offset) {
+  if (!data && length > 0) {
+    return CSTRING_ERR_INVALID_ARG;
   }
 
-  new_s->string = malloc(length);
-  if (!new_s->string) {
-    free(new_s);
-    result.status = CSTRING_ERR_NO_MEMORY;
-    return result;
+  Utf8Analysis analysis = analyze_utf8_locate(data, length, error_offset);
+  if (!analysis.valid) {
+    return CSTRING_ERR_INVALID_UTF8;
   }
 
-  memcpy(new_s->string, s->string + byte_distance_until_start, length);
+  if (codepoints) {
+    *codepoints = analysis.codepoints;
+  }
+  return CSTRING_OK;
+}
 
-  result.value = new_s;
+static bool update_utf8_metadata(c_string* s) {
+  if (!s) {
+    return false;
+  }
+
+  if (s->length == 0 || !s->string) {
+    // Zero-length strings are trivially valid and contain zero code points.
+    s->codepoint_length = 0;
+    s->utf8_valid = (s->length == 0);
+    return s->utf8_valid;
+  }
+
+  // Analyze once and cache the derived metadata on the string object.
+  Utf8Analysis analysis = analyze_utf8(s->string, s->length);
+  s->codepoint_length = analysis.codepoints;
+  s->utf8_valid = analysis.valid;
+  return analysis.valid;
+}
+
+/* Arena Allocator */
+
+#define ARENA_DEFAULT_BLOCK_SIZE ((size_t)64 * 1024)
+#define ARENA_ALIGNMENT ((size_t)16)
+
+struct c_string_arena_block {
+  c_string_arena_block* next;
+  size_t capacity;  // usable bytes, always a multiple of ARENA_ALIGNMENT
+  size_t used;      // bytes handed out so far, also kept aligned
+};
+
+// Offset of the first usable byte in a block so every allocation starts on an
+// ARENA_ALIGNMENT boundary.
+#define ARENA_BLOCK_HEADER                                  \
+  ((sizeof(c_string_arena_block) + ARENA_ALIGNMENT - 1) & \
+   ~(ARENA_ALIGNMENT - 1))
+
+// Arena strings are laid out as [owning arena][c_string][payload]. The prefix
+// lets mutators find the arena again without growing c_string itself.
+#define ARENA_STRING_PREFIX ARENA_ALIGNMENT
+
+static size_t arena_align(size_t size) {
+  return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static char* arena_block_data(c_string_arena_block* block) {
+  return (char*)block + ARENA_BLOCK_HEADER;
+}
+
+static c_string_arena_block* arena_new_block(size_t capacity) {
+  if (capacity > SIZE_MAX - ARENA_BLOCK_HEADER) {
+    return NULL;
+  }
+
+  c_string_arena_block* block = malloc(ARENA_BLOCK_HEADER + capacity);
+  if (!block) {
+    return NULL;
+  }
+
+  block->next = NULL;
+  block->capacity = capacity;
+  block->used = 0;
+  return block;
+}
+
+CStringStatus arena_init(c_string_arena* arena, size_t block_size) {
+  if (!arena) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  if (block_size == 0) {
+    block_size = ARENA_DEFAULT_BLOCK_SIZE;
+  }
+  if (block_size > SIZE_MAX - ARENA_ALIGNMENT) {
+    return CSTRING_ERR_OVERFLOW;
+  }
+
+  arena->head = NULL;
+  arena->current = NULL;
+  arena->block_size = arena_align(block_size);
+  return CSTRING_OK;
+}
+
+void* arena_alloc(c_string_arena* arena, size_t size) {
+  if (!arena || size > SIZE_MAX - ARENA_ALIGNMENT) {
+    return NULL;
+  }
+
+  size_t rounded = arena_align(size);
+  c_string_arena_block* block = arena->current;
+
+  if (block && block->capacity - block->used < rounded) {
+    // Blocks after `current` are left over from before the last reset, so the
+    // next one can be recycled as long as the request fits.
+    block = block->next;
+    if (block) {
+      block->used = 0;
+      if (block->capacity < rounded) {
+        block = NULL;
+      }
+    }
+  }
+
+  if (!block) {
+    size_t capacity = rounded > arena->block_size ? rounded : arena->block_size;
+    block = arena_new_block(capacity);
+    if (!block) {
+      return NULL;
+    }
+
+    if (arena->current) {
+      block->next = arena->current->next;
+      arena->current->next = block;
+    } else {
+      arena->head = block;
+    }
+  }
+
+  arena->current = block;
+  void* memory = arena_block_data(block) + block->used;
+  block->used += rounded;
+  return memory;
+}
+
+void arena_reset(c_string_arena* arena) {
+  if (!arena || !arena->head) {
+    return;
+  }
+
+  // Later blocks are recycled lazily by arena_alloc, which keeps reset O(1).
+  arena->head->used = 0;
+  arena->current = arena->head;
+}
+
+void arena_destroy(c_string_arena* arena) {
+  if (!arena) {
+    return;
+  }
+
+  c_string_arena_block* block = arena->head;
+  while (block) {
+    c_string_arena_block* next = block->next;
+    free(block);
+    block = next;
+  }
+
+  arena->head = NULL;
+  arena->current = NULL;
+}
+
+// Offset of `memory` inside the current block, or SIZE_MAX when it lives
+// elsewhere.
+static size_t arena_current_offset(const c_string_arena* arena,
+                                   const char* memory) {
+  c_string_arena_block* block = arena ? arena->current : NULL;
+  if (!block || !memory) {
+    return SIZE_MAX;
+  }
+
+  const char* data = arena_block_data(block);
+  if (memory < data || memory > data + block->used) {
+    return SIZE_MAX;
+  }
+  return (size_t)(memory - data);
+}
+
+// Grow the allocation at `memory` in place when it is the arena's most recent
+// one and the current block still has room.
+static bool arena_try_extend(c_string_arena* arena, const char* memory,
+                             size_t old_size, size_t new_size) {
+  size_t offset = arena_current_offset(arena, memory);
+  if (offset == SIZE_MAX || new_size > SIZE_MAX - ARENA_ALIGNMENT - offset) {
+    return false;
+  }
+
+  c_string_arena_block* block = arena->current;
+  if (arena_align(offset + old_size) != block->used ||
+      arena_align(offset + new_size) > block->capacity) {
+    return false;
+  }
+
+  block->used = arena_align(offset + new_size);
+  return true;
+}
+
+// Hand back the arena's most recent allocation. Anything else stays allocated
+// until the next reset.
+static void arena_release_last(c_string_arena* arena, const char* memory,
+                               size_t size) {
+  size_t offset = arena_current_offset(arena, memory);
+  if (offset != SIZE_MAX &&
+      arena_align(offset + size) == arena->current->used) {
+    arena->current->used = offset;
+  }
+}
+
+static c_string_arena* owning_arena(const c_string* s) {
+  c_string_arena* arena = NULL;
+  memcpy(&arena, (const char*)s - ARENA_STRING_PREFIX, sizeof(arena));
+  return arena;
+}
+
+// Allocate a header plus `length` payload bytes. Arena strings and short heap
+// strings take a single allocation; longer heap strings take two.
+static c_string* allocate_string(c_string_arena* arena, size_t length) {
+  c_string* s = NULL;
+
+  if (arena) {
+    if (length > SIZE_MAX - ARENA_STRING_PREFIX - sizeof(c_string)) {
+      return NULL;
+    }
+
+    char* memory =
+        arena_alloc(arena, ARENA_STRING_PREFIX + sizeof(c_string) + length);
+    if (!memory) {
+      return NULL;
+    }
+
+    memcpy(memory, &arena, sizeof(arena));
+    s = (c_string*)(memory + ARENA_STRING_PREFIX);
+    memset(s, 0, sizeof(*s));
+    s->storage = CSTRING_STORAGE_ARENA;
+    s->string = length > 0 ? (char*)(s + 1) : NULL;
+  } else {
+    s = calloc(1, sizeof(c_string));
+    if (!s) {
+      return NULL;
+    }
+
+    if (length <= CSTRING_INLINE_CAPACITY) {
+      s->storage = CSTRING_STORAGE_INLINE;
+      s->string = s->local.inline_data;
+      s->capacity = CSTRING_INLINE_CAPACITY;
+    } else {
+      s->string = malloc(length);
+      if (!s->string) {
+        free(s);
+        return NULL;
+      }
+    }
+  }
+
+  s->length = length;
+  if (s->capacity < length) {
+    s->capacity = length;
+  }
+  // Empty strings are trivially valid; everything else must be filled in and
+  // analyzed by the caller.
+  s->codepoint_length = 0;
+  s->utf8_valid = (length == 0);
+  return s;
+}
+
+// Undo allocate_string after a constructor fails part-way through.
+static void release_string(c_string* s) {
+  if (s->storage == CSTRING_STORAGE_ARENA) {
+    arena_release_last(owning_arena(s), (const char*)s - ARENA_STRING_PREFIX,
+                       ARENA_STRING_PREFIX + sizeof(c_string) + s->length);
+    return;
+  }
+
+  if (s->storage != CSTRING_STORAGE_INLINE) {
+    free(s->string);
+  }
+  free(s);
+}
+
+// Bytes the payload of `s` can hold. Headers assembled by hand (calloc plus
+// create_string) never set `capacity`, so fall back to the length.
+static size_t payload_capacity(const c_string* s) {
+  return s->capacity > s->length ? s->capacity : s->length;
+}
+
+// Make room for at least `capacity` payload bytes, preserving the contents.
+// Arena strings grow in place when they were the arena's latest allocation and
+// move to a fresh arena allocation otherwise.
+static bool reserve_payload(c_string* s, size_t capacity) {
+  size_t current = payload_capacity(s);
+  if (capacity <= current) {
+    return true;
+  }
+
+  if (s->storage == CSTRING_STORAGE_ARENA) {
+    c_string_arena* arena = owning_arena(s);
+    if (!s->string || !arena_try_extend(arena, s->string, current, capacity)) {
+      char* grown = arena_alloc(arena, capacity);
+      if (!grown) {
+        return false;
+      }
+      if (s->length > 0) {
+        memcpy(grown, s->string, s->length);
+      }
+      s->string = grown;
+    }
+    s->capacity = capacity;
+    return true;
+  }
+
+  if (s->storage == CSTRING_STORAGE_INLINE) {
+    // Outgrew the header: move the payload to its own heap block.
+    char* grown = malloc(capacity);
+    if (!grown) {
+      return false;
+    }
+    memcpy(grown, s->local.inline_data, s->length);
+    s->local.codepoint_index = NULL;
+    s->string = grown;
+    s->capacity = capacity;
+    s->storage = CSTRING_STORAGE_HEAP;
+    return true;
+  }
+
+#if CSTRING_HAVE_MMAP
+  if (s->storage == CSTRING_STORAGE_MAPPED) {
+    // A mapping cannot grow; copy the bytes out and drop it.
+    char* grown = malloc(capacity);
+    if (!grown) {
+      return false;
+    }
+    memcpy(grown, s->string, s->length);
+    munmap(s->string, s->capacity);
+    s->string = grown;
+    s->capacity = capacity;
+    s->storage = CSTRING_STORAGE_HEAP;
+    return true;
+  }
+#endif
+
+  char* temp = realloc(s->string, capacity);
+  if (!temp) {
+    return false;
+  }
+  s->string = temp;
+  s->capacity = capacity;
+  return true;
+}
+
+// Make room for `additional` more bytes, doubling the capacity so a run of N
+// appends copies O(N) bytes in total instead of O(N^2).
+static CStringStatus grow_payload(c_string* s, size_t additional) {
+  if (additional > SIZE_MAX - s->length) {
+    return CSTRING_ERR_OVERFLOW;
+  }
+
+  size_t needed = s->length + additional;
+  size_t capacity = payload_capacity(s);
+  if (needed <= capacity) {
+    return CSTRING_OK;
+  }
+
+  if (capacity < 16) {
+    capacity = 16;
+  }
+  while (capacity < needed) {
+    capacity = capacity > SIZE_MAX / 2 ? needed : capacity * 2;
+  }
+
+  return reserve_payload(s, capacity) ? CSTRING_OK : CSTRING_ERR_NO_MEMORY;
+}
+
+/* Code Point Index */
+
+// Every CODEPOINT_INDEX_STRIDE-th code point gets an entry, so locating any
+// code point decodes fewer than that many sequences.
+#define CODEPOINT_INDEX_STRIDE 64
+// Below this many bytes walking from the start is as cheap as building one.
+#define CODEPOINT_INDEX_MIN_LENGTH (4 * CODEPOINT_INDEX_STRIDE)
+
+struct c_string_codepoint_index {
+  size_t count;
+  size_t offsets[];  // byte offset of code point i * CODEPOINT_INDEX_STRIDE
+};
+
+// Only strings that own their bytes cache an index; inline strings use the
+// slot for their payload and borrowed tokens are never destroyed.
+static bool can_index_codepoints(const c_string* s) {
+  return s->storage == CSTRING_STORAGE_HEAP ||
+         s->storage == CSTRING_STORAGE_ARENA ||
+         s->storage == CSTRING_STORAGE_MAPPED;
+}
+
+// Drop the index after the bytes change. Arena indexes are reclaimed along
+// with the rest of the arena.
+static void invalidate_codepoint_index(c_string* s) {
+  s->codepoint_index_stale = false;
+  if (!can_index_codepoints(s)) {
+    return;
+  }
+
+  if (s->storage != CSTRING_STORAGE_ARENA) {
+    free(s->local.codepoint_index);
+  }
+  s->local.codepoint_index = NULL;
+}
+
+static c_string_codepoint_index* build_codepoint_index(c_string* s) {
+  size_t count = (s->codepoint_length + CODEPOINT_INDEX_STRIDE - 1) /
+                 CODEPOINT_INDEX_STRIDE;
+  size_t size = sizeof(c_string_codepoint_index) + count * sizeof(size_t);
+
+  c_string_codepoint_index* index =
+      s->storage == CSTRING_STORAGE_ARENA ? arena_alloc(owning_arena(s), size)
+                                          : malloc(size);
+  if (!index) {
+    // Not fatal: callers fall back to decoding from the start.
+    return NULL;
+  }
+
+  // Every byte that is not a continuation byte starts a code point.
+  const unsigned char* data = (const unsigned char*)s->string;
+  size_t codepoint = 0;
+  size_t entries = 0;
+  for (size_t i = 0; i < s->length; i++) {
+    if ((data[i] & 0xC0) != 0x80) {
+      if (codepoint % CODEPOINT_INDEX_STRIDE == 0) {
+        index->offsets[entries++] = i;
+      }
+      codepoint += 1;
+    }
+  }
+
+  index->count = entries;
+  s->local.codepoint_index = index;
+  return index;
+}
+
+// Advance `count` code points from byte `offset` of valid UTF-8 data.
+static size_t skip_codepoints(const char* data, size_t length, size_t offset,
+                              size_t count) {
+  while (count > 0 && offset < length) {
+    offset += 1;
+    while (offset < length && ((unsigned char)data[offset] & 0xC0) == 0x80) {
+      offset += 1;
+    }
+    count -= 1;
+  }
+  return offset;
+}
+
+// Byte offset of code point `codepoint` in a valid string, or its length when
+// `codepoint` is one past the last one. Long strings build and reuse an index.
+static size_t codepoint_offset(c_string* s, size_t codepoint) {
+  if (s->codepoint_length == s->length) {
+    // Pure ASCII: code points and bytes coincide.
+    return codepoint;
+  }
+
+  c_string_codepoint_index* index = NULL;
+  if (can_index_codepoints(s)) {
+    if (s->codepoint_index_stale) {
+      invalidate_codepoint_index(s);
+    }
+    index = s->local.codepoint_index;
+    if (!index && s->length >= CODEPOINT_INDEX_MIN_LENGTH) {
+      index = build_codepoint_index(s);
+    }
+  }
+
+  size_t from = 0;
+  size_t remaining = codepoint;
+  if (index && index->count > 0) {
+    size_t entry = codepoint / CODEPOINT_INDEX_STRIDE;
+    if (entry >= index->count) {
+      entry = index->count - 1;
+    }
+    from = index->offsets[entry];
+    remaining = codepoint - entry * CODEPOINT_INDEX_STRIDE;
+  }
+  return skip_codepoints(string_data(s), s->length, from, remaining);
+}
+
+// Refresh the UTF-8 metadata after bytes were appended at `old_length`. A
+// valid prefix ends on a code point boundary, so only the new bytes need to be
+// checked. An invalid prefix may have been completed by them and is rescanned.
+static void update_appended_metadata(c_string* s, size_t old_length) {
+  invalidate_codepoint_index(s);
+
+  if (old_length > 0 && !s->utf8_valid) {
+    update_utf8_metadata(s);
+    return;
+  }
+
+  Utf8Analysis analysis =
+      analyze_utf8(s->string + old_length, s->length - old_length);
+  size_t prefix_codepoints = old_length > 0 ? s->codepoint_length : 0;
+  s->codepoint_length =
+      analysis.valid ? prefix_codepoints + analysis.codepoints : 0;
+  s->utf8_valid = analysis.valid;
+}
+
+
+// Create string from an input
+void create_string(c_string* s, size_t length, char* input) {
+  // `s` may be a string being reinitialized, whose index no longer matches its
+  // bytes, or a header built by the caller, whose index slot may hold
+  // anything. Only mark the index stale here; the library frees it the next
+  // time it needs an index for one of its own strings.
+  s->codepoint_index_stale = true;
+  s->length = length;
+  memcpy(s->string, input, s->length);
+  if (!update_utf8_metadata(s)) {
+    // Leave the string allocated but mark the metadata so callers can see the
+    // parse failed.
+    s->codepoint_length = 0;
+    s->utf8_valid = false;
+  }
+}
+
+// Initialize string buffer
+CStringResult initialize_buffer(size_t length) {
+  return initialize_buffer_in(NULL, length);
+}
+
+CStringResult initialize_buffer_in(c_string_arena* arena, size_t length) {
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  c_string* data = allocate_string(arena, length);
+  if (!data) {
+    result.status = CSTRING_ERR_NO_MEMORY;
+    return result;
+  }
+
+  // Caller must write valid UTF-8 into the buffer before the metadata can be
+  // trusted.
+  result.value = data;
+  return result;
+}
+
+// Copy contents of a c_string into a new one ("Copy Constructor")
+CStringResult string_new(const c_string* s) { return string_new_in(NULL, s); }
+
+CStringResult string_new_in(c_string_arena* arena, const c_string* s) {
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  if (!s) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  if (s->length > 0 && !s->string) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  c_string* new_s = allocate_string(arena, s->length);
+  if (!new_s) {
+    result.status = CSTRING_ERR_NO_MEMORY;
+    return result;
+  }
+
+  if (s->length == 0) {
+    result.value = new_s;
+    return result;
+  }
+
+  memcpy(new_s->string, string_data(s), new_s->length);
+
+  if (s->utf8_valid) {
+    // A byte-identical copy of a valid string is valid; reuse its metadata.
+    new_s->codepoint_length = s->codepoint_length;
+    new_s->utf8_valid = true;
+  } else if (!update_utf8_metadata(new_s)) {
+    // Copy succeeded at the byte level, but the contents are invalid UTF-8.
+    release_string(new_s);
+    result.status = CSTRING_ERR_INVALID_UTF8;
+    return result;
+  }
+
+  result.value = new_s;
+  return result;
+}
+
+CStringResult string_from_char(const char* s, const int length) {
+  return string_from_char_in(NULL, s, length);
+}
+
+CStringResult string_from_char_in(c_string_arena* arena, const char* s,
+                                  const int length) {
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  if (length < 0) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  if (length > 0 && !s) {
+    // Non-zero length with NULL data is undefined; treat as invalid input.
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  c_string* new_s = allocate_string(arena, (size_t)length);
+  if (!new_s) {
+    result.status = CSTRING_ERR_NO_MEMORY;
+    return result;
+  }
+
+  if (length == 0) {
+    result.value = new_s;
+    return result;
+  }
+
+  memcpy(new_s->string, s, new_s->length);
+  if (!update_utf8_metadata(new_s)) {
+    // Reject malformed UTF-8 so we never hand back an invalid `c_string`.
+    release_string(new_s);
+    result.status = CSTRING_ERR_INVALID_UTF8;
+    return result;
+  }
+
+  result.value = new_s;
+  return result;
+}
+
+#if CSTRING_HAVE_MMAP
+CStringResult string_from_file_mmap(const char* path) {
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  if (!path) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    result.status = CSTRING_ERR_IO;
+    return result;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    close(fd);
+    result.status = CSTRING_ERR_IO;
+    return result;
+  }
+
+  if ((uintmax_t)info.st_size > SIZE_MAX) {
+    close(fd);
+    result.status = CSTRING_ERR_OVERFLOW;
+    return result;
+  }
+
+  size_t length = (size_t)info.st_size;
+  if (length == 0) {
+    // Zero-length mappings are not allowed; an empty file is an empty string.
+    close(fd);
+    result.value = allocate_string(NULL, 0);
+    result.status = result.value ? CSTRING_OK : CSTRING_ERR_NO_MEMORY;
+    return result;
+  }
+
+  // Private and writable so in-place edits work without touching the file.
+  void* data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    result.status = CSTRING_ERR_IO;
+    return result;
+  }
+
+  c_string* s = calloc(1, sizeof(c_string));
+  if (!s) {
+    munmap(data, length);
+    result.status = CSTRING_ERR_NO_MEMORY;
+    return result;
+  }
+
+  s->string = data;
+  s->length = length;
+  s->capacity = length;
+  s->storage = CSTRING_STORAGE_MAPPED;
+
+  // Validation is one front-to-back pass, so ask for aggressive read-ahead.
+  posix_madvise(data, length, POSIX_MADV_SEQUENTIAL);
+  if (!update_utf8_metadata(s)) {
+    destroy_string(s);
+    result.status = CSTRING_ERR_INVALID_UTF8;
+    return result;
+  }
+
+  result.value = s;
+  return result;
+}
+#else
+CStringResult string_from_file_mmap(const char* path) {
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  if (!path) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    result.status = CSTRING_ERR_IO;
+    return result;
+  }
+
+  long size = -1;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    size = ftell(file);
+  }
+  if (size < 0 || fseek(file, 0, SEEK_SET) != 0) {
+    fclose(file);
+    result.status = CSTRING_ERR_IO;
+    return result;
+  }
+
+  c_string* s = allocate_string(NULL, (size_t)size);
+  if (!s) {
+    fclose(file);
+    result.status = CSTRING_ERR_NO_MEMORY;
+    return result;
+  }
+
+  size_t read_bytes = fread(string_data(s), 1, s->length, file);
+  fclose(file);
+  if (read_bytes != s->length) {
+    release_string(s);
+    result.status = CSTRING_ERR_IO;
+    return result;
+  }
+
+  if (!update_utf8_metadata(s)) {
+    release_string(s);
+    result.status = CSTRING_ERR_INVALID_UTF8;
+    return result;
+  }
+
+  result.value = s;
+  return result;
+}
+#endif
+
+// Start and end are inclusive bounds.
+// This method will error in case the resulting sub-string is an invalid
+// UTF8 construct.
+CStringResult sub_string_checked(c_string* s, size_t start, size_t end) {
+  return sub_string_checked_in(NULL, s, start, end);
+}
+
+CStringResult sub_string_checked_in(c_string_arena* arena, c_string* s,
+                                    size_t start, size_t end) {
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  if (!s || !s->string) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  if (s->length == 0) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  if (start > end || end >= s->length) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  // A slice of valid input is valid exactly when it neither starts nor ends
+  // inside a sequence, so only the two boundaries need checking.
+  const char* data = string_data(s);
+  if (s->utf8_valid && (!is_codepoint_boundary(data, s->length, start) ||
+                        !is_codepoint_boundary(data, s->length, end + 1))) {
+    result.status = CSTRING_ERR_INVALID_UTF8;
+    return result;
+  }
+
+  size_t length = end - start + 1;
+  c_string* new_s = allocate_string(arena, length);
+  if (!new_s) {
+    result.status = CSTRING_ERR_NO_MEMORY;
+    return result;
+  }
+
+  memcpy(new_s->string, data + start, length);
+
+  if (s->utf8_valid) {
+    new_s->codepoint_length = count_slice_codepoints(
+        new_s->string, length, s->length, s->codepoint_length);
+    new_s->utf8_valid = true;
+  } else if (!update_utf8_metadata(new_s)) {
+    release_string(new_s);
+    result.status = CSTRING_ERR_INVALID_UTF8;
+    return result;
+  }
+
+  result.value = new_s;
+  return result;
+}
+
+// start and end refer to codepoint lengths.
+// In case the input string contains a codepoint with a length > 1, we want
+// to make it easier for the user to fetch a sub-string without having to think
+// about actual byte lengths.
+CStringResult sub_string_codepoint(c_string* s, size_t start, size_t end) {
+  return sub_string_codepoint_in(NULL, s, start, end);
+}
+
+CStringResult sub_string_codepoint_in(c_string_arena* arena, c_string* s,
+                                      size_t start, size_t end) {
+
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  if (!s || !s->string) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  if (s->codepoint_length == 0) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  if (!s->utf8_valid) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  // end is now compared against the string's codepoint length instead of the
+  // byte one.
+  if (start > end || end >= s->codepoint_length) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  // The metadata says the bytes are valid UTF-8, so only the two boundaries
+  // need locating; the index bounds each lookup to a short walk.
+  size_t byte_start = codepoint_offset(s, start);
+  size_t byte_end = codepoint_offset(s, end + 1);
+
+  size_t length = byte_end - byte_start;
+  c_string* new_s = allocate_string(arena, length);
+  if (!new_s) {
+    result.status = CSTRING_ERR_NO_MEMORY;
+    return result;
+  }
+
+  memcpy(new_s->string, string_data(s) + byte_start, length);
+
+  result.value = new_s;
   result.value->length = length;
   result.value->codepoint_length = end - start + 1;
   result.value->utf8_valid = true;
 
-  return result;
+  return result;
+}
+
+// Return string inside c_string with a null-terminator in case an external
+// function requires it
+char* get_null_terminated_string(c_string* s) {
+  char* result = malloc(s->length + 1);
+  if (!result) {
+    fputs("Memory allocation failure", stderr);
+    exit(EXIT_FAILURE);
+  }
+
+  result[s->length] = '\0';
+  memcpy(result, string_data(s), s->length);
+
+  return result;
+}
+
+char* string_data(const c_string* s) {
+  if (s->storage == CSTRING_STORAGE_INLINE) {
+    return (char*)s->local.inline_data;
+  }
+  return s->string;
+}
+
+/* Free the string's content and the string itself */
+void destroy_string(c_string* input) {
+  if (input->storage == CSTRING_STORAGE_ARENA) {
+    return;
+  }
+
+#if CSTRING_HAVE_MMAP
+  if (input->storage == CSTRING_STORAGE_MAPPED) {
+    free(input->local.codepoint_index);
+    munmap(input->string, input->capacity);
+    free(input);
+    return;
+  }
+#endif
+
+  if (input->storage != CSTRING_STORAGE_INLINE) {
+    free(input->local.codepoint_index);
+    free(input->string);
+  }
+  free(input);
+}
+
+/* Help function used to free the memory used by the c_string** in string_delim
+ */
+void destroy_delim_string(c_string** s) {
+  size_t i = 0;
+  while (s[i] != NULL) {
+    destroy_string(s[i]);
+    i += 1;
+  }
+
+  free(s);
+}
+
+/* Concatenate input into string s */
+CStringStatus string_concat(c_string* s, const char* input) {
+  if (!input) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  return string_append(s, input, strlen(input));
+}
+
+CStringStatus string_append(c_string* s, const char* bytes, size_t length) {
+  if (!s || (length > 0 && !bytes)) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  if (length == 0) {
+    return CSTRING_OK;
+  }
+
+  // `bytes` may lie inside `s` itself (s += s). Growing can free the payload
+  // or move it out of the header, so find the bytes again by their offset.
+  const char* data = string_data(s);
+  bool aliased = bytes >= data && bytes < data + s->length;
+  size_t offset = aliased ? (size_t)(bytes - data) : 0;
+
+  CStringStatus status = grow_payload(s, length);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+  if (aliased) {
+    bytes = s->string + offset;
+  }
+
+  size_t old_length = s->length;
+  memcpy(s->string + old_length, bytes, length);
+  s->length += length;
+  update_appended_metadata(s, old_length);
+  return CSTRING_OK;
+}
+
+CStringStatus string_modify(c_string* s, const char* input) {
+  if (!s || !input) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  size_t length = strlen(input);
+  if (!reserve_payload(s, length)) {
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  invalidate_codepoint_index(s);
+  if (length > 0) {
+    memcpy(s->string, input, length);
+  }
+  s->length = length;
+  update_utf8_metadata(s);
+  return CSTRING_OK;
+}
+
+CStringStatus string_reserve(c_string* s, size_t capacity) {
+  if (!s) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  return reserve_payload(s, capacity) ? CSTRING_OK : CSTRING_ERR_NO_MEMORY;
+}
+
+CStringStatus string_shrink_to_fit(c_string* s) {
+  if (!s) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  // Arena memory is only returned wholesale, so there is nothing to give back.
+  if (s->storage != CSTRING_STORAGE_HEAP || s->capacity <= s->length) {
+    return CSTRING_OK;
+  }
+
+  if (s->length <= CSTRING_INLINE_CAPACITY) {
+    // Short enough to move back into the header, where the index slot is
+    // needed for the payload.
+    invalidate_codepoint_index(s);
+    if (s->length > 0) {
+      memcpy(s->local.inline_data, s->string, s->length);
+    }
+    free(s->string);
+    s->string = s->local.inline_data;
+    s->capacity = CSTRING_INLINE_CAPACITY;
+    s->storage = CSTRING_STORAGE_INLINE;
+    return CSTRING_OK;
+  }
+
+  char* temp = realloc(s->string, s->length);
+  if (!temp) {
+    return CSTRING_ERR_NO_MEMORY;
+  }
+  s->string = temp;
+  s->capacity = s->length;
+  return CSTRING_OK;
+}
+
+/* Check if two strings are equal.
+   Longer string is considered greater.
+   Return > 0 if first is greater than second.
+   Return 0 if they are equal.
+   Return < 0 if second is greater than first. */
+int string_compare(const c_string* first, const c_string* second) {
+  if (first->length > second->length) {
+    return 1;
+  } else if (first->length < second->length) {
+    return -1;
+  }
+
+  return memcmp(string_data(first), string_data(second), first->length);
+}
+
+int string_compare_lex(const c_string* first, const c_string* second) {
+  return view_compare_lex(string_view(first), string_view(second));
+}
+
+bool string_equals(const c_string* first, const c_string* second) {
+  return view_equals(string_view(first), string_view(second));
+}
+
+int string_compare_ignore_case(const c_string* first, const c_string* second) {
+  return view_compare_ignore_case(string_view(first), string_view(second));
+}
+
+bool string_equals_ignore_case(const c_string* first, const c_string* second) {
+  return view_equals_ignore_case(string_view(first), string_view(second));
+}
+
+bool string_starts_with(const c_string* s, const char* prefix) {
+  return view_starts_with(string_view(s), prefix);
+}
+
+bool string_ends_with(const c_string* s, const char* suffix) {
+  return view_ends_with(string_view(s), suffix);
+}
+
+/* Substring Search */
+
+typedef enum {
+  NEEDLE_EMPTY = 0,
+  NEEDLE_BYTE,      // memchr
+  NEEDLE_SHORT,     // vectorized first/last byte filter
+  NEEDLE_HORSPOOL,  // Boyer-Moore-Horspool
+} NeedleAlgorithm;
+
+// Needles up to this length are found with the first/last byte filter; longer
+// ones skip ahead further with Horspool's bad-character table.
+#define NEEDLE_SHORT_MAX ((size_t)32)
+
+CStringStatus needle_compile(c_string_needle* needle, const char* bytes,
+                             size_t length) {
+  if (!needle || (length > 0 && !bytes)) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  needle->bytes = bytes;
+  needle->length = length;
+
+  if (length == 0) {
+    needle->algorithm = NEEDLE_EMPTY;
+  } else if (length == 1) {
+    needle->algorithm = NEEDLE_BYTE;
+  } else if (length <= NEEDLE_SHORT_MAX) {
+    needle->algorithm = NEEDLE_SHORT;
+  } else {
+    needle->algorithm = NEEDLE_HORSPOOL;
+
+    // Shifts are capped at 255 to keep the table small; a shorter shift is
+    // always safe, it just skips less.
+    unsigned char default_shift = length > 255 ? 255 : (unsigned char)length;
+    memset(needle->shift, default_shift, sizeof(needle->shift));
+    for (size_t i = 0; i < length - 1; i++) {
+      size_t shift = length - 1 - i;
+      needle->shift[(unsigned char)bytes[i]] =
+          shift > 255 ? 255 : (unsigned char)shift;
+    }
+  }
+
+  return CSTRING_OK;
+}
+
+static size_t find_short_scalar(const char* haystack, size_t length,
+                                const c_string_needle* needle, size_t from) {
+  size_t m = needle->length;
+  char last = needle->bytes[m - 1];
+  size_t i = from;
+
+  while (i + m <= length) {
+    const char* candidate =
+        memchr(haystack + i, needle->bytes[0], length - m + 1 - i);
+    if (!candidate) {
+      return CSTRING_NPOS;
+    }
+
+    i = (size_t)(candidate - haystack);
+    if (haystack[i + m - 1] == last &&
+        memcmp(haystack + i + 1, needle->bytes + 1, m - 2) == 0) {
+      return i;
+    }
+    i += 1;
+  }
+
+  return CSTRING_NPOS;
+}
+
+#if CSTRING_X86_SIMD
+
+// Compare a block of candidate first bytes and the matching block of candidate
+// last bytes at once (Muła's "SIMD-friendly generic" search); only positions
+// where both agree are checked with memcmp.
+static size_t find_short_sse2(const char* haystack, size_t length,
+                              const c_string_needle* needle, size_t from) {
+  size_t m = needle->length;
+  const __m128i first = _mm_set1_epi8(needle->bytes[0]);
+  const __m128i last = _mm_set1_epi8(needle->bytes[m - 1]);
+  size_t i = from;
+
+  while (i + m - 1 + 16 <= length) {
+    __m128i block_first =
+        _mm_loadu_si128((const __m128i*)(const void*)(haystack + i));
+    __m128i block_last =
+        _mm_loadu_si128((const __m128i*)(const void*)(haystack + i + m - 1));
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+
+    while (mask) {
+      size_t bit = (size_t)__builtin_ctz(mask);
+      if (memcmp(haystack + i + bit + 1, needle->bytes + 1, m - 2) == 0) {
+        return i + bit;
+      }
+      mask &= mask - 1;
+    }
+    i += 16;
+  }
+
+  return find_short_scalar(haystack, length, needle, i);
+}
+
+__attribute__((target("avx2"))) static size_t find_short_avx2(
+    const char* haystack, size_t length, const c_string_needle* needle,
+    size_t from) {
+  size_t m = needle->length;
+  const __m256i first = _mm256_set1_epi8(needle->bytes[0]);
+  const __m256i last = _mm256_set1_epi8(needle->bytes[m - 1]);
+  size_t i = from;
+
+  while (i + m - 1 + 32 <= length) {
+    __m256i block_first =
+        _mm256_loadu_si256((const __m256i*)(const void*)(haystack + i));
+    __m256i block_last = _mm256_loadu_si256(
+        (const __m256i*)(const void*)(haystack + i + m - 1));
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                         _mm256_cmpeq_epi8(block_last, last)));
+
+    while (mask) {
+      size_t bit = (size_t)__builtin_ctz(mask);
+      if (memcmp(haystack + i + bit + 1, needle->bytes + 1, m - 2) == 0) {
+        return i + bit;
+      }
+      mask &= mask - 1;
+    }
+    i += 32;
+  }
+
+  return find_short_sse2(haystack, length, needle, i);
+}
+
+#endif  // CSTRING_X86_SIMD
+
+static size_t find_horspool(const char* haystack, size_t length,
+                            const c_string_needle* needle, size_t from) {
+  size_t m = needle->length;
+  unsigned char last = (unsigned char)needle->bytes[m - 1];
+  size_t i = from;
+
+  while (i + m <= length) {
+    unsigned char c = (unsigned char)haystack[i + m - 1];
+    if (c == last && memcmp(haystack + i, needle->bytes, m - 1) == 0) {
+      return i;
+    }
+    i += needle->shift[c];
+  }
+
+  return CSTRING_NPOS;
+}
+
+static size_t find_bytes(const char* haystack, size_t length,
+                         const c_string_needle* needle, size_t from) {
+  if (!needle || needle->length == 0 || from > length ||
+      needle->length > length - from) {
+    return CSTRING_NPOS;
+  }
+
+  switch (needle->algorithm) {
+    case NEEDLE_BYTE: {
+      const char* match =
+          memchr(haystack + from, needle->bytes[0], length - from);
+      return match ? (size_t)(match - haystack) : CSTRING_NPOS;
+    }
+    case NEEDLE_SHORT:
+#if CSTRING_X86_SIMD
+      if (simd_enabled) {
+        if (__builtin_cpu_supports("avx2")) {
+          return find_short_avx2(haystack, length, needle, from);
+        }
+        return find_short_sse2(haystack, length, needle, from);
+      }
+#endif
+      return find_short_scalar(haystack, length, needle, from);
+    default:
+      return find_horspool(haystack, length, needle, from);
+  }
+}
+
+size_t string_find(const c_string* haystack, const c_string_needle* needle,
+                   size_t from) {
+  if (!haystack) {
+    return CSTRING_NPOS;
+  }
+  return find_bytes(string_data(haystack), haystack->length, needle, from);
+}
+
+size_t view_find(c_string_view haystack, const c_string_needle* needle,
+                 size_t from) {
+  return find_bytes(haystack.data, haystack.length, needle, from);
+}
+
+size_t string_find_all(const c_string* haystack, const c_string_needle* needle,
+                       size_t* positions, size_t max_positions) {
+  if (!haystack || !needle || needle->length == 0) {
+    return 0;
+  }
+
+  size_t count = 0;
+  size_t match = find_bytes(string_data(haystack), haystack->length, needle, 0);
+  while (match != CSTRING_NPOS) {
+    if (positions && count < max_positions) {
+      positions[count] = match;
+    }
+    count += 1;
+    match = find_bytes(string_data(haystack), haystack->length, needle,
+                       match + needle->length);
+  }
+
+  return count;
+}
+
+/* Delimiter Offsets */
+
+// Matches of a needle that start in [start, end) of `data`. The search runs
+// up to `limit`, so a match that begins in this chunk but ends in the next
+// one is still found here.
+typedef struct {
+  const char* data;
+  size_t start;
+  size_t end;
+  size_t limit;
+  const c_string_needle* needle;
+  size_t* offsets;
+  size_t count;
+  size_t capacity;
+  bool failed;
+} DelimChunk;
+
+static void* find_delims_in_chunk(void* arg) {
+  DelimChunk* chunk = arg;
+  size_t match = find_bytes(chunk->data, chunk->limit, chunk->needle,
+                            chunk->start);
+
+  while (match != CSTRING_NPOS && match < chunk->end) {
+    if (chunk->count == chunk->capacity) {
+      size_t capacity = chunk->capacity ? chunk->capacity * 2 : 1024;
+      size_t* grown = realloc(chunk->offsets, capacity * sizeof(size_t));
+      if (!grown) {
+        chunk->failed = true;
+        return NULL;
+      }
+      chunk->offsets = grown;
+      chunk->capacity = capacity;
+    }
+    chunk->offsets[chunk->count++] = match;
+    match = find_bytes(chunk->data, chunk->limit, chunk->needle,
+                       match + chunk->needle->length);
+  }
+  return NULL;
+}
+
+// True when a proper prefix of the needle is also a suffix ("aa", "abab"),
+// i.e. two occurrences can overlap.
+static bool needle_overlaps_itself(const char* bytes, size_t length) {
+  for (size_t shift = 1; shift < length; shift++) {
+    if (memcmp(bytes, bytes + shift, length - shift) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+CStringStatus view_delim_offsets(c_string_view v, const char* delim,
+                                 size_t** offsets, size_t* count) {
+  if (!delim || !offsets || !count || (!v.data && v.length > 0)) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  *offsets = NULL;
+  *count = 0;
+
+  c_string_needle needle;
+  CStringStatus status = needle_compile(&needle, delim, strlen(delim));
+  if (status != CSTRING_OK) {
+    return status;
+  }
+  if (needle.length == 0 || v.length < needle.length) {
+    return CSTRING_OK;
+  }
+
+  // Occurrences of a delimiter that cannot overlap itself are all matches, so
+  // every chunk finds exactly its share of the left-to-right scan. Otherwise
+  // a chunk could start half-way into a match and pick a different chain of
+  // matches, so scan the whole input on one thread.
+  size_t threads = parallel_threads_for(v.length);
+  if (needle_overlaps_itself(needle.bytes, needle.length)) {
+    threads = 1;
+  }
+
+  DelimChunk chunks[PARALLEL_MAX_THREADS] = {{.data = NULL}};
+  for (size_t t = 0; t < threads; t++) {
+    chunks[t].data = v.data;
+    chunks[t].start = v.length / threads * t;
+    chunks[t].end = t + 1 == threads ? v.length : v.length / threads * (t + 1);
+    chunks[t].limit = chunks[t].end + needle.length - 1;
+    if (chunks[t].limit > v.length) {
+      chunks[t].limit = v.length;
+    }
+    chunks[t].needle = &needle;
+  }
+
+#if CSTRING_HAVE_THREADS
+  run_in_parallel(find_delims_in_chunk, chunks, sizeof(DelimChunk), threads);
+#else
+  find_delims_in_chunk(&chunks[0]);
+#endif
+
+  size_t total = 0;
+  bool failed = false;
+  for (size_t t = 0; t < threads; t++) {
+    total += chunks[t].count;
+    failed = failed || chunks[t].failed;
+  }
+
+  if (!failed && threads == 1) {
+    // Hand the single chunk's array over as is.
+    *offsets = chunks[0].offsets;
+    *count = total;
+    return CSTRING_OK;
+  }
+
+  size_t* merged = NULL;
+  if (!failed && total > 0) {
+    merged = malloc(total * sizeof(size_t));
+    failed = merged == NULL;
+  }
+
+  size_t position = 0;
+  for (size_t t = 0; t < threads; t++) {
+    if (!failed && chunks[t].count > 0) {
+      memcpy(merged + position, chunks[t].offsets,
+             chunks[t].count * sizeof(size_t));
+      position += chunks[t].count;
+    }
+    free(chunks[t].offsets);
+  }
+
+  if (failed) {
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  *offsets = merged;
+  *count = total;
+  return CSTRING_OK;
+}
+
+CStringStatus string_delim_offsets(const c_string* s, const char* delim,
+                                   size_t** offsets, size_t* count) {
+  if (!s) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  c_string_view v = {.data = string_data(s),
+                     .length = s->length,
+                     .codepoint_length = s->codepoint_length,
+                     .utf8_valid = s->utf8_valid};
+  return view_delim_offsets(v, delim, offsets, count);
+}
+
+/* Multi-Pattern Search */
+
+// Bytes a scan stops at. The nibble tables hold the same set for the AVX2
+// lookup: bit h of low_rows[l] is set when byte (h << 4 | l) is a member, for
+// h < 8, and high_rows covers h >= 8 the same way.
+typedef struct {
+  bool members[256];
+  unsigned char bytes[256];  // the members in ascending order
+  size_t count;
+  unsigned char low_rows[16];
+  unsigned char high_rows[16];
+} ByteSet;
+
+static void byte_set_add(ByteSet* set, unsigned char byte) {
+  if (set->members[byte]) {
+    return;
+  }
+  set->members[byte] = true;
+  if ((byte >> 4) < 8) {
+    set->low_rows[byte & 0x0F] |= (unsigned char)(1u << (byte >> 4));
+  } else {
+    set->high_rows[byte & 0x0F] |= (unsigned char)(1u << ((byte >> 4) - 8));
+  }
+}
+
+// Fill `bytes` once every member has been added
+static void byte_set_finish(ByteSet* set) {
+  set->count = 0;
+  for (size_t b = 0; b < 256; b++) {
+    if (set->members[b]) {
+      set->bytes[set->count++] = (unsigned char)b;
+    }
+  }
+}
+
+static size_t byte_set_find_scalar(const ByteSet* set, const char* data,
+                                   size_t length, size_t from) {
+  for (size_t i = from; i < length; i++) {
+    if (set->members[(unsigned char)data[i]]) {
+      return i;
+    }
+  }
+  return CSTRING_NPOS;
+}
+
+#if CSTRING_X86_SIMD
+
+// Sets this small are compared byte by byte; larger ones are left to the
+// scalar table unless AVX2 is available.
+#define BYTE_SET_SSE2_MAX ((size_t)6)
+
+static size_t byte_set_find_sse2(const ByteSet* set, const char* data,
+                                 size_t length, size_t from) {
+  __m128i targets[BYTE_SET_SSE2_MAX];
+  for (size_t k = 0; k < set->count; k++) {
+    targets[k] = _mm_set1_epi8((char)set->bytes[k]);
+  }
+
+  size_t i = from;
+  for (; i + 16 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)(const void*)(data + i));
+    __m128i hits = _mm_cmpeq_epi8(block, targets[0]);
+    for (size_t k = 1; k < set->count; k++) {
+      hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, targets[k]));
+    }
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(hits);
+    if (mask) {
+      return i + (size_t)__builtin_ctz(mask);
+    }
+  }
+  return byte_set_find_scalar(set, data, length, i);
+}
+
+// Look every byte up in the 16x16 membership bitmap with two shuffles (Muła's
+// byte-set test): the low nibble picks a row of the table for the byte's half
+// of the high nibbles, and the high nibble picks the bit within it. pshufb
+// yields zero for indices with the top bit set, which selects between the two
+// halves without a blend.
+__attribute__((target("avx2"))) static size_t byte_set_find_avx2(
+    const ByteSet* set, const char* data, size_t length, size_t from) {
+  const __m256i low_rows = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i*)(const void*)set->low_rows));
+  const __m256i high_rows = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i*)(const void*)set->high_rows));
+  const __m256i bits = _mm256_setr_epi8(
+      1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8,
+      16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+  const __m256i index_mask = _mm256_set1_epi8((char)0x8F);
+  const __m256i top_bit = _mm256_set1_epi8((char)0x80);
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+  size_t i = from;
+  for (; i + 32 <= length; i += 32) {
+    __m256i block =
+        _mm256_loadu_si256((const __m256i*)(const void*)(data + i));
+    __m256i rows = _mm256_or_si256(
+        _mm256_shuffle_epi8(low_rows, _mm256_and_si256(block, index_mask)),
+        _mm256_shuffle_epi8(
+            high_rows,
+            _mm256_and_si256(_mm256_xor_si256(block, top_bit), index_mask)));
+    __m256i bit = _mm256_shuffle_epi8(
+        bits, _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble));
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_and_si256(rows, bit), bit));
+    if (mask) {
+      return i + (size_t)__builtin_ctz(mask);
+    }
+  }
+  return byte_set_find_scalar(set, data, length, i);
+}
+
+#endif  // CSTRING_X86_SIMD
+
+// Offset of the first member at or after `from`, or CSTRING_NPOS
+static size_t byte_set_find(const ByteSet* set, const char* data,
+                            size_t length, size_t from) {
+  if (from >= length || set->count == 0) {
+    return CSTRING_NPOS;
+  }
+  if (set->count == 1) {
+    const char* match = memchr(data + from, set->bytes[0], length - from);
+    return match ? (size_t)(match - data) : CSTRING_NPOS;
+  }
+#if CSTRING_X86_SIMD
+  if (simd_enabled) {
+    if (__builtin_cpu_supports("avx2")) {
+      return byte_set_find_avx2(set, data, length, from);
+    }
+    if (set->count <= BYTE_SET_SSE2_MAX) {
+      return byte_set_find_sse2(set, data, length, from);
+    }
+  }
+#endif
+  return byte_set_find_scalar(set, data, length, from);
+}
+
+// Aho-Corasick automaton with every failure link resolved ahead of time, so
+// each input byte costs one table load. Bytes that occur in no pattern share
+// class 0; the others get a class each, which keeps a row of the dense
+// transition table as short as the patterns' alphabet.
+struct c_string_multi_needle {
+  size_t pattern_count;
+  size_t* lengths;        // byte length of every pattern
+  uint32_t* next;         // state * class_count + class -> state
+  uint32_t* depth;        // bytes spelled by the path to each state
+  uint32_t* output;       // 1 + longest pattern ending in each state, or 0
+  size_t state_count;
+  size_t class_count;
+  unsigned char classes[256];
+  ByteSet first_bytes;     // bytes a match can start with
+  bool single_bytes;       // every pattern is one byte: `first_bytes` is all
+  uint32_t byte_pattern[256];  // pattern for each byte when single_bytes
+  bool utf8_valid;         // every pattern is valid UTF-8
+};
+
+CStringStatus multi_needle_compile(const char* const* patterns, size_t count,
+                                   c_string_multi_needle** out) {
+  if (!out || (count > 0 && !patterns)) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  *out = NULL;
+
+  size_t total = 0;
+  for (size_t p = 0; p < count; p++) {
+    if (!patterns[p]) {
+      return CSTRING_ERR_INVALID_ARG;
+    }
+    size_t length = strlen(patterns[p]);
+    if (length > UINT32_MAX - 1 - total) {
+      return CSTRING_ERR_OVERFLOW;
+    }
+    total += length;
+  }
+
+  c_string_multi_needle* m = calloc(1, sizeof(*m));
+  if (!m) {
+    return CSTRING_ERR_NO_MEMORY;
+  }
+  m->pattern_count = count;
+  m->utf8_valid = true;
+  m->single_bytes = true;
+
+  bool used[256] = {false};
+  for (size_t p = 0; p < count; p++) {
+    size_t length = strlen(patterns[p]);
+    for (size_t i = 0; i < length; i++) {
+      used[(unsigned char)patterns[p][i]] = true;
+    }
+    if (length > 0) {
+      byte_set_add(&m->first_bytes, (unsigned char)patterns[p][0]);
+    }
+    m->single_bytes = m->single_bytes && length <= 1;
+    m->utf8_valid = m->utf8_valid && analyze_utf8(patterns[p], length).valid;
+  }
+  byte_set_finish(&m->first_bytes);
+
+  m->class_count = 1;
+  for (size_t b = 0; b < 256; b++) {
+    m->classes[b] = used[b] ? (unsigned char)m->class_count++ : 0;
+  }
+  // All 256 bytes in use leaves class 0 empty, and 256 does not fit a byte.
+  if (m->class_count == 257) {
+    m->class_count = 256;
+    for (size_t b = 0; b < 256; b++) {
+      m->classes[b] = (unsigned char)b;
+    }
+  }
+
+  size_t max_states = total + 1;
+  if (max_states > SIZE_MAX / sizeof(uint32_t) / m->class_count) {
+    free(m);
+    return CSTRING_ERR_OVERFLOW;
+  }
+  m->lengths = malloc((count > 0 ? count : 1) * sizeof(size_t));
+  m->next = calloc(max_states * m->class_count, sizeof(uint32_t));
+  m->depth = calloc(max_states, sizeof(uint32_t));
+  m->output = calloc(max_states, sizeof(uint32_t));
+  uint32_t* links = calloc(max_states, sizeof(uint32_t));
+  uint32_t* queue = malloc(max_states * sizeof(uint32_t));
+  if (!m->lengths || !m->next || !m->depth || !m->output || !links ||
+      !queue) {
+    free(links);
+    free(queue);
+    multi_needle_destroy(m);
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  // Build the trie. Edge 0 means "no child" here, since no edge leads back
+  // to the root. A pattern that repeats an earlier one keeps the first index.
+  m->state_count = 1;
+  for (size_t p = 0; p < count; p++) {
+    size_t length = strlen(patterns[p]);
+    m->lengths[p] = length;
+    if (length == 0) {
+      continue;
+    }
+    uint32_t state = 0;
+    for (size_t i = 0; i < length; i++) {
+      uint32_t* edge = &m->next[state * m->class_count +
+                                m->classes[(unsigned char)patterns[p][i]]];
+      if (*edge == 0) {
+        *edge = (uint32_t)m->state_count++;
+        m->depth[*edge] = m->depth[state] + 1;
+      }
+      state = *edge;
+    }
+    if (m->output[state] == 0) {
+      m->output[state] = (uint32_t)p + 1;
+    }
+    if (m->single_bytes) {
+      m->byte_pattern[(unsigned char)patterns[p][0]] = m->output[state] - 1;
+    }
+  }
+
+  // Resolve the failure links breadth first. A state's failure target is
+  // shallower, so its row is complete by the time the state is visited, and
+  // each missing edge becomes the target's edge. A state that ends no pattern
+  // inherits the longest match of its failure target.
+  size_t head = 0;
+  size_t tail = 0;
+  queue[tail++] = 0;
+  while (head < tail) {
+    uint32_t state = queue[head++];
+    uint32_t* row = &m->next[state * m->class_count];
+    const uint32_t* fallback = &m->next[links[state] * m->class_count];
+    for (size_t c = 0; c < m->class_count; c++) {
+      uint32_t child = row[c];
+      if (child != 0) {
+        links[child] = state == 0 ? 0 : fallback[c];
+        if (m->output[child] == 0) {
+          m->output[child] = m->output[links[child]];
+        }
+        queue[tail++] = child;
+      } else {
+        row[c] = state == 0 ? 0 : fallback[c];
+      }
+    }
+  }
+  free(links);
+  free(queue);
+
+  *out = m;
+  return CSTRING_OK;
+}
+
+void multi_needle_destroy(c_string_multi_needle* needles) {
+  if (!needles) {
+    return;
+  }
+  free(needles->lengths);
+  free(needles->next);
+  free(needles->depth);
+  free(needles->output);
+  free(needles);
+}
+
+// Leftmost-longest match at or after `from`. Matches are reported by the
+// automaton as they end, so a match found first can still lose to one that
+// started earlier and ends later. The scan stops once the bytes the current
+// state spells start after the best match, since every later match starts
+// there or further right.
+static size_t find_any_bytes(const char* data, size_t length,
+                             const c_string_multi_needle* m, size_t from,
+                             size_t* pattern) {
+  if (!m || !data || from >= length) {
+    return CSTRING_NPOS;
+  }
+
+  if (m->single_bytes) {
+    size_t match = byte_set_find(&m->first_bytes, data, length, from);
+    if (match != CSTRING_NPOS && pattern) {
+      *pattern = m->byte_pattern[(unsigned char)data[match]];
+    }
+    return match;
+  }
+
+  size_t best = CSTRING_NPOS;
+  size_t best_pattern = 0;
+  uint32_t state = 0;
+  size_t i = from;
+  while (i < length) {
+    if (state == 0) {
+      if (best != CSTRING_NPOS) {
+        break;
+      }
+      // Nothing is under way: skip to the next byte a match can start with.
+      i = byte_set_find(&m->first_bytes, data, length, i);
+      if (i == CSTRING_NPOS) {
+        break;
+      }
+    }
+
+    unsigned char byte_class = m->classes[(unsigned char)data[i]];
+    state = m->next[state * m->class_count + byte_class];
+    i += 1;
+    if (best != CSTRING_NPOS && i - m->depth[state] > best) {
+      break;
+    }
+    if (m->output[state] != 0) {
+      size_t p = m->output[state] - 1;
+      size_t start = i - m->lengths[p];
+      if (best == CSTRING_NPOS || start <= best) {
+        best = start;
+        best_pattern = p;
+      }
+    }
+  }
+
+  if (best != CSTRING_NPOS && pattern) {
+    *pattern = best_pattern;
+  }
+  return best;
+}
+
+size_t string_find_any(const c_string* haystack,
+                       const c_string_multi_needle* needles, size_t from,
+                       size_t* pattern) {
+  if (!haystack) {
+    return CSTRING_NPOS;
+  }
+  return find_any_bytes(string_data(haystack), haystack->length, needles, from,
+                        pattern);
+}
+
+size_t view_find_any(c_string_view haystack,
+                     const c_string_multi_needle* needles, size_t from,
+                     size_t* pattern) {
+  return find_any_bytes(haystack.data, haystack.length, needles, from, pattern);
+}
+
+/* String View Functions */
+
+// Build a view over `length` bytes at `data`. When the bytes were cut from a
+// valid parent on code point boundaries they are valid by construction, so
+// only the code points are counted; anything else gets a full analysis.
+static c_string_view make_view(const char* data, size_t length,
+                               bool known_valid) {
+  c_string_view view = {.data = data,
+                        .length = length,
+                        .codepoint_length = 0,
+                        .utf8_valid = true};
+
+  if (length == 0) {
+    return view;
+  }
+
+  if (known_valid) {
+    view.codepoint_length = count_codepoints(data, length);
+    return view;
+  }
+
+  Utf8Analysis analysis = analyze_utf8(data, length);
+  view.codepoint_length = analysis.codepoints;
+  view.utf8_valid = analysis.valid;
+  return view;
+}
+
+c_string_view string_view(const c_string* s) {
+  c_string_view view = {.data = NULL,
+                        .length = 0,
+                        .codepoint_length = 0,
+                        .utf8_valid = true};
+
+  if (!s) {
+    return view;
+  }
+
+  view.data = string_data(s);
+  view.length = s->length;
+  view.codepoint_length = s->codepoint_length;
+  view.utf8_valid = s->utf8_valid;
+  return view;
+}
+
+CStringStatus view_from_char(const char* s, size_t length, c_string_view* out) {
+  if (!out || (length > 0 && !s)) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  c_string_view view = make_view(s, length, false);
+  if (!view.utf8_valid) {
+    return CSTRING_ERR_INVALID_UTF8;
+  }
+
+  *out = view;
+  return CSTRING_OK;
+}
+
+CStringResult string_from_view(c_string_view v) {
+  return string_from_view_in(NULL, v);
+}
+
+CStringResult string_from_view_in(c_string_arena* arena, c_string_view v) {
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  if (v.length > 0 && !v.data) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  c_string* new_s = allocate_string(arena, v.length);
+  if (!new_s) {
+    result.status = CSTRING_ERR_NO_MEMORY;
+    return result;
+  }
+
+  if (v.length == 0) {
+    result.value = new_s;
+    return result;
+  }
+
+  memcpy(new_s->string, v.data, v.length);
+
+  if (v.utf8_valid) {
+    // The view already carries validated metadata; no need to scan again.
+    new_s->codepoint_length = v.codepoint_length;
+    new_s->utf8_valid = true;
+  } else if (!update_utf8_metadata(new_s)) {
+    release_string(new_s);
+    result.status = CSTRING_ERR_INVALID_UTF8;
+    return result;
+  }
+
+  result.value = new_s;
+  return result;
+}
+
+CStringStatus view_sub_string_checked(c_string_view s, size_t start,
+                                      size_t end, c_string_view* out) {
+  if (!out || !s.data || s.length == 0) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  if (start > end || end >= s.length) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  if (s.utf8_valid) {
+    if (!is_codepoint_boundary(s.data, s.length, start) ||
+        !is_codepoint_boundary(s.data, s.length, end + 1)) {
+      return CSTRING_ERR_INVALID_UTF8;
+    }
+    out->data = s.data + start;
+    out->length = end - start + 1;
+    out->codepoint_length = count_slice_codepoints(
+        out->data, out->length, s.length, s.codepoint_length);
+    out->utf8_valid = true;
+    return CSTRING_OK;
+  }
+
+  c_string_view view = make_view(s.data + start, end - start + 1, false);
+  if (!view.utf8_valid) {
+    return CSTRING_ERR_INVALID_UTF8;
+  }
+
+  *out = view;
+  return CSTRING_OK;
+}
+
+CStringStatus view_sub_string_codepoint(c_string_view s, size_t start,
+                                        size_t end, c_string_view* out) {
+  if (!out || !s.data || s.codepoint_length == 0 || !s.utf8_valid) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  if (start > end || end >= s.codepoint_length) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  if (s.codepoint_length == s.length) {
+    // Pure ASCII: code points and bytes coincide.
+    out->data = s.data + start;
+    out->length = end - start + 1;
+    out->codepoint_length = out->length;
+    out->utf8_valid = true;
+    return CSTRING_OK;
+  }
+
+  size_t i = 0;
+  size_t codepoints = 0;
+  size_t byte_start = 0;
+
+  // Decode only as far as the last requested code point.
+  while (codepoints <= end) {
+    if (codepoints == start) {
+      byte_start = i;
+    }
+    if (!consume_utf8_sequence(s.data, s.length, &i, NULL)) {
+      return CSTRING_ERR_INVALID_UTF8;
+    }
+    codepoints += 1;
+  }
+
+  out->data = s.data + byte_start;
+  out->length = i - byte_start;
+  out->codepoint_length = end - start + 1;
+  out->utf8_valid = true;
+  return CSTRING_OK;
+}
+
+bool view_split_once(c_string_view s, const char* delim, c_string_view* before,
+                     c_string_view* after) {
+  size_t delim_size = delim ? strlen(delim) : 0;
+  c_string_needle needle;
+  needle_compile(&needle, delim, delim_size);
+  size_t match = view_find(s, &needle, 0);
+
+  if (match == CSTRING_NPOS) {
+    if (before) {
+      *before = s;
+    }
+    if (after) {
+      *after = make_view(s.data ? s.data + s.length : NULL, 0, true);
+    }
+    return false;
+  }
+
+  // A valid delimiter can only match on code point boundaries of a valid
+  // source, so both halves stay valid.
+  bool known_valid = s.utf8_valid && analyze_utf8(delim, delim_size).valid;
+  if (before) {
+    *before = make_view(s.data, match, known_valid);
+  }
+  if (after) {
+    size_t tail = match + delim_size;
+    *after = make_view(s.data + tail, s.length - tail, known_valid);
+  }
+  return true;
+}
+
+c_string_view view_strip_char(c_string_view s, const char c) {
+  size_t start = 0;
+  size_t end = s.length;
+
+  while (start < end && s.data[start] == c) {
+    start += 1;
+  }
+  while (end > start && s.data[end - 1] == c) {
+    end -= 1;
+  }
+
+  if (start == 0 && end == s.length) {
+    return s;
+  }
+
+  // Stripping an ASCII byte cannot split a multi-byte sequence, so the
+  // remaining code points are the original ones minus the bytes removed.
+  if (s.utf8_valid && (unsigned char)c < 0x80) {
+    c_string_view view = {.data = s.data + start,
+                          .length = end - start,
+                          .codepoint_length =
+                              s.codepoint_length - (s.length - (end - start)),
+                          .utf8_valid = true};
+    return view;
+  }
+
+  return make_view(s.data + start, end - start, false);
+}
+
+c_string_view view_strip_bytes(c_string_view s, const char* set,
+                               CStringStripSide side) {
+  bool in_set[256] = {false};
+  bool ascii_set = true;
+  for (const char* p = set; p && *p; p++) {
+    in_set[(unsigned char)*p] = true;
+    ascii_set = ascii_set && (unsigned char)*p < 0x80;
+  }
+
+  size_t start = 0;
+  size_t end = s.length;
+  if (side & CSTRING_STRIP_LEFT) {
+    while (start < end && in_set[(unsigned char)s.data[start]]) {
+      start += 1;
+    }
+  }
+  if (side & CSTRING_STRIP_RIGHT) {
+    while (end > start && in_set[(unsigned char)s.data[end - 1]]) {
+      end -= 1;
+    }
+  }
+
+  if (start == 0 && end == s.length) {
+    return s;
+  }
+
+  // As in view_strip_char, removed ASCII bytes are removed code points.
+  if (s.utf8_valid && ascii_set) {
+    c_string_view view = {.data = s.data + start,
+                          .length = end - start,
+                          .codepoint_length =
+                              s.codepoint_length - (s.length - (end - start)),
+                          .utf8_valid = true};
+    return view;
+  }
+
+  return make_view(s.data + start, end - start, false);
+}
+
+// Code points with the Unicode White_Space property
+static bool is_unicode_whitespace(uint32_t codepoint) {
+  if (codepoint < 0x80) {
+    return codepoint == ' ' || (codepoint >= '\t' && codepoint <= '\r');
+  }
+  switch (codepoint) {
+    case 0x85:
+    case 0xA0:
+    case 0x1680:
+    case 0x2028:
+    case 0x2029:
+    case 0x202F:
+    case 0x205F:
+    case 0x3000:
+      return true;
+    default:
+      return codepoint >= 0x2000 && codepoint <= 0x200A;
+  }
+}
+
+c_string_view view_strip_whitespace(c_string_view s, CStringStripSide side) {
+  size_t start = 0;
+  size_t end = s.length;
+  size_t removed = 0;
+  uint32_t codepoint = 0;
+
+  if (side & CSTRING_STRIP_LEFT) {
+    while (start < end) {
+      size_t next = start;
+      if (!decode_utf8_sequence(s.data, end, &next, NULL, &codepoint) ||
+          !is_unicode_whitespace(codepoint)) {
+        break;
+      }
+      start = next;
+      removed += 1;
+    }
+  }
+
+  if (side & CSTRING_STRIP_RIGHT) {
+    while (end > start) {
+      // Step back to the lead byte of the last sequence and decode forwards.
+      size_t lead = end - 1;
+      while (lead > start && end - lead < 4 &&
+             ((unsigned char)s.data[lead] & 0xC0) == 0x80) {
+        lead -= 1;
+      }
+      size_t next = lead;
+      if (!decode_utf8_sequence(s.data, end, &next, NULL, &codepoint) ||
+          next != end || !is_unicode_whitespace(codepoint)) {
+        break;
+      }
+      end = lead;
+      removed += 1;
+    }
+  }
+
+  if (start == 0 && end == s.length) {
+    return s;
+  }
+
+  // Whole code points came off the ends of valid input.
+  if (s.utf8_valid) {
+    c_string_view view = {.data = s.data + start,
+                          .length = end - start,
+                          .codepoint_length = s.codepoint_length - removed,
+                          .utf8_valid = true};
+    return view;
+  }
+
+  return make_view(s.data + start, end - start, false);
+}
+
+int view_compare(c_string_view first, c_string_view second) {
+  if (first.length > second.length) {
+    return 1;
+  } else if (first.length < second.length) {
+    return -1;
+  }
+
+  if (first.length == 0) {
+    return 0;
+  }
+
+  return memcmp(first.data, second.data, first.length);
+}
+
+// Byte order, which for UTF-8 is also code point order. A proper prefix sorts
+// first.
+int view_compare_lex(c_string_view first, c_string_view second) {
+  size_t common = first.length < second.length ? first.length : second.length;
+  int order = common > 0 ? memcmp(first.data, second.data, common) : 0;
+  if (order != 0) {
+    return order;
+  }
+  return (first.length > second.length) - (first.length < second.length);
+}
+
+// Reject on the cheap checks first: the lengths, the code point counts when
+// both are known, and the last byte, since equal-length keys often share a
+// prefix.
+bool view_equals(c_string_view first, c_string_view second) {
+  if (first.length != second.length) {
+    return false;
+  }
+  if (first.length == 0) {
+    return true;
+  }
+  if (first.utf8_valid && second.utf8_valid &&
+      first.codepoint_length != second.codepoint_length) {
+    return false;
+  }
+  if (first.data[first.length - 1] != second.data[second.length - 1]) {
+    return false;
+  }
+  return memcmp(first.data, second.data, first.length) == 0;
+}
+
+bool view_starts_with(c_string_view s, const char* prefix) {
+  size_t length = prefix ? strlen(prefix) : 0;
+  return length <= s.length &&
+         (length == 0 || memcmp(s.data, prefix, length) == 0);
+}
+
+bool view_ends_with(c_string_view s, const char* suffix) {
+  size_t length = suffix ? strlen(suffix) : 0;
+  return length <= s.length &&
+         (length == 0 ||
+          memcmp(s.data + s.length - length, suffix, length) == 0);
+}
+
+static unsigned char fold_ascii(char c) {
+  unsigned char byte = (unsigned char)c;
+  return byte >= 'A' && byte <= 'Z' ? (unsigned char)(byte + 0x20) : byte;
+}
+
+// Index of the first byte where `first` and `second` differ once ASCII
+// letters are folded to lowercase, or `length` when they never do
+static size_t mismatch_ignore_case_scalar(const char* first,
+                                          const char* second, size_t length) {
+  size_t i = 0;
+  while (i < length && fold_ascii(first[i]) == fold_ascii(second[i])) {
+    i += 1;
+  }
+  return i;
+}
+
+#if CSTRING_X86_SIMD
+
+// Signed compares leave bytes >= 0x80 alone, as the scalar fold does.
+static __m128i fold_ascii_sse2(__m128i block) {
+  __m128i upper =
+      _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('A' - 1)),
+                    _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), block));
+  return _mm_or_si128(block, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+static size_t mismatch_ignore_case_sse2(const char* first, const char* second,
+                                        size_t length) {
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(const void*)(first + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(const void*)(second + i));
+    unsigned int equal = (unsigned int)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(fold_ascii_sse2(a), fold_ascii_sse2(b)));
+    if (equal != 0xFFFFu) {
+      return i + (size_t)__builtin_ctz(~equal);
+    }
+  }
+  return i + mismatch_ignore_case_scalar(first + i, second + i, length - i);
+}
+
+__attribute__((target("avx2"))) static __m256i fold_ascii_avx2(
+    __m256i block) {
+  __m256i upper =
+      _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('A' - 1)),
+                       _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), block));
+  return _mm256_or_si256(block,
+                         _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2"))) static size_t mismatch_ignore_case_avx2(
+    const char* first, const char* second, size_t length) {
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(const void*)(first + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(const void*)(second + i));
+    unsigned int equal = (unsigned int)_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(fold_ascii_avx2(a), fold_ascii_avx2(b)));
+    if (equal != 0xFFFFFFFFu) {
+      return i + (size_t)__builtin_ctz(~equal);
+    }
+  }
+  return i + mismatch_ignore_case_sse2(first + i, second + i, length - i);
+}
+
+#endif  // CSTRING_X86_SIMD
+
+static size_t mismatch_ignore_case(const char* first, const char* second,
+                                   size_t length) {
+#if CSTRING_X86_SIMD
+  if (simd_enabled) {
+    if (__builtin_cpu_supports("avx2")) {
+      return mismatch_ignore_case_avx2(first, second, length);
+    }
+    return mismatch_ignore_case_sse2(first, second, length);
+  }
+#endif
+  return mismatch_ignore_case_scalar(first, second, length);
+}
+
+int view_compare_ignore_case(c_string_view first, c_string_view second) {
+  size_t common = first.length < second.length ? first.length : second.length;
+  size_t i = mismatch_ignore_case(first.data, second.data, common);
+  if (i < common) {
+    return (int)fold_ascii(first.data[i]) - (int)fold_ascii(second.data[i]);
+  }
+  return (first.length > second.length) - (first.length < second.length);
+}
+
+bool view_equals_ignore_case(c_string_view first, c_string_view second) {
+  // Folding ASCII letters never changes the byte length.
+  return first.length == second.length &&
+         mismatch_ignore_case(first.data, second.data, first.length) ==
+             first.length;
+}
+
+/* Hashing */
+
+// wyhash (final version 4, public domain) by Wang Yi
+static const uint64_t wyhash_secret[4] = {
+    UINT64_C(0x2d358dccaa6c78a5), UINT64_C(0x8bb84b93962eacc9),
+    UINT64_C(0x4b33a62ed433d4a3), UINT64_C(0x4d5a2da51de1aa47)};
+
+// 64 x 64 -> 128-bit multiply, low half in *a and high half in *b
+static void wyhash_multiply(uint64_t* a, uint64_t* b) {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t product = (__uint128_t)*a * *b;
+  *a = (uint64_t)product;
+  *b = (uint64_t)(product >> 64);
+#else
+  uint64_t a_high = *a >> 32, a_low = (uint32_t)*a;
+  uint64_t b_high = *b >> 32, b_low = (uint32_t)*b;
+  uint64_t high = a_high * b_high, middle0 = a_high * b_low;
+  uint64_t middle1 = b_high * a_low, low = a_low * b_low;
+  uint64_t t = low + (middle0 << 32);
+  uint64_t carry = t < low;
+  uint64_t low_half = t + (middle1 << 32);
+  carry += low_half < t;
+  *a = low_half;
+  *b = high + (middle0 >> 32) + (middle1 >> 32) + carry;
+#endif
+}
+
+static uint64_t wyhash_mix(uint64_t a, uint64_t b) {
+  wyhash_multiply(&a, &b);
+  return a ^ b;
+}
+
+static uint64_t wyhash_read8(const unsigned char* p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static uint64_t wyhash_read4(const unsigned char* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+uint64_t cstring_hash(const void* data, size_t length, uint64_t seed) {
+  const unsigned char* p = data;
+  const uint64_t* secret = wyhash_secret;
+  uint64_t a = 0;
+  uint64_t b = 0;
+
+  seed ^= wyhash_mix(seed ^ secret[0], secret[1]);
+
+  if (length <= 16) {
+    if (length >= 4) {
+      size_t middle = (length >> 3) << 2;
+      a = (wyhash_read4(p) << 32) | wyhash_read4(p + middle);
+      b = (wyhash_read4(p + length - 4) << 32) |
+          wyhash_read4(p + length - 4 - middle);
+    } else if (length > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) |
+          p[length - 1];
+    }
+  } else {
+    size_t i = length;
+    if (i >= 48) {
+      uint64_t seed1 = seed;
+      uint64_t seed2 = seed;
+      do {
+        seed = wyhash_mix(wyhash_read8(p) ^ secret[1],
+                          wyhash_read8(p + 8) ^ seed);
+        seed1 = wyhash_mix(wyhash_read8(p + 16) ^ secret[2],
+                           wyhash_read8(p + 24) ^ seed1);
+        seed2 = wyhash_mix(wyhash_read8(p + 32) ^ secret[3],
+                           wyhash_read8(p + 40) ^ seed2);
+        p += 48;
+        i -= 48;
+      } while (i >= 48);
+      seed ^= seed1 ^ seed2;
+    }
+    while (i > 16) {
+      seed =
+          wyhash_mix(wyhash_read8(p) ^ secret[1], wyhash_read8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    // The last 16 bytes, overlapping what was already mixed if need be
+    a = wyhash_read8(p + i - 16);
+    b = wyhash_read8(p + i - 8);
+  }
+
+  a ^= secret[1];
+  b ^= seed;
+  wyhash_multiply(&a, &b);
+  return wyhash_mix(a ^ secret[0] ^ length, b ^ secret[1]);
+}
+
+uint64_t string_hash(const c_string* s, uint64_t seed) {
+  return view_hash(string_view(s), seed);
+}
+
+uint64_t view_hash(c_string_view v, uint64_t seed) {
+  return cstring_hash(v.data, v.length, seed);
+}
+
+/* Hash Map */
+
+#define MAP_GROUP_SIZE 16
+#define MAP_EMPTY ((signed char)-128)
+#define MAP_DELETED ((signed char)-2)
+#define MAP_DEFAULT_SEED UINT64_C(0x9E3779B97F4A7C15)
+
+// Full slots hold the low 7 bits of their hash (0..127), so a signed control
+// byte is negative exactly when the slot is free.
+static signed char map_tag(uint64_t hash) { return (signed char)(hash & 0x7F); }
+
+// Bit i is set when control byte i of the group equals `tag`
+static unsigned int map_group_match(const signed char* group, signed char tag) {
+#if CSTRING_X86_SIMD
+  if (simd_enabled) {
+    __m128i control = _mm_loadu_si128((const __m128i*)(const void*)group);
+    return (unsigned int)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(control, _mm_set1_epi8(tag)));
+  }
+#endif
+  unsigned int mask = 0;
+  for (unsigned int i = 0; i < MAP_GROUP_SIZE; i++) {
+    mask |= (unsigned int)(group[i] == tag) << i;
+  }
+  return mask;
+}
+
+// Bit i is set when slot i of the group is empty or deleted
+static unsigned int map_group_free(const signed char* group) {
+#if CSTRING_X86_SIMD
+  if (simd_enabled) {
+    __m128i control = _mm_loadu_si128((const __m128i*)(const void*)group);
+    return (unsigned int)_mm_movemask_epi8(control);
+  }
+#endif
+  unsigned int mask = 0;
+  for (unsigned int i = 0; i < MAP_GROUP_SIZE; i++) {
+    mask |= (unsigned int)(group[i] < 0) << i;
+  }
+  return mask;
+}
+
+// Groups are probed in triangular steps (1, 2, 3, ... groups further on),
+// which visits every group of a power-of-two table exactly once.
+static size_t map_first_group(const c_string_map* m, uint64_t hash) {
+  return (size_t)(hash >> 7) & (m->capacity / MAP_GROUP_SIZE - 1);
+}
+
+// Slot holding `key`, or CSTRING_NPOS. The probe stops at the first group with
+// an empty slot: an insertion would have used it.
+static size_t map_find(const c_string_map* m, c_string_view key,
+                       uint64_t hash) {
+  if (m->capacity == 0) {
+    return CSTRING_NPOS;
+  }
+
+  size_t group_mask = m->capacity / MAP_GROUP_SIZE - 1;
+  size_t group = map_first_group(m, hash);
+  signed char tag = map_tag(hash);
+
+  for (size_t step = 1; step <= group_mask + 1; step++) {
+    const signed char* control = m->control + group * MAP_GROUP_SIZE;
+    for (unsigned int hits = map_group_match(control, tag); hits != 0;
+         hits &= hits - 1) {
+      size_t slot = group * MAP_GROUP_SIZE + (size_t)__builtin_ctz(hits);
+      const c_string_map_entry* entry = &m->entries[slot];
+      if (entry->hash == hash && view_equals(string_view(entry->key), key)) {
+        return slot;
+      }
+    }
+    if (map_group_match(control, MAP_EMPTY) != 0) {
+      return CSTRING_NPOS;
+    }
+    group = (group + step) & group_mask;
+  }
+  return CSTRING_NPOS;
+}
+
+// First empty or deleted slot on the probe sequence of `hash`. The load limit
+// guarantees one exists.
+static size_t map_free_slot(const c_string_map* m, uint64_t hash) {
+  size_t group_mask = m->capacity / MAP_GROUP_SIZE - 1;
+  size_t group = map_first_group(m, hash);
+
+  for (size_t step = 1;; step++) {
+    unsigned int free_slots =
+        map_group_free(m->control + group * MAP_GROUP_SIZE);
+    if (free_slots != 0) {
+      return group * MAP_GROUP_SIZE + (size_t)__builtin_ctz(free_slots);
+    }
+    group = (group + step) & group_mask;
+  }
+}
+
+// Entries may use at most 7/8 of the slots, tombstones included
+static size_t map_max_load(size_t capacity) { return capacity / 8 * 7; }
+
+// Move every live entry into a fresh table of `capacity` slots, dropping
+// tombstones. Stored hashes are reused, so no key is hashed again.
+static CStringStatus map_resize(c_string_map* m, size_t capacity) {
+  if (capacity > SIZE_MAX / (sizeof(c_string_map_entry) + 1)) {
+    return CSTRING_ERR_OVERFLOW;
+  }
+
+  // Entries and control bytes share one allocation.
+  c_string_map_entry* entries =
+      malloc(capacity * (sizeof(c_string_map_entry) + 1));
+  if (!entries) {
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  c_string_map old = *m;
+  m->entries = entries;
+  m->control = (signed char*)(entries + capacity);
+  m->capacity = capacity;
+  m->deleted = 0;
+  memset(m->control, MAP_EMPTY, capacity);
+
+  for (size_t i = 0; i < old.capacity; i++) {
+    if (old.control[i] >= 0) {
+      size_t slot = map_free_slot(m, old.entries[i].hash);
+      m->control[slot] = old.control[i];
+      m->entries[slot] = old.entries[i];
+    }
+  }
+
+  free(old.entries);
+  return CSTRING_OK;
+}
+
+CStringStatus string_map_init(c_string_map* m, size_t initial_capacity) {
+  if (!m) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  m->entries = NULL;
+  m->control = NULL;
+  m->capacity = 0;
+  m->count = 0;
+  m->deleted = 0;
+  m->seed = MAP_DEFAULT_SEED;
+
+  if (initial_capacity == 0) {
+    return CSTRING_OK;
+  }
+
+  size_t capacity = MAP_GROUP_SIZE;
+  while (map_max_load(capacity) < initial_capacity) {
+    if (capacity > SIZE_MAX / 2) {
+      return CSTRING_ERR_OVERFLOW;
+    }
+    capacity *= 2;
+  }
+  return map_resize(m, capacity);
+}
+
+void string_map_destroy(c_string_map* m) {
+  if (!m) {
+    return;
+  }
+
+  for (size_t i = 0; i < m->capacity; i++) {
+    if (m->control[i] >= 0) {
+      destroy_string(m->entries[i].key);
+    }
+  }
+  free(m->entries);
+  m->entries = NULL;
+  m->control = NULL;
+  m->capacity = 0;
+  m->count = 0;
+  m->deleted = 0;
+}
+
+// Store `key`, which must not be in the map yet, taking ownership of it.
+static CStringStatus map_insert(c_string_map* m, uint64_t hash, c_string* key,
+                                void* value) {
+  if (m->count + m->deleted + 1 > map_max_load(m->capacity)) {
+    // Double when live entries fill half the table; otherwise clearing the
+    // tombstones makes enough room.
+    size_t capacity = m->capacity ? m->capacity : MAP_GROUP_SIZE;
+    if (m->count + 1 > map_max_load(capacity) / 2) {
+      if (capacity > SIZE_MAX / 2) {
+        return CSTRING_ERR_OVERFLOW;
+      }
+      capacity *= 2;
+    }
+    CStringStatus status = map_resize(m, capacity);
+    if (status != CSTRING_OK) {
+      return status;
+    }
+  }
+
+  size_t slot = map_free_slot(m, hash);
+  if (m->control[slot] == MAP_DELETED) {
+    m->deleted -= 1;
+  }
+  m->control[slot] = map_tag(hash);
+  m->entries[slot].key = key;
+  m->entries[slot].value = value;
+  m->entries[slot].hash = hash;
+  m->count += 1;
+  return CSTRING_OK;
+}
+
+CStringStatus string_map_put(c_string_map* m, c_string_view key, void* value) {
+  if (!m || (key.length > 0 && !key.data)) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  uint64_t hash = view_hash(key, m->seed);
+  size_t slot = map_find(m, key, hash);
+  if (slot != CSTRING_NPOS) {
+    m->entries[slot].value = value;
+    return CSTRING_OK;
+  }
+
+  // Keys are compared and hashed as bytes, so one that is not valid UTF-8 is
+  // stored as is with its metadata saying so, not refused like
+  // string_from_view would.
+  c_string* copy = allocate_string(NULL, key.length);
+  if (!copy) {
+    return CSTRING_ERR_NO_MEMORY;
+  }
+  if (key.length > 0) {
+    memcpy(copy->string, key.data, key.length);
+  }
+  if (key.utf8_valid) {
+    copy->codepoint_length = key.codepoint_length;
+    copy->utf8_valid = true;
+  } else {
+    update_utf8_metadata(copy);
+  }
+
+  CStringStatus status = map_insert(m, hash, copy, value);
+  if (status != CSTRING_OK) {
+    destroy_string(copy);
+  }
+  return status;
+}
+
+bool string_map_get(const c_string_map* m, c_string_view key, void** value) {
+  if (!m) {
+    return false;
+  }
+
+  size_t slot = map_find(m, key, view_hash(key, m->seed));
+  if (slot == CSTRING_NPOS) {
+    return false;
+  }
+  if (value) {
+    *value = m->entries[slot].value;
+  }
+  return true;
+}
+
+bool string_map_remove(c_string_map* m, c_string_view key, void** value) {
+  if (!m) {
+    return false;
+  }
+
+  size_t slot = map_find(m, key, view_hash(key, m->seed));
+  if (slot == CSTRING_NPOS) {
+    return false;
+  }
+
+  if (value) {
+    *value = m->entries[slot].value;
+  }
+  destroy_string(m->entries[slot].key);
+  m->count -= 1;
+
+  // Probes stop at a group with an empty slot, so none ever passed this group
+  // if it has one, and the slot can become empty again instead of a tombstone.
+  size_t group = slot / MAP_GROUP_SIZE * MAP_GROUP_SIZE;
+  if (map_group_match(m->control + group, MAP_EMPTY) != 0) {
+    m->control[slot] = MAP_EMPTY;
+  } else {
+    m->control[slot] = MAP_DELETED;
+    m->deleted += 1;
+  }
+  return true;
+}
+
+bool string_map_next(const c_string_map* m, size_t* cursor,
+                     const c_string** key, void** value) {
+  if (!m || !cursor) {
+    return false;
+  }
+
+  while (*cursor < m->capacity) {
+    size_t slot = (*cursor)++;
+    if (m->control[slot] >= 0) {
+      if (key) {
+        *key = m->entries[slot].key;
+      }
+      if (value) {
+        *value = m->entries[slot].value;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+/* String Interning */
+
+#define INTERN_DEFAULT_STRIPES 16
+#define INTERN_MAX_STRIPES 1024
+
+// One lock-protected pool of a shared pool
+struct c_string_intern_stripe {
+#if CSTRING_HAVE_THREADS
+  pthread_mutex_t lock;
+#endif
+  c_string_intern_pool pool;
+};
+
+CStringStatus intern_pool_init(c_string_intern_pool* pool) {
+  if (!pool) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  pool->hits = 0;
+  pool->misses = 0;
+  pool->string_bytes = 0;
+  CStringStatus status = string_map_init(&pool->table, 0);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+  status = arena_init(&pool->arena, 0);
+  if (status != CSTRING_OK) {
+    string_map_destroy(&pool->table);
+  }
+  return status;
+}
+
+void intern_pool_destroy(c_string_intern_pool* pool) {
+  if (!pool) {
+    return;
+  }
+
+  // The keys are arena strings, which string_map_destroy leaves alone.
+  string_map_destroy(&pool->table);
+  arena_destroy(&pool->arena);
+}
+
+// intern_pool_get with the hash of `v` under the table's seed already known
+static CStringStatus intern_pool_get_hashed(c_string_intern_pool* pool,
+                                            c_string_view v, uint64_t hash,
+                                            const c_string** out) {
+  size_t slot = map_find(&pool->table, v, hash);
+  if (slot != CSTRING_NPOS) {
+    pool->hits += 1;
+    *out = pool->table.entries[slot].key;
+    return CSTRING_OK;
+  }
+
+  CStringResult copy = string_from_view_in(&pool->arena, v);
+  if (copy.status != CSTRING_OK) {
+    return copy.status;
+  }
+
+  CStringStatus status = map_insert(&pool->table, hash, copy.value, NULL);
+  if (status != CSTRING_OK) {
+    release_string(copy.value);
+    return status;
+  }
+
+  pool->misses += 1;
+  pool->string_bytes += v.length;
+  *out = copy.value;
+  return CSTRING_OK;
+}
+
+CStringStatus intern_pool_get(c_string_intern_pool* pool, c_string_view v,
+                              const c_string** out) {
+  if (!pool || !out || (v.length > 0 && !v.data)) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  return intern_pool_get_hashed(pool, v, view_hash(v, pool->table.seed), out);
+}
+
+// Bytes held by the arena's blocks, headers included
+static size_t arena_footprint(const c_string_arena* arena) {
+  size_t bytes = 0;
+  for (const c_string_arena_block* block = arena->head; block;
+       block = block->next) {
+    bytes += ARENA_BLOCK_HEADER + block->capacity;
+  }
+  return bytes;
+}
+
+void intern_pool_stats(const c_string_intern_pool* pool,
+                       c_string_intern_stats* stats) {
+  if (!pool || !stats) {
+    return;
+  }
+
+  stats->strings = pool->table.count;
+  stats->hits = pool->hits;
+  stats->misses = pool->misses;
+  stats->string_bytes = pool->string_bytes;
+  stats->memory_bytes =
+      arena_footprint(&pool->arena) +
+      pool->table.capacity * (sizeof(c_string_map_entry) + 1);
+}
+
+CStringStatus shared_intern_pool_init(c_string_shared_intern_pool* pool,
+                                      size_t stripe_count) {
+  if (!pool || stripe_count > INTERN_MAX_STRIPES) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  size_t count = 1;
+  while (count < (stripe_count ? stripe_count : INTERN_DEFAULT_STRIPES)) {
+    count *= 2;
+  }
+
+  pool->stripes = calloc(count, sizeof(c_string_intern_stripe));
+  if (!pool->stripes) {
+    return CSTRING_ERR_NO_MEMORY;
+  }
+  pool->stripe_count = count;
+
+  for (size_t i = 0; i < count; i++) {
+    CStringStatus status = intern_pool_init(&pool->stripes[i].pool);
+#if CSTRING_HAVE_THREADS
+    if (status == CSTRING_OK &&
+        pthread_mutex_init(&pool->stripes[i].lock, NULL) != 0) {
+      intern_pool_destroy(&pool->stripes[i].pool);
+      status = CSTRING_ERR_INTERNAL;
+    }
+#endif
+    if (status != CSTRING_OK) {
+      pool->stripe_count = i;
+      shared_intern_pool_destroy(pool);
+      return status;
+    }
+  }
+  return CSTRING_OK;
+}
+
+void shared_intern_pool_destroy(c_string_shared_intern_pool* pool) {
+  if (!pool || !pool->stripes) {
+    return;
+  }
+
+  for (size_t i = 0; i < pool->stripe_count; i++) {
+    intern_pool_destroy(&pool->stripes[i].pool);
+#if CSTRING_HAVE_THREADS
+    pthread_mutex_destroy(&pool->stripes[i].lock);
+#endif
+  }
+  free(pool->stripes);
+  pool->stripes = NULL;
+  pool->stripe_count = 0;
+}
+
+CStringStatus shared_intern_pool_get(c_string_shared_intern_pool* pool,
+                                     c_string_view v, const c_string** out) {
+  if (!pool || !pool->stripes || !out || (v.length > 0 && !v.data)) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  // Every stripe's table uses the default seed, so the hash is computed once
+  // and outside the lock. The table uses the low bits; the stripe takes high
+  // ones.
+  c_string_intern_stripe* stripe = &pool->stripes[0];
+  uint64_t hash = view_hash(v, stripe->pool.table.seed);
+  stripe = &pool->stripes[(size_t)(hash >> 48) & (pool->stripe_count - 1)];
+
+#if CSTRING_HAVE_THREADS
+  pthread_mutex_lock(&stripe->lock);
+#endif
+  CStringStatus status = intern_pool_get_hashed(&stripe->pool, v, hash, out);
+#if CSTRING_HAVE_THREADS
+  pthread_mutex_unlock(&stripe->lock);
+#endif
+  return status;
+}
+
+void shared_intern_pool_stats(const c_string_shared_intern_pool* pool,
+                              c_string_intern_stats* stats) {
+  if (!pool || !stats) {
+    return;
+  }
+
+  memset(stats, 0, sizeof(*stats));
+  for (size_t i = 0; i < pool->stripe_count; i++) {
+    c_string_intern_stripe* stripe = &pool->stripes[i];
+    c_string_intern_stats part;
+#if CSTRING_HAVE_THREADS
+    pthread_mutex_lock(&stripe->lock);
+#endif
+    intern_pool_stats(&stripe->pool, &part);
+#if CSTRING_HAVE_THREADS
+    pthread_mutex_unlock(&stripe->lock);
+#endif
+    stats->strings += part.strings;
+    stats->hits += part.hits;
+    stats->misses += part.misses;
+    stats->string_bytes += part.string_bytes;
+    stats->memory_bytes += part.memory_bytes;
+  }
+  stats->memory_bytes += pool->stripe_count * sizeof(c_string_intern_stripe);
+}
+
+/* String Builder */
+
+CStringStatus builder_init(c_string_builder* b, size_t initial_capacity) {
+  return builder_init_in(b, NULL, initial_capacity);
+}
+
+CStringStatus builder_init_in(c_string_builder* b, c_string_arena* arena,
+                              size_t initial_capacity) {
+  if (!b) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  b->string = allocate_string(arena, 0);
+  if (!b->string) {
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  if (!reserve_payload(b->string, initial_capacity)) {
+    destroy_string(b->string);
+    b->string = NULL;
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  return CSTRING_OK;
+}
+
+CStringStatus builder_append_bytes(c_string_builder* b, const char* bytes,
+                                   size_t length) {
+  if (!b || !b->string) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  return string_append(b->string, bytes, length);
+}
+
+CStringStatus builder_append_cstr(c_string_builder* b, const char* input) {
+  if (!input) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  return builder_append_bytes(b, input, strlen(input));
+}
+
+CStringStatus builder_append_char(c_string_builder* b, const char c) {
+  return builder_append_bytes(b, &c, 1);
+}
+
+CStringStatus builder_append_printf(c_string_builder* b, const char* fmt,
+                                    ...) {
+  va_list args;
+  va_start(args, fmt);
+  CStringStatus status = builder_append_vprintf(b, fmt, args);
+  va_end(args);
+  return status;
+}
+
+CStringStatus builder_append_vprintf(c_string_builder* b, const char* fmt,
+                                     va_list args) {
+  if (!b || !b->string || !fmt) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  c_string* s = b->string;
+  va_list retry;
+  va_copy(retry, args);
+
+  size_t spare = payload_capacity(s) - s->length;
+  int written = vsnprintf(spare > 0 ? s->string + s->length : NULL, spare,
+                          fmt, args);
+
+  // Malformed format strings, encoding errors or other problems can make
+  // vsnprintf return a negative value instead of a byte count.
+  if (written < 0) {
+    va_end(retry);
+    return CSTRING_ERR_INTERNAL;
+  }
+
+  // vsnprintf also needs room for its terminator, which lands in the spare
+  // capacity and is never counted in `length`.
+  if ((size_t)written >= spare) {
+    CStringStatus status = grow_payload(s, (size_t)written + 1);
+    if (status != CSTRING_OK) {
+      va_end(retry);
+      return status;
+    }
+
+    spare = payload_capacity(s) - s->length;
+    int rewritten = vsnprintf(s->string + s->length, spare, fmt, retry);
+    if (rewritten != written) {
+      // Live state (locale changes, shared buffers) diverged between the two
+      // passes.
+      va_end(retry);
+      return CSTRING_ERR_INTERNAL;
+    }
+  }
+  va_end(retry);
+
+  size_t old_length = s->length;
+  s->length += (size_t)written;
+  update_appended_metadata(s, old_length);
+  return CSTRING_OK;
+}
+
+CStringResult builder_finish(c_string_builder* b) {
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  if (!b || !b->string) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  result.value = b->string;
+  b->string = NULL;
+  return result;
+}
+
+void builder_destroy(c_string_builder* b) {
+  if (!b || !b->string) {
+    return;
+  }
+
+  destroy_string(b->string);
+  b->string = NULL;
+}
+
+/* Ropes */
+
+// Text is cut into leaves of at most this many bytes, and neighbouring leaves
+// that fit together are merged after an edit, so a split never copies more
+// than one leaf and a run of small inserts does not leave a leaf per insert.
+#define ROPE_LEAF_SIZE ((size_t)1024)
+
+// Leaves hold a c_string; interior nodes are balanced like an AVL tree, with
+// the heights of the two children differing by at most one.
+struct c_string_rope_node {
+  c_string_rope_node* left;
+  c_string_rope_node* right;
+  c_string* leaf;           // leaves only
+  size_t length;            // bytes below this node
+  size_t codepoint_length;  // code points below this node
+  size_t refs;
+  unsigned char height;     // 1 for leaves
+};
+
+static c_string_rope_node* rope_ref(c_string_rope_node* n) {
+  if (n) {
+    n->refs += 1;
+  }
+  return n;
+}
+
+static void rope_unref(c_string_rope_node* n) {
+  // Recurse on the left and loop on the right; the depth is bounded by the
+  // tree's height.
+  while (n && --n->refs == 0) {
+    c_string_rope_node* next = n->right;
+    rope_unref(n->left);
+    if (n->leaf) {
+      destroy_string(n->leaf);
+    }
+    free(n);
+    n = next;
+  }
+}
+
+// Leaf holding a copy of `length` bytes of valid UTF-8
+static CStringStatus rope_leaf_new(const char* data, size_t length,
+                                   size_t codepoints,
+                                   c_string_rope_node** out) {
+  c_string_rope_node* n = malloc(sizeof(*n));
+  if (!n) {
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  c_string_view bytes = {data, length, codepoints, true};
+  CStringResult leaf = string_from_view(bytes);
+  if (leaf.status != CSTRING_OK) {
+    free(n);
+    return leaf.status;
+  }
+
+  n->left = NULL;
+  n->right = NULL;
+  n->leaf = leaf.value;
+  n->length = length;
+  n->codepoint_length = codepoints;
+  n->refs = 1;
+  n->height = 1;
+  *out = n;
+  return CSTRING_OK;
+}
+
+// Interior node over two non-empty trees. Both references are handed over,
+// also when the allocation fails.
+static CStringStatus rope_node_new(c_string_rope_node* left,
+                                   c_string_rope_node* right,
+                                   c_string_rope_node** out) {
+  c_string_rope_node* n = malloc(sizeof(*n));
+  if (!n) {
+    rope_unref(left);
+    rope_unref(right);
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  n->left = left;
+  n->right = right;
+  n->leaf = NULL;
+  n->length = left->length + right->length;
+  n->codepoint_length = left->codepoint_length + right->codepoint_length;
+  n->refs = 1;
+  n->height = (unsigned char)(1 + (left->height > right->height
+                                       ? left->height
+                                       : right->height));
+  *out = n;
+  return CSTRING_OK;
+}
+
+// rope_node_new for trees whose heights differ by up to two, rotating once or
+// twice to restore the balance.
+static CStringStatus rope_balance(c_string_rope_node* a, c_string_rope_node* b,
+                                  c_string_rope_node** out) {
+  CStringStatus status = CSTRING_OK;
+  c_string_rope_node* x = NULL;
+  c_string_rope_node* y = NULL;
+
+  if (a->height > b->height + 1) {
+    c_string_rope_node* al = rope_ref(a->left);
+    c_string_rope_node* ar = rope_ref(a->right);
+    rope_unref(a);
+
+    if (al->height >= ar->height) {
+      status = rope_node_new(ar, b, &y);
+      if (status != CSTRING_OK) {
+        rope_unref(al);
+        return status;
+      }
+      return rope_node_new(al, y, out);
+    }
+
+    c_string_rope_node* arl = rope_ref(ar->left);
+    c_string_rope_node* arr = rope_ref(ar->right);
+    rope_unref(ar);
+    status = rope_node_new(al, arl, &x);
+    if (status != CSTRING_OK) {
+      rope_unref(arr);
+      rope_unref(b);
+      return status;
+    }
+    status = rope_node_new(arr, b, &y);
+    if (status != CSTRING_OK) {
+      rope_unref(x);
+      return status;
+    }
+    return rope_node_new(x, y, out);
+  }
+
+  if (b->height > a->height + 1) {
+    c_string_rope_node* bl = rope_ref(b->left);
+    c_string_rope_node* br = rope_ref(b->right);
+    rope_unref(b);
+
+    if (br->height >= bl->height) {
+      status = rope_node_new(a, bl, &x);
+      if (status != CSTRING_OK) {
+        rope_unref(br);
+        return status;
+      }
+      return rope_node_new(x, br, out);
+    }
+
+    c_string_rope_node* bll = rope_ref(bl->left);
+    c_string_rope_node* blr = rope_ref(bl->right);
+    rope_unref(bl);
+    status = rope_node_new(a, bll, &x);
+    if (status != CSTRING_OK) {
+      rope_unref(blr);
+      rope_unref(br);
+      return status;
+    }
+    status = rope_node_new(blr, br, &y);
+    if (status != CSTRING_OK) {
+      rope_unref(x);
+      return status;
+    }
+    return rope_node_new(x, y, out);
+  }
+
+  return rope_node_new(a, b, out);
+}
+
+// Concatenate two trees, either of which may be empty, in time proportional
+// to the difference of their heights. Both references are handed over.
+static CStringStatus rope_join(c_string_rope_node* left,
+                               c_string_rope_node* right,
+                               c_string_rope_node** out) {
+  if (!left || !right) {
+    *out = left ? left : right;
+    return CSTRING_OK;
+  }
+
+  CStringStatus status = CSTRING_OK;
+  c_string_rope_node* joined = NULL;
+
+  if (left->height > right->height + 1) {
+    // Descend the taller tree's right spine to a subtree of similar height
+    c_string_rope_node* outer = rope_ref(left->left);
+    c_string_rope_node* inner = rope_ref(left->right);
+    rope_unref(left);
+    status = rope_join(inner, right, &joined);
+    if (status != CSTRING_OK) {
+      rope_unref(outer);
+      return status;
+    }
+    return rope_balance(outer, joined, out);
+  }
+
+  if (right->height > left->height + 1) {
+    c_string_rope_node* inner = rope_ref(right->left);
+    c_string_rope_node* outer = rope_ref(right->right);
+    rope_unref(right);
+    status = rope_join(left, inner, &joined);
+    if (status != CSTRING_OK) {
+      rope_unref(outer);
+      return status;
+    }
+    return rope_balance(joined, outer, out);
+  }
+
+  return rope_node_new(left, right, out);
+}
+
+// Cut `n` before code point `at` into two new references. Only the nodes on
+// the path to the cut are rebuilt, and only the leaf holding it is copied.
+static CStringStatus rope_split(c_string_rope_node* n, size_t at,
+                                c_string_rope_node** left,
+                                c_string_rope_node** right) {
+  CStringStatus status = CSTRING_OK;
+  c_string_rope_node* a = NULL;
+  c_string_rope_node* b = NULL;
+
+  if (!n || at == 0) {
+    *left = NULL;
+    *right = rope_ref(n);
+    return CSTRING_OK;
+  }
+  if (at >= n->codepoint_length) {
+    *left = rope_ref(n);
+    *right = NULL;
+    return CSTRING_OK;
+  }
+
+  if (n->leaf) {
+    const char* data = n->leaf->string;
+    size_t offset = n->codepoint_length == n->length
+                        ? at
+                        : skip_codepoints(data, n->length, 0, at);
+    status = rope_leaf_new(data, offset, at, &a);
+    if (status != CSTRING_OK) {
+      return status;
+    }
+    status = rope_leaf_new(data + offset, n->length - offset,
+                           n->codepoint_length - at, &b);
+    if (status != CSTRING_OK) {
+      rope_unref(a);
+      return status;
+    }
+    *left = a;
+    *right = b;
+    return CSTRING_OK;
+  }
+
+  if (at <= n->left->codepoint_length) {
+    status = rope_split(n->left, at, &a, &b);
+    if (status != CSTRING_OK) {
+      return status;
+    }
+    status = rope_join(b, rope_ref(n->right), right);
+    if (status != CSTRING_OK) {
+      rope_unref(a);
+      return status;
+    }
+    *left = a;
+    return CSTRING_OK;
+  }
+
+  status = rope_split(n->right, at - n->left->codepoint_length, &a, &b);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+  status = rope_join(rope_ref(n->left), a, left);
+  if (status != CSTRING_OK) {
+    rope_unref(b);
+    return status;
+  }
+  *right = b;
+  return CSTRING_OK;
+}
+
+// rope_join that also merges the two leaves meeting at the seam when they fit
+// in one leaf together.
+static CStringStatus rope_join_merged(c_string_rope_node* left,
+                                      c_string_rope_node* right,
+                                      c_string_rope_node** out) {
+  if (!left || !right) {
+    return rope_join(left, right, out);
+  }
+
+  const c_string_rope_node* last = left;
+  while (!last->leaf) {
+    last = last->right;
+  }
+  const c_string_rope_node* first = right;
+  while (!first->leaf) {
+    first = first->left;
+  }
+  if (last->length + first->length > ROPE_LEAF_SIZE) {
+    return rope_join(left, right, out);
+  }
+
+  char bytes[ROPE_LEAF_SIZE];
+  memcpy(bytes, last->leaf->string, last->length);
+  memcpy(bytes + last->length, first->leaf->string, first->length);
+
+  c_string_rope_node* merged = NULL;
+  CStringStatus status =
+      rope_leaf_new(bytes, last->length + first->length,
+                    last->codepoint_length + first->codepoint_length, &merged);
+  if (status != CSTRING_OK) {
+    rope_unref(left);
+    rope_unref(right);
+    return status;
+  }
+
+  // Cutting exactly at a leaf's edge copies no bytes; the leaves themselves
+  // come back as the dropped halves.
+  c_string_rope_node* head = NULL;
+  c_string_rope_node* tail = NULL;
+  c_string_rope_node* dropped = NULL;
+  status = rope_split(left, left->codepoint_length - last->codepoint_length,
+                      &head, &dropped);
+  rope_unref(left);
+  rope_unref(dropped);
+  if (status == CSTRING_OK) {
+    status = rope_split(right, first->codepoint_length, &dropped, &tail);
+    rope_unref(dropped);
+  }
+  rope_unref(right);
+  if (status != CSTRING_OK) {
+    rope_unref(head);
+    rope_unref(merged);
+    return status;
+  }
+
+  c_string_rope_node* joined = NULL;
+  status = rope_join(head, merged, &joined);
+  if (status != CSTRING_OK) {
+    rope_unref(tail);
+    return status;
+  }
+  return rope_join(joined, tail, out);
+}
+
+// Balanced tree over valid UTF-8 `data`, cut into leaves at code point
+// boundaries
+static CStringStatus rope_build(const char* data, size_t length,
+                                size_t codepoints, c_string_rope_node** out) {
+  if (length <= ROPE_LEAF_SIZE) {
+    return rope_leaf_new(data, length, codepoints, out);
+  }
+
+  // Halve at a code point boundary near the middle, keeping the leaf count on
+  // both sides close so the result is balanced.
+  size_t leaves = (length + ROPE_LEAF_SIZE - 1) / ROPE_LEAF_SIZE;
+  size_t middle = leaves / 2 * ROPE_LEAF_SIZE;
+  while (!is_codepoint_boundary(data, length, middle)) {
+    middle -= 1;
+  }
+  size_t left_codepoints =
+      count_slice_codepoints(data, middle, length, codepoints);
+
+  c_string_rope_node* left = NULL;
+  c_string_rope_node* right = NULL;
+  CStringStatus status = rope_build(data, middle, left_codepoints, &left);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+  status = rope_build(data + middle, length - middle,
+                      codepoints - left_codepoints, &right);
+  if (status != CSTRING_OK) {
+    rope_unref(left);
+    return status;
+  }
+  return rope_join(left, right, out);
+}
+
+void rope_init(c_string_rope* r) {
+  if (r) {
+    r->root = NULL;
+  }
+}
+
+CStringStatus rope_from_view(c_string_view v, c_string_rope* out) {
+  if (!out) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  rope_init(out);
+  return rope_insert(out, 0, v);
+}
+
+void rope_destroy(c_string_rope* r) {
+  if (!r) {
+    return;
+  }
+  rope_unref(r->root);
+  r->root = NULL;
+}
+
+size_t rope_length(const c_string_rope* r) {
+  return r && r->root ? r->root->length : 0;
+}
+
+size_t rope_codepoint_length(const c_string_rope* r) {
+  return r && r->root ? r->root->codepoint_length : 0;
+}
+
+CStringStatus rope_insert(c_string_rope* r, size_t index, c_string_view text) {
+  if (!r || index > rope_codepoint_length(r) ||
+      (text.length > 0 && !text.data)) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  if (text.length == 0) {
+    return CSTRING_OK;
+  }
+
+  size_t codepoints = text.codepoint_length;
+  if (!text.utf8_valid) {
+    CStringStatus status =
+        cstring_validate_utf8(text.data, text.length, &codepoints, NULL);
+    if (status != CSTRING_OK) {
+      return status;
+    }
+  }
+
+  // The pieces take their own references, so the rope is untouched until the
+  // new tree is complete.
+  c_string_rope_node* middle = NULL;
+  CStringStatus status = rope_build(text.data, text.length, codepoints, &middle);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+
+  c_string_rope_node* head = NULL;
+  c_string_rope_node* tail = NULL;
+  status = rope_split(r->root, index, &head, &tail);
+  if (status != CSTRING_OK) {
+    rope_unref(middle);
+    return status;
+  }
+
+  c_string_rope_node* joined = NULL;
+  status = rope_join_merged(head, middle, &joined);
+  if (status != CSTRING_OK) {
+    rope_unref(tail);
+    return status;
+  }
+  status = rope_join_merged(joined, tail, &joined);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+
+  rope_unref(r->root);
+  r->root = joined;
+  return CSTRING_OK;
+}
+
+CStringStatus rope_delete(c_string_rope* r, size_t start, size_t count) {
+  if (!r || start > rope_codepoint_length(r) ||
+      count > rope_codepoint_length(r) - start) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  if (count == 0) {
+    return CSTRING_OK;
+  }
+
+  c_string_rope_node* head = NULL;
+  c_string_rope_node* rest = NULL;
+  c_string_rope_node* removed = NULL;
+  c_string_rope_node* tail = NULL;
+  CStringStatus status = rope_split(r->root, start, &head, &rest);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+  status = rope_split(rest, count, &removed, &tail);
+  rope_unref(rest);
+  rope_unref(removed);
+  if (status != CSTRING_OK) {
+    rope_unref(head);
+    return status;
+  }
+
+  c_string_rope_node* joined = NULL;
+  status = rope_join_merged(head, tail, &joined);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+
+  rope_unref(r->root);
+  r->root = joined;
+  return CSTRING_OK;
+}
+
+CStringStatus rope_concat(c_string_rope* r, const c_string_rope* tail) {
+  if (!r || !tail) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  c_string_rope_node* joined = NULL;
+  CStringStatus status =
+      rope_join_merged(rope_ref(r->root), rope_ref(tail->root), &joined);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+
+  rope_unref(r->root);
+  r->root = joined;
+  return CSTRING_OK;
+}
+
+CStringStatus rope_slice(const c_string_rope* r, size_t start, size_t count,
+                         c_string_rope* out) {
+  if (!r || !out || start > rope_codepoint_length(r) ||
+      count > rope_codepoint_length(r) - start) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  c_string_rope_node* head = NULL;
+  c_string_rope_node* rest = NULL;
+  c_string_rope_node* slice = NULL;
+  c_string_rope_node* tail = NULL;
+  CStringStatus status = rope_split(r->root, start, &head, &rest);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+  rope_unref(head);
+  status = rope_split(rest, count, &slice, &tail);
+  rope_unref(rest);
+  rope_unref(tail);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+
+  out->root = slice;
+  return CSTRING_OK;
+}
+
+CStringResult rope_flatten(const c_string_rope* r) {
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  if (!r) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  c_string* s = allocate_string(NULL, rope_length(r));
+  if (!s) {
+    result.status = CSTRING_ERR_NO_MEMORY;
+    return result;
+  }
+
+  c_string_rope_iter it;
+  c_string_view chunk;
+  size_t offset = 0;
+  rope_iter_init(&it, r);
+  while (rope_iter_next(&it, &chunk)) {
+    memcpy(s->string + offset, chunk.data, chunk.length);
+    offset += chunk.length;
+  }
+
+  // Every leaf is valid UTF-8, and so is their concatenation
+  s->codepoint_length = rope_codepoint_length(r);
+  s->utf8_valid = true;
+  result.value = s;
+  return result;
+}
+
+void rope_iter_init(c_string_rope_iter* it, const c_string_rope* r) {
+  if (!it) {
+    return;
+  }
+  it->depth = 0;
+  if (r && r->root) {
+    it->stack[it->depth++] = r->root;
+  }
+}
+
+bool rope_iter_next(c_string_rope_iter* it, c_string_view* chunk) {
+  if (!it || !chunk || it->depth == 0) {
+    return false;
+  }
+
+  // The stack holds the subtrees still to visit, the next one on top
+  const c_string_rope_node* n = it->stack[--it->depth];
+  while (!n->leaf) {
+    it->stack[it->depth++] = n->right;
+    n = n->left;
+  }
+
+  chunk->data = n->leaf->string;
+  chunk->length = n->length;
+  chunk->codepoint_length = n->codepoint_length;
+  chunk->utf8_valid = true;
+  return true;
+}
+
+/* Printing Functions */
+
+void print(const c_string* s) {
+  printf("%.*s", (int)s->length, string_data(s));
+}
+
+void print_delim_strings(c_string** s) {
+  size_t i = 0;
+  printf("[");
+  while (s[i + 1] != NULL) {
+    printf("'");
+    print(s[i]);
+    printf("', ");
+    i += 1;
+  }
+  printf("'");
+  print(s[i]);
+  printf("']");
+}
+
+// Supported Colors: Red, Green, Yellow, Blue, Magenta and Cyan
+void print_colored(const c_string* s, const char* color) {
+  if ((strcmp(color, "red") == 0) || (strcmp(color, "Red")) == 0) {
+    printf(ANSI_COLOR_RED "%.*s" ANSI_COLOR_RESET, (int)s->length,
+           string_data(s));
+  } else if ((strcmp(color, "green") == 0) || (strcmp(color, "Green")) == 0) {
+    printf(ANSI_COLOR_GREEN "%.*s" ANSI_COLOR_RESET, (int)s->length,
+           string_data(s));
+  } else if ((strcmp(color, "yellow") == 0) || (strcmp(color, "Yellow")) == 0) {
+    printf(ANSI_COLOR_YELLOW "%.*s" ANSI_COLOR_RESET, (int)s->length,
+           string_data(s));
+  } else if ((strcmp(color, "blue") == 0) || (strcmp(color, "Blue")) == 0) {
+    printf(ANSI_COLOR_BLUE "%.*s" ANSI_COLOR_RESET, (int)s->length,
+           string_data(s));
+  } else if ((strcmp(color, "magenta") == 0) ||
+             (strcmp(color, "Magenta")) == 0) {
+    printf(ANSI_COLOR_MAGENTA "%.*s" ANSI_COLOR_RESET, (int)s->length,
+           string_data(s));
+  } else if ((strcmp(color, "cyan") == 0) || (strcmp(color, "Cyan")) == 0) {
+    printf(ANSI_COLOR_CYAN "%.*s" ANSI_COLOR_RESET, (int)s->length,
+           string_data(s));
+  } else if ((strcmp(color, "white") == 0) || (strcmp(color, "White")) == 0) {
+    printf(ANSI_COLOR_WHITE "%.*s" ANSI_COLOR_RESET, (int)s->length,
+           string_data(s));
+  }
+}
+
+void print_utf8_info(const c_string* s) {
+  if (!s) {
+    printf("<null c_string>\n");
+    return;
+  }
+
+  printf("string=%.*s bytes=%zu codepoints=%zu utf8_valid=%s\n", (int)s->length,
+         string_data(s), s->length, s->codepoint_length,
+         s->utf8_valid ? "true" : "false");
+}
+
+size_t get_delim_string_length(c_string** s) {
+  size_t i = 0;
+  while (s[i + 1] != NULL) {
+    i += 1;
+  }
+
+  return i;
+}
+
+// Read stdin input into c_string
+CStringStatus scan_string(c_string* s, const char* prompt) {
+  if (!s) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  if (prompt) {
+    fputs(prompt, stdout);
+    fflush(stdout);
+  }
+
+  // getc leaves everything after the newline in stdin's own buffer, so later
+  // reads of stdin see it.
+  invalidate_codepoint_index(s);
+  s->length = 0;
+  int c = getc(stdin);
+  if (c == EOF) {
+    update_utf8_metadata(s);
+    return CSTRING_ERR_IO;
+  }
+
+  while (c != EOF && c != '\n') {
+    CStringStatus status = grow_payload(s, 1);
+    if (status != CSTRING_OK) {
+      return status;
+    }
+    s->string[s->length++] = (char)c;
+    c = getc(stdin);
+  }
+  if (c == EOF && ferror(stdin)) {
+    update_utf8_metadata(s);
+    return CSTRING_ERR_IO;
+  }
+
+  if (s->length > 0 && s->string[s->length - 1] == '\r') {
+    s->length -= 1;
+  }
+  return update_utf8_metadata(s) ? CSTRING_OK : CSTRING_ERR_INVALID_UTF8;
+}
+
+/* Line Reader */
+
+#define READER_DEFAULT_BUFFER_SIZE (64 * 1024)
+
+static CStringStatus reader_init(c_string_reader* r, FILE* file, int fd,
+                                 size_t buffer_size) {
+  if (buffer_size == 0) {
+    buffer_size = READER_DEFAULT_BUFFER_SIZE;
+  }
+
+  r->buffer = malloc(buffer_size);
+  if (!r->buffer) {
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  r->file = file;
+  r->fd = fd;
+  r->capacity = buffer_size;
+  r->start = 0;
+  r->end = 0;
+  r->line_number = 0;
+  r->eof = false;
+  r->status = CSTRING_OK;
+  return CSTRING_OK;
+}
+
+CStringStatus reader_init_fd(c_string_reader* r, int fd, size_t buffer_size) {
+  if (!r || fd < 0) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  return reader_init(r, NULL, fd, buffer_size);
+}
+
+CStringStatus reader_init_file(c_string_reader* r, FILE* file,
+                               size_t buffer_size) {
+  if (!r || !file) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  return reader_init(r, file, -1, buffer_size);
+}
+
+void reader_destroy(c_string_reader* r) {
+  if (!r) {
+    return;
+  }
+
+  free(r->buffer);
+  r->buffer = NULL;
+  r->capacity = 0;
+  r->start = 0;
+  r->end = 0;
+}
+
+// Read more input after the buffered bytes. Unconsumed bytes are moved to the
+// front first; a buffer holding nothing but an unfinished line is doubled.
+// Returns false at end of input or on error.
+static bool reader_fill(c_string_reader* r) {
+  if (r->eof || r->status != CSTRING_OK) {
+    return false;
+  }
+
+  if (r->start > 0) {
+    memmove(r->buffer, r->buffer + r->start, r->end - r->start);
+    r->end -= r->start;
+    r->start = 0;
+  }
+
+  if (r->end == r->capacity) {
+    if (r->capacity > SIZE_MAX / 2) {
+      r->status = CSTRING_ERR_OVERFLOW;
+      return false;
+    }
+    char* grown = realloc(r->buffer, r->capacity * 2);
+    if (!grown) {
+      r->status = CSTRING_ERR_NO_MEMORY;
+      return false;
+    }
+    r->buffer = grown;
+    r->capacity *= 2;
+  }
+
+  size_t spare = r->capacity - r->end;
+  size_t received = 0;
+  if (r->file) {
+    received = fread(r->buffer + r->end, 1, spare, r->file);
+    if (received == 0 && ferror(r->file)) {
+      r->status = CSTRING_ERR_IO;
+      return false;
+    }
+  } else {
+    ssize_t n;
+    do {
+      n = read(r->fd, r->buffer + r->end, spare);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+      r->status = CSTRING_ERR_IO;
+      return false;
+    }
+    received = (size_t)n;
+  }
+
+  if (received == 0) {
+    r->eof = true;
+    return false;
+  }
+  r->end += received;
+  return true;
+}
+
+bool reader_next_line(c_string_reader* r, c_string_view* line) {
+  if (!r || !r->buffer) {
+    return false;
+  }
+
+  // Only bytes read since the last search need scanning for a newline.
+  size_t searched = r->start;
+  const char* newline = NULL;
+  for (;;) {
+    newline = memchr(r->buffer + searched, '\n', r->end - searched);
+    if (newline) {
+      break;
+    }
+
+    size_t pending = r->end - r->start;
+    if (!reader_fill(r)) {
+      if (r->status != CSTRING_OK || pending == 0) {
+        return false;
+      }
+      // The final line has no terminator.
+      break;
+    }
+    searched = r->start + pending;
+  }
+
+  const char* data = r->buffer + r->start;
+  size_t length = newline ? (size_t)(newline - data) : r->end - r->start;
+  r->start += length + (newline ? 1 : 0);
+  if (length > 0 && data[length - 1] == '\r') {
+    length -= 1;
+  }
+
+  r->line_number += 1;
+  if (line) {
+    *line = make_view(data, length, false);
+  }
+  return true;
+}
+
+bool reader_next_line_string(c_string_reader* r, c_string* line) {
+  c_string_view view;
+  if (!reader_next_line(r, &view)) {
+    return false;
+  }
+
+  if (line) {
+    if (!reserve_payload(line, view.length)) {
+      r->status = CSTRING_ERR_NO_MEMORY;
+      return false;
+    }
+    invalidate_codepoint_index(line);
+    if (view.length > 0) {
+      memcpy(string_data(line), view.data, view.length);
+    }
+    line->length = view.length;
+    line->codepoint_length = view.codepoint_length;
+    line->utf8_valid = view.utf8_valid;
+  }
+  return true;
+}
+
+/* String Transformation Functions */
+
+// One c_string per token of `split`, followed by a NULL terminator that
+// helps us print the result. Tokens of a valid source inherit its validity,
+// so each one is only copied, never rescanned. Consumes `split`.
+static c_string** split_to_strings(c_string_split* split) {
+  c_string** new_split_string = calloc(split->count + 1, sizeof(c_string*));
+  if (!new_split_string) {
+    split_destroy(split);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < split->count; i++) {
+    CStringResult token = string_from_view(split_get(split, i));
+    if (token.status != CSTRING_OK) {
+      split_destroy(split);
+      destroy_delim_string(new_split_string);
+      return NULL;
+    }
+    new_split_string[i] = token.value;
+  }
+
+  split_destroy(split);
+  return new_split_string;
+}
+
+// Split string according to given delimiter.
+//  * If delimiter size > input size, we consider that the delimiter was not
+//  found and return the original input.
+//  * If delimiter is exactly the input string, we return ['', ''] since we have
+//  nothing "before" and "after" the delimiter match.
+c_string** string_delim(const c_string* s, const char* delim) {
+  if (!s) {
+    return NULL;
+  }
+
+  // Locate every delimiter in one (possibly parallel) pass. With no match the
+  // only token is a copy of the input string, and a match at either end
+  // yields an empty token there.
+  c_string_split split;
+  if (view_split(string_view(s), delim, &split) != CSTRING_OK) {
+    return NULL;
+  }
+  return split_to_strings(&split);
+}
+
+c_string** string_delim_any(const c_string* s,
+                            const c_string_multi_needle* delims) {
+  if (!s) {
+    return NULL;
+  }
+
+  c_string_split split;
+  if (view_split_any(string_view(s), delims, &split) != CSTRING_OK) {
+    return NULL;
+  }
+  return split_to_strings(&split);
+}
+
+void delim_iter_init(c_string_delim_iter* it, const c_string* s,
+                     const char* delim) {
+  size_t delim_size = delim ? strlen(delim) : 0;
+  it->source = string_view(s);
+  needle_compile(&it->delim, delim, delim_size);
+  it->position = 0;
+  it->finished = false;
+  // A valid delimiter only matches on code point boundaries of valid input.
+  it->known_valid =
+      it->source.utf8_valid && analyze_utf8(delim, delim_size).valid;
+}
+
+bool delim_iter_next(c_string_delim_iter* it, c_string_view* token) {
+  if (it->finished) {
+    return false;
+  }
+
+  const c_string_view* source = &it->source;
+  size_t start = it->position;
+  size_t end = view_find(*source, &it->delim, start);
+
+  if (end == CSTRING_NPOS) {
+    // No further delimiter: the rest of the input is the final token.
+    end = source->length;
+    it->finished = true;
+    it->position = source->length;
+  } else {
+    it->position = end + it->delim.length;
+  }
+
+  if (token) {
+    const char* data = source->data ? source->data + start : NULL;
+    *token = make_view(data, end - start, it->known_valid);
+  }
+  return true;
+}
+
+bool delim_iter_next_string(c_string_delim_iter* it, c_string* token) {
+  c_string_view view;
+  if (!delim_iter_next(it, &view)) {
+    return false;
+  }
+
+  if (token) {
+    token->string = (char*)view.data;
+    token->length = view.length;
+    token->codepoint_length = view.codepoint_length;
+    token->utf8_valid = view.utf8_valid;
+    token->capacity = view.length;
+    token->storage = CSTRING_STORAGE_BORROWED;
+  }
+  return true;
+}
+
+void delim_iter_reset(c_string_delim_iter* it) {
+  it->position = 0;
+  it->finished = false;
+}
+
+// Split `v` into `out`, copying its bytes after the spans when `copy` is set.
+// The array of delimiter offsets is grown in place into the array of spans:
+// span i only overwrites offsets i and above, so filling from the last span
+// down reads every offset before it is replaced.
+static CStringStatus split_view(c_string_view v, const char* delim, bool copy,
+                                c_string_split* out) {
+  if (!out) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  out->data = NULL;
+  out->spans = NULL;
+  out->count = 0;
+
+  size_t* offsets = NULL;
+  size_t matches = 0;
+  CStringStatus status = view_delim_offsets(v, delim, &offsets, &matches);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+
+  size_t copy_length = copy ? v.length : 0;
+  if (matches >= SIZE_MAX / sizeof(c_string_span) - 1 ||
+      copy_length > SIZE_MAX - (matches + 1) * sizeof(c_string_span)) {
+    free(offsets);
+    return CSTRING_ERR_OVERFLOW;
+  }
+
+  size_t span_bytes = (matches + 1) * sizeof(c_string_span);
+  c_string_span* spans = realloc(offsets, span_bytes + copy_length);
+  if (!spans) {
+    free(offsets);
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  const size_t* starts = (const size_t*)spans;
+  size_t delim_length = strlen(delim);
+  for (size_t i = matches + 1; i-- > 0;) {
+    size_t end = i < matches ? starts[i] : v.length;
+    size_t start = i > 0 ? starts[i - 1] + delim_length : 0;
+    spans[i].offset = start;
+    spans[i].length = end - start;
+  }
+
+  out->data = v.data;
+  if (copy) {
+    char* bytes = (char*)spans + span_bytes;
+    if (copy_length > 0) {
+      memcpy(bytes, v.data, copy_length);
+    }
+    out->data = bytes;
+  }
+  out->spans = spans;
+  out->count = matches + 1;
+  // As in delim_iter_init, a valid delimiter only matches on code point
+  // boundaries of valid input.
+  out->known_valid = v.utf8_valid && analyze_utf8(delim, delim_length).valid;
+  out->ascii = v.utf8_valid && v.codepoint_length == v.length;
+  return CSTRING_OK;
+}
+
+CStringStatus string_split(const c_string* s, const char* delim,
+                           c_string_split* out) {
+  if (!s) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  return split_view(string_view(s), delim, true, out);
+}
+
+CStringStatus view_split(c_string_view v, const char* delim,
+                         c_string_split* out) {
+  return split_view(v, delim, false, out);
+}
+
+// Like split_view, but around the leftmost-longest matches of any of
+// `needles`. The matches differ in length, so the spans are collected as they
+// are found instead of being rebuilt from an array of offsets.
+static CStringStatus split_view_any(c_string_view v,
+                                    const c_string_multi_needle* needles,
+                                    bool copy, c_string_split* out) {
+  if (!out) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  out->data = NULL;
+  out->spans = NULL;
+  out->count = 0;
+
+  if (!needles || (!v.data && v.length > 0)) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  size_t capacity = 16;
+  size_t count = 0;
+  c_string_span* spans = malloc(capacity * sizeof(c_string_span));
+  if (!spans) {
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  size_t start = 0;
+  size_t pattern = 0;
+  size_t match = view_find_any(v, needles, 0, &pattern);
+  for (;;) {
+    if (count == capacity) {
+      c_string_span* grown =
+          capacity <= SIZE_MAX / 2 / sizeof(c_string_span)
+              ? realloc(spans, capacity * 2 * sizeof(c_string_span))
+              : NULL;
+      if (!grown) {
+        free(spans);
+        return CSTRING_ERR_NO_MEMORY;
+      }
+      spans = grown;
+      capacity *= 2;
+    }
+
+    size_t end = match == CSTRING_NPOS ? v.length : match;
+    spans[count].offset = start;
+    spans[count].length = end - start;
+    count += 1;
+    if (match == CSTRING_NPOS) {
+      break;
+    }
+    start = match + needles->lengths[pattern];
+    match = view_find_any(v, needles, start, &pattern);
+  }
+
+  size_t copy_length = copy ? v.length : 0;
+  size_t span_bytes = count * sizeof(c_string_span);
+  if (copy_length > SIZE_MAX - span_bytes) {
+    free(spans);
+    return CSTRING_ERR_OVERFLOW;
+  }
+  if (copy_length > 0 || count < capacity) {
+    c_string_span* sized = realloc(spans, span_bytes + copy_length);
+    if (!sized) {
+      free(spans);
+      return CSTRING_ERR_NO_MEMORY;
+    }
+    spans = sized;
+  }
+
+  out->data = v.data;
+  if (copy) {
+    char* bytes = (char*)spans + span_bytes;
+    if (copy_length > 0) {
+      memcpy(bytes, v.data, copy_length);
+    }
+    out->data = bytes;
+  }
+  out->spans = spans;
+  out->count = count;
+  out->known_valid = v.utf8_valid && needles->utf8_valid;
+  out->ascii = v.utf8_valid && v.codepoint_length == v.length;
+  return CSTRING_OK;
+}
+
+CStringStatus string_split_any(const c_string* s,
+                               const c_string_multi_needle* needles,
+                               c_string_split* out) {
+  if (!s) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  return split_view_any(string_view(s), needles, true, out);
+}
+
+CStringStatus view_split_any(c_string_view v,
+                             const c_string_multi_needle* needles,
+                             c_string_split* out) {
+  return split_view_any(v, needles, false, out);
+}
+
+c_string_view split_get(const c_string_split* split, size_t index) {
+  if (!split || index >= split->count) {
+    return make_view(NULL, 0, true);
+  }
+
+  c_string_span span = split->spans[index];
+  const char* data = split->data ? split->data + span.offset : NULL;
+  if (split->ascii) {
+    c_string_view view = {.data = data,
+                          .length = span.length,
+                          .codepoint_length = span.length,
+                          .utf8_valid = true};
+    return view;
+  }
+  return make_view(data, span.length, split->known_valid);
+}
+
+void split_destroy(c_string_split* split) {
+  if (!split) {
+    return;
+  }
+
+  free(split->spans);
+  split->data = NULL;
+  split->spans = NULL;
+  split->count = 0;
+}
+
+// Copy `length` bytes from `in` to `out`, leaving out every byte equal to `c`,
+// and return the number of bytes written. `out` may alias `in` and is never
+// written at or past offset `length`.
+static size_t remove_byte_scalar(char* out, const char* in, size_t length,
+                                 const char c) {
+  size_t written = 0;
+  for (size_t i = 0; i < length; i++) {
+    out[written] = in[i];
+    written += in[i] != c;
+  }
+  return written;
+}
+
+#if CSTRING_X86_SIMD
+
+// Blocks without a match are stored whole; the rest go through the scalar
+// loop.
+static size_t remove_byte_sse2(char* out, const char* in, size_t length,
+                               const char c) {
+  const __m128i target = _mm_set1_epi8(c);
+  size_t written = 0;
+  size_t i = 0;
+
+  for (; i + 16 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)(const void*)(in + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(block, target)) == 0) {
+      _mm_storeu_si128((__m128i*)(void*)(out + written), block);
+      written += 16;
+    } else {
+      written += remove_byte_scalar(out + written, in + i, 16, c);
+    }
+  }
+
+  return written + remove_byte_scalar(out + written, in + i, length - i, c);
+}
+
+// Compact blocks with matches eight bytes at a time: the compare result has
+// 0xFF in every matching byte, so pext with its complement packs the kept
+// bytes into the low end of the word. `written` never passes the input
+// position, so each eight-byte store stays inside the current block.
+__attribute__((target("avx2,bmi2"))) static size_t remove_byte_avx2(
+    char* out, const char* in, size_t length, const char c) {
+  const __m256i target = _mm256_set1_epi8(c);
+  size_t written = 0;
+  size_t i = 0;
+
+  for (; i + 32 <= length; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i*)(const void*)(in + i));
+    __m256i matches = _mm256_cmpeq_epi8(block, target);
+    if (_mm256_testz_si256(matches, matches)) {
+      _mm256_storeu_si256((__m256i*)(void*)(out + written), block);
+      written += 32;
+      continue;
+    }
+
+    uint64_t words[4];
+    uint64_t dropped[4];
+    _mm256_storeu_si256((__m256i*)(void*)words, block);
+    _mm256_storeu_si256((__m256i*)(void*)dropped, matches);
+    for (size_t k = 0; k < 4; k++) {
+      uint64_t packed = _pext_u64(words[k], ~dropped[k]);
+      memcpy(out + written, &packed, sizeof(packed));
+      written += 8 - (size_t)__builtin_popcountll(dropped[k]) / 8;
+    }
+  }
+
+  return written + remove_byte_sse2(out + written, in + i, length - i, c);
+}
+
+#endif  // CSTRING_X86_SIMD
+
+static size_t remove_byte(char* out, const char* in, size_t length,
+                          const char c) {
+#if CSTRING_X86_SIMD
+  if (simd_enabled) {
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2")) {
+      return remove_byte_avx2(out, in, length, c);
+    }
+    return remove_byte_sse2(out, in, length, c);
+  }
+#endif
+  return remove_byte_scalar(out, in, length, c);
+}
+
+// Remove every occurrence of `c` in a single pass over the input. The result
+// is sized for the input and shrunk afterwards when most of it was removed.
+CStringResult trim_char(const c_string* s, const char c) {
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  if (!s) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  if (s->length > 0 && !s->string) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  CStringResult buffer = initialize_buffer(s->length);
+  if (buffer.status != CSTRING_OK) {
+    return buffer;
+  }
+
+  c_string* result_string = buffer.value;
+  size_t written =
+      remove_byte(result_string->string, string_data(s), s->length, c);
+  size_t num_of_occurences = s->length - written;
+  result_string->length = written;
+
+  if (s->utf8_valid && (unsigned char)c < 0x80) {
+    // Dropping whole ASCII code points cannot break valid input.
+    result_string->codepoint_length = s->codepoint_length - num_of_occurences;
+    result_string->utf8_valid = true;
+  } else {
+    update_utf8_metadata(result_string);
+  }
+
+  if (written < s->length / 2) {
+    // Keeping the spare capacity is harmless if this fails.
+    string_shrink_to_fit(result_string);
+  }
+
+  result.value = result_string;
+  return result;
+}
+
+/* Case Conversion */
+
+typedef enum {
+  CASE_TO_LOWER,
+  CASE_TO_UPPER,
+} CaseMapping;
+
+static uint32_t map_case(uint32_t codepoint, CaseMapping mapping) {
+  const uint8_t* stage1 = case_lower_stage1;
+  const uint8_t* stage2 = case_lower_stage2;
+  const int32_t* deltas = case_lower_deltas;
+  uint32_t limit = CASE_LOWER_LIMIT;
+  if (mapping == CASE_TO_UPPER) {
+    stage1 = case_upper_stage1;
+    stage2 = case_upper_stage2;
+    deltas = case_upper_deltas;
+    limit = CASE_UPPER_LIMIT;
+  }
+
+  if (codepoint >= limit) {
+    return codepoint;
+  }
+  size_t block = (size_t)stage1[codepoint >> CASE_TABLE_SHIFT]
+                 << CASE_TABLE_SHIFT;
+  int32_t delta = deltas[stage2[block + (codepoint & (CASE_TABLE_BLOCK - 1))]];
+  return (uint32_t)((int32_t)codepoint + delta);
+}
+
+static size_t encode_utf8(uint32_t codepoint, char* out) {
+  if (codepoint < 0x80) {
+    out[0] = (char)codepoint;
+    return 1;
+  }
+  if (codepoint < 0x800) {
+    out[0] = (char)(0xC0 | (codepoint >> 6));
+    out[1] = (char)(0x80 | (codepoint & 0x3F));
+    return 2;
+  }
+  if (codepoint < 0x10000) {
+    out[0] = (char)(0xE0 | (codepoint >> 12));
+    out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (codepoint & 0x3F));
+    return 3;
+  }
+  out[0] = (char)(0xF0 | (codepoint >> 18));
+  out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+  out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+  out[3] = (char)(0x80 | (codepoint & 0x3F));
+  return 4;
+}
+
+// Converts the ASCII prefix of `in` into `out` (which may alias it) and
+// returns its length; stops at the first non-ASCII byte.
+static size_t convert_ascii_case_scalar(char* out, const char* in,
+                                        size_t length, CaseMapping mapping) {
+  const char first = mapping == CASE_TO_LOWER ? 'A' : 'a';
+  size_t i = 0;
+  for (; i < length; i++) {
+    unsigned char byte = (unsigned char)in[i];
+    if (byte >= 0x80) {
+      break;
+    }
+    // Letters sit 26 apart from `first`; flipping bit 5 switches case.
+    out[i] = (char)((unsigned char)(byte - first) < 26 ? byte ^ 0x20 : byte);
+  }
+  return i;
+}
+
+#if CSTRING_X86_SIMD
+
+static size_t convert_ascii_case_sse2(char* out, const char* in, size_t length,
+                                      CaseMapping mapping) {
+  const char first = mapping == CASE_TO_LOWER ? 'A' : 'a';
+  const __m128i above = _mm_set1_epi8((char)(first - 1));
+  const __m128i below = _mm_set1_epi8((char)(first + 26));
+  const __m128i flip = _mm_set1_epi8(0x20);
+  size_t i = 0;
+
+  for (; i + 16 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)(const void*)(in + i));
+    if (_mm_movemask_epi8(block) != 0) {
+      break;
+    }
+    // Signed compares are fine: every byte here is below 0x80.
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(block, above),
+                                    _mm_cmpgt_epi8(below, block));
+    block = _mm_xor_si128(block, _mm_and_si128(letters, flip));
+    _mm_storeu_si128((__m128i*)(void*)(out + i), block);
+  }
+
+  return i + convert_ascii_case_scalar(out + i, in + i, length - i, mapping);
+}
+
+__attribute__((target("avx2"))) static size_t convert_ascii_case_avx2(
+    char* out, const char* in, size_t length, CaseMapping mapping) {
+  const char first = mapping == CASE_TO_LOWER ? 'A' : 'a';
+  const __m256i above = _mm256_set1_epi8((char)(first - 1));
+  const __m256i below = _mm256_set1_epi8((char)(first + 26));
+  const __m256i flip = _mm256_set1_epi8(0x20);
+  size_t i = 0;
+
+  for (; i + 32 <= length; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i*)(const void*)(in + i));
+    if (_mm256_movemask_epi8(block) != 0) {
+      break;
+    }
+    __m256i letters = _mm256_and_si256(_mm256_cmpgt_epi8(block, above),
+                                       _mm256_cmpgt_epi8(below, block));
+    block = _mm256_xor_si256(block, _mm256_and_si256(letters, flip));
+    _mm256_storeu_si256((__m256i*)(void*)(out + i), block);
+  }
+
+  return i + convert_ascii_case_sse2(out + i, in + i, length - i, mapping);
+}
+
+#endif
+
+static size_t convert_ascii_case(char* out, const char* in, size_t length,
+                                 CaseMapping mapping) {
+#if CSTRING_X86_SIMD
+  if (simd_enabled) {
+    if (__builtin_cpu_supports("avx2")) {
+      return convert_ascii_case_avx2(out, in, length, mapping);
+    }
+    return convert_ascii_case_sse2(out, in, length, mapping);
+  }
+#endif
+  return convert_ascii_case_scalar(out, in, length, mapping);
+}
+
+// Append the case-converted `in` to `out`. Invalid bytes are copied through
+// unchanged. `out` must have room for `length` more bytes on entry; it only
+// grows when a mapping changes a sequence's encoded length.
+static CStringStatus append_case_converted(c_string* out, const char* in,
+                                           size_t length, CaseMapping mapping) {
+  size_t i = 0;
+  while (i < length) {
+    size_t ascii =
+        convert_ascii_case(out->string + out->length, in + i, length - i,
+                           mapping);
+    out->length += ascii;
+    i += ascii;
+    if (i == length) {
+      break;
+    }
+
+    size_t next = i;
+    uint32_t codepoint = 0;
+    if (!decode_utf8_sequence(in, length, &next, NULL, &codepoint)) {
+      out->string[out->length++] = in[i++];
+      continue;
+    }
+
+    char encoded[4];
+    size_t encoded_length = encode_utf8(map_case(codepoint, mapping), encoded);
+    if (encoded_length > next - i) {
+      // Keep room for the rest of the input after this longer sequence.
+      CStringStatus status = grow_payload(out, encoded_length + length - next);
+      if (status != CSTRING_OK) {
+        return status;
+      }
+    }
+    memcpy(out->string + out->length, encoded, encoded_length);
+    out->length += encoded_length;
+    i = next;
+  }
+
+  return CSTRING_OK;
+}
+
+static CStringResult convert_case(c_string_arena* arena, const c_string* s,
+                                  CaseMapping mapping) {
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  if (!s || (s->length > 0 && !s->string)) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  c_string* out = allocate_string(arena, s->length);
+  if (!out) {
+    result.status = CSTRING_ERR_NO_MEMORY;
+    return result;
+  }
+
+  out->length = 0;
+  CStringStatus status =
+      append_case_converted(out, string_data(s), s->length, mapping);
+  if (status != CSTRING_OK) {
+    destroy_string(out);
+    result.status = status;
+    return result;
+  }
+
+  // Simple mappings are one code point to one code point, so the metadata
+  // carries over from valid input.
+  if (s->utf8_valid) {
+    out->codepoint_length = s->codepoint_length;
+    out->utf8_valid = true;
+  } else {
+    update_utf8_metadata(out);
+  }
+
+  result.value = out;
+  return result;
+}
+
+static CStringStatus convert_case_in_place(c_string* s, CaseMapping mapping) {
+  if (!s || (s->length > 0 && !s->string)) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  char* data = string_data(s);
+  size_t i = 0;
+  while (i < s->length) {
+    i += convert_ascii_case(data + i, data + i, s->length - i, mapping);
+    if (i == s->length) {
+      break;
+    }
+
+    size_t next = i;
+    uint32_t codepoint = 0;
+    if (!decode_utf8_sequence(data, s->length, &next, NULL, &codepoint)) {
+      i += 1;
+      continue;
+    }
+
+    char encoded[4];
+    size_t encoded_length = encode_utf8(map_case(codepoint, mapping), encoded);
+    if (encoded_length == next - i) {
+      // Same size: code point count, validity and the index all stay intact.
+      memcpy(data + i, encoded, encoded_length);
+      i = next;
+      continue;
+    }
+
+    // The byte length changes from here on, so convert the tail separately
+    // and splice it back in. The code point count and validity are unchanged.
+    c_string* tail = allocate_string(NULL, s->length - i);
+    if (!tail) {
+      return CSTRING_ERR_NO_MEMORY;
+    }
+    tail->length = 0;
+    CStringStatus status =
+        append_case_converted(tail, data + i, s->length - i, mapping);
+    if (status == CSTRING_OK && !reserve_payload(s, i + tail->length)) {
+      status = CSTRING_ERR_NO_MEMORY;
+    }
+    if (status == CSTRING_OK) {
+      invalidate_codepoint_index(s);
+      memcpy(string_data(s) + i, tail->string, tail->length);
+      s->length = i + tail->length;
+    }
+    destroy_string(tail);
+    return status;
+  }
+
+  return CSTRING_OK;
+}
+
+CStringResult to_lower(const c_string* s) {
+  return convert_case(NULL, s, CASE_TO_LOWER);
+}
+
+CStringResult to_lower_in(c_string_arena* arena, const c_string* s) {
+  return convert_case(arena, s, CASE_TO_LOWER);
+}
+
+CStringStatus to_lower_in_place(c_string* s) {
+  return convert_case_in_place(s, CASE_TO_LOWER);
+}
+
+CStringResult to_upper(const c_string* s) {
+  return convert_case(NULL, s, CASE_TO_UPPER);
+}
+
+CStringResult to_upper_in(c_string_arena* arena, const c_string* s) {
+  return convert_case(arena, s, CASE_TO_UPPER);
+}
+
+CStringStatus to_upper_in_place(c_string* s) {
+  return convert_case_in_place(s, CASE_TO_UPPER);
+}
+
+/* Regular Expressions */
+
+// Limits that keep a hostile pattern from exhausting memory
+#define REGEX_MAX_REPEAT 1000
+#define REGEX_MAX_PROGRAM ((size_t)100000)
+#define REGEX_MAX_NESTING 250
+
+// The lazy DFA forgets every state and starts over once a scan has built this
+// many, so memory stays bounded whatever the input.
+#define REGEX_DFA_MAX_STATES ((size_t)2048)
+
+#define REGEX_NO_NODE SIZE_MAX
+#define REGEX_NO_HOLE UINT32_MAX
+#define REGEX_UNKNOWN ((int32_t)-1)
+#define REGEX_DEAD 0
+#define REGEX_END_OF_TEXT 256
+#define REGEX_PREFIX_CAPACITY 64
+
+typedef enum {
+  REGEX_NODE_EMPTY,
+  REGEX_NODE_LITERAL,    // one code point
+  REGEX_NODE_CLASS,      // a set of code point ranges
+  REGEX_NODE_BEGIN,      // ^
+  REGEX_NODE_END,        // $
+  REGEX_NODE_CONCAT,
+  REGEX_NODE_ALTERNATE,  // prefers `left`
+  REGEX_NODE_REPEAT,
+} RegexNodeKind;
+
+typedef struct {
+  uint32_t lo;
+  uint32_t hi;
+} regex_range;
+
+typedef struct {
+  unsigned char kind;  // RegexNodeKind
+  bool greedy;         // repeats: prefer more iterations
+  uint32_t codepoint;  // literals
+  size_t left;         // first child, or a class's first range
+  size_t right;        // second child, or a class's range count
+  int min;             // repeats
+  int max;             // repeats; -1 when unbounded
+} regex_node;
+
+typedef struct {
+  const char* pattern;
+  size_t length;
+  size_t position;
+  size_t depth;
+  regex_node* nodes;
+  size_t node_count;
+  size_t node_capacity;
+  regex_range* ranges;
+  size_t range_count;
+  size_t range_capacity;
+  CStringStatus status;
+} regex_parser;
+
+typedef enum {
+  REGEX_OP_BYTES,  // consume one byte in [lo, hi]
+  REGEX_OP_SPLIT,  // continue at `out` and, with lower priority, at `out1`
+  REGEX_OP_NOP,
+  REGEX_OP_ASSERT,
+  REGEX_OP_MATCH,
+} RegexOp;
+
+// Assertions are relative to the scan direction, so the same DFA code serves
+// the forward program and the reversed one: ^ is the edge behind a forward
+// scan and the edge ahead of a reverse scan, and $ the other way around.
+typedef enum {
+  REGEX_EDGE_BEHIND = 1,
+  REGEX_EDGE_AHEAD = 2,
+} RegexEdge;
+
+typedef struct {
+  unsigned char op;  // RegexOp
+  unsigned char lo;
+  unsigned char hi;
+  unsigned char edge;  // RegexEdge, for assertions
+  uint32_t out;
+  uint32_t out1;
+} regex_inst;
+
+// Thompson NFA over bytes. Code points are compiled into the byte sequences
+// of their UTF-8 encoding.
+typedef struct {
+  regex_inst* insts;
+  size_t count;
+  size_t capacity;
+  uint32_t start;                // first instruction of the pattern itself
+  unsigned char classes[256];    // bytes the program cannot tell apart
+  unsigned char class_bytes[256];  // one byte of each class
+  size_t class_count;
+  CStringStatus status;
+} regex_program;
+
+// Unfinished part of the program: where it starts, and a list of dangling
+// `out` fields, linked through the fields themselves, still to be patched.
+typedef struct {
+  uint32_t start;
+  uint32_t holes;
+} regex_frag;
+
+// One DFA state is the ordered list of NFA threads alive at a position.
+typedef struct {
+  size_t first;  // index of the first thread in the pool
+  size_t count;
+  uint64_t hash;
+  bool match;    // a match ends at this position
+} regex_dfa_state;
+
+typedef struct {
+  const regex_program* program;
+  uint32_t entry;  // where threads start
+  bool longest;    // keep the threads after a match (reverse scans)
+  regex_dfa_state* states;
+  size_t state_count;
+  size_t state_capacity;
+  int32_t* next;   // stride transitions per state, REGEX_UNKNOWN until used
+  size_t stride;   // class_count + 1 for the end of the text
+  uint32_t* pool;  // thread lists of every state
+  size_t pool_count;
+  size_t pool_capacity;
+  int32_t* table;  // states by hash of their thread list
+  int32_t start[4];  // start states by the RegexEdge flags that hold there
+  size_t flushes;
+  // Scratch space for computing a transition
+  uint32_t* list;
+  uint32_t* stack;
+  uint32_t* marks;
+  uint32_t generation;
+} regex_dfa;
+
+struct c_string_regex {
+  regex_program forward;  // runs from every position through a .*? prefix
+  regex_program reverse;  // the pattern reversed, to find where a match starts
+  regex_dfa forward_dfa;
+  regex_dfa reverse_dfa;
+  bool anchored;   // every match starts at the beginning of the text
+  bool literal;    // the pattern is `prefix` and nothing else
+  bool has_prefix;
+  c_string_needle prefix;  // bytes every match starts with
+  char prefix_bytes[REGEX_PREFIX_CAPACITY];
+};
+
+// Parsing
+
+static size_t regex_new_node(regex_parser* p, RegexNodeKind kind) {
+  if (p->status != CSTRING_OK) {
+    return REGEX_NO_NODE;
+  }
+  if (p->node_count == p->node_capacity) {
+    size_t capacity = p->node_capacity ? p->node_capacity * 2 : 32;
+    regex_node* nodes = realloc(p->nodes, capacity * sizeof(*nodes));
+    if (!nodes) {
+      p->status = CSTRING_ERR_NO_MEMORY;
+      return REGEX_NO_NODE;
+    }
+    p->nodes = nodes;
+    p->node_capacity = capacity;
+  }
+
+  regex_node* node = &p->nodes[p->node_count];
+  memset(node, 0, sizeof(*node));
+  node->kind = (unsigned char)kind;
+  node->left = REGEX_NO_NODE;
+  node->right = REGEX_NO_NODE;
+  return p->node_count++;
+}
+
+static size_t regex_new_pair(regex_parser* p, RegexNodeKind kind, size_t left,
+                             size_t right) {
+  size_t node = regex_new_node(p, kind);
+  if (node != REGEX_NO_NODE) {
+    p->nodes[node].left = left;
+    p->nodes[node].right = right;
+  }
+  return node;
+}
+
+static void regex_add_range(regex_parser* p, uint32_t lo, uint32_t hi) {
+  if (p->status != CSTRING_OK) {
+    return;
+  }
+  if (p->range_count == p->range_capacity) {
+    size_t capacity = p->range_capacity ? p->range_capacity * 2 : 32;
+    regex_range* ranges = realloc(p->ranges, capacity * sizeof(*ranges));
+    if (!ranges) {
+      p->status = CSTRING_ERR_NO_MEMORY;
+      return;
+    }
+    p->ranges = ranges;
+    p->range_capacity = capacity;
+  }
+  p->ranges[p->range_count].lo = lo;
+  p->ranges[p->range_count].hi = hi;
+  p->range_count += 1;
+}
+
+static int regex_compare_ranges(const void* a, const void* b) {
+  const regex_range* x = a;
+  const regex_range* y = b;
+  return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+// Sort and merge the ranges added since `first`, complementing them when
+// `negate` is set, and wrap them in a class node.
+static size_t regex_finish_class(regex_parser* p, size_t first, bool negate) {
+  if (p->status != CSTRING_OK) {
+    return REGEX_NO_NODE;
+  }
+
+  regex_range* ranges = p->ranges + first;
+  size_t count = p->range_count - first;
+  qsort(ranges, count, sizeof(*ranges), regex_compare_ranges);
+
+  size_t merged = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (merged > 0 && ranges[i].lo <= ranges[merged - 1].hi + 1) {
+      if (ranges[i].hi > ranges[merged - 1].hi) {
+        ranges[merged - 1].hi = ranges[i].hi;
+      }
+    } else {
+      ranges[merged++] = ranges[i];
+    }
+  }
+  p->range_count = first + merged;
+
+  if (negate) {
+    // The gaps between the merged ranges, appended and then moved down over
+    // the originals
+    uint32_t next = 0;
+    for (size_t i = 0; i < merged; i++) {
+      if (p->ranges[first + i].lo > next) {
+        regex_add_range(p, next, p->ranges[first + i].lo - 1);
+      }
+      next = p->ranges[first + i].hi + 1;
+    }
+    if (next <= 0x10FFFF) {
+      regex_add_range(p, next, 0x10FFFF);
+    }
+    if (p->status != CSTRING_OK) {
+      return REGEX_NO_NODE;
+    }
+    size_t gaps = p->range_count - first - merged;
+    memmove(p->ranges + first, p->ranges + first + merged,
+            gaps * sizeof(regex_range));
+    p->range_count = first + gaps;
+  }
+
+  size_t node = regex_new_node(p, REGEX_NODE_CLASS);
+  if (node != REGEX_NO_NODE) {
+    p->nodes[node].left = first;
+    p->nodes[node].right = p->range_count - first;
+  }
+  return node;
+}
+
+static bool regex_at_end(const regex_parser* p) {
+  return p->position >= p->length;
+}
+
+static char regex_peek(const regex_parser* p) {
+  return regex_at_end(p) ? '\0' : p->pattern[p->position];
+}
+
+// Next code point of the (already validated) pattern
+static uint32_t regex_next_codepoint(regex_parser* p) {
+  uint32_t codepoint = 0;
+  decode_utf8_sequence(p->pattern, p->length, &p->position, NULL, &codepoint);
+  return codepoint;
+}
+
+static void regex_syntax_error(regex_parser* p) {
+  if (p->status == CSTRING_OK) {
+    p->status = CSTRING_ERR_INVALID_ARG;
+  }
+}
+
+// Add the ranges of \d, \w or \s, or of their complements
+static bool regex_add_perl_class(regex_parser* p, char name) {
+  size_t first = p->range_count;
+  switch (name | 0x20) {
+    case 'd':
+      regex_add_range(p, '0', '9');
+      break;
+    case 'w':
+      regex_add_range(p, '0', '9');
+      regex_add_range(p, 'A', 'Z');
+      regex_add_range(p, '_', '_');
+      regex_add_range(p, 'a', 'z');
+      break;
+    case 's':
+      regex_add_range(p, '\t', '\r');
+      regex_add_range(p, ' ', ' ');
+      break;
+    default:
+      return false;
+  }
+
+  if (name >= 'A' && name <= 'Z' && p->status == CSTRING_OK) {
+    // Complement in place: the ranges above are sorted and disjoint
+    size_t added = p->range_count - first;
+    uint32_t next = 0;
+    for (size_t i = 0; i < added; i++) {
+      regex_range r = p->ranges[first + i];
+      regex_add_range(p, next, r.lo - 1);
+      next = r.hi + 1;
+    }
+    regex_add_range(p, next, 0x10FFFF);
+    if (p->status == CSTRING_OK) {
+      size_t gaps = p->range_count - first - added;
+      memmove(p->ranges + first, p->ranges + first + added,
+              gaps * sizeof(regex_range));
+      p->range_count = first + gaps;
+    }
+  }
+  return true;
+}
+
+static int regex_hex_digit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+    return (c | 0x20) - 'a' + 10;
+  }
+  return -1;
+}
+
+// Code point of the escape after a backslash, or UINT32_MAX for a syntax
+// error. Class escapes (\d and friends) are handled by the callers.
+static uint32_t regex_parse_escape(regex_parser* p) {
+  if (regex_at_end(p)) {
+    return UINT32_MAX;
+  }
+
+  char c = p->pattern[p->position++];
+  switch (c) {
+    case 'n':
+      return '\n';
+    case 't':
+      return '\t';
+    case 'r':
+      return '\r';
+    case 'f':
+      return '\f';
+    case 'v':
+      return '\v';
+    case '0':
+      return '\0';
+    case 'x': {
+      if (p->position + 2 > p->length) {
+        return UINT32_MAX;
+      }
+      int high = regex_hex_digit(p->pattern[p->position]);
+      int low = regex_hex_digit(p->pattern[p->position + 1]);
+      if (high < 0 || low < 0) {
+        return UINT32_MAX;
+      }
+      p->position += 2;
+      return (uint32_t)(high * 16 + low);
+    }
+    default:
+      break;
+  }
+
+  // Any other ASCII punctuation stands for itself
+  unsigned char u = (unsigned char)c;
+  if (u < 0x80 && u > ' ' && !((u | 0x20) >= 'a' && (u | 0x20) <= 'z') &&
+      !(u >= '0' && u <= '9')) {
+    return u;
+  }
+  return UINT32_MAX;
+}
+
+// [...] after the opening bracket
+static size_t regex_parse_class(regex_parser* p) {
+  size_t first = p->range_count;
+  bool negate = false;
+  if (regex_peek(p) == '^') {
+    negate = true;
+    p->position += 1;
+  }
+
+  bool leading = true;
+  while (!regex_at_end(p) && (regex_peek(p) != ']' || leading)) {
+    leading = false;
+    uint32_t lo = 0;
+    if (regex_peek(p) == '\\') {
+      p->position += 1;
+      if (!regex_at_end(p) && regex_add_perl_class(p, regex_peek(p))) {
+        p->position += 1;
+        continue;
+      }
+      lo = regex_parse_escape(p);
+    } else {
+      lo = regex_next_codepoint(p);
+    }
+    if (lo == UINT32_MAX) {
+      regex_syntax_error(p);
+      return REGEX_NO_NODE;
+    }
+
+    uint32_t hi = lo;
+    if (regex_peek(p) == '-' && p->position + 1 < p->length &&
+        p->pattern[p->position + 1] != ']') {
+      p->position += 1;
+      if (regex_peek(p) == '\\') {
+        p->position += 1;
+        hi = regex_parse_escape(p);
+      } else {
+        hi = regex_next_codepoint(p);
+      }
+      if (hi == UINT32_MAX || hi < lo) {
+        regex_syntax_error(p);
+        return REGEX_NO_NODE;
+      }
+    }
+    regex_add_range(p, lo, hi);
+  }
+
+  if (regex_at_end(p)) {
+    regex_syntax_error(p);
+    return REGEX_NO_NODE;
+  }
+  p->position += 1;  // ']'
+  return regex_finish_class(p, first, negate);
+}
+
+static size_t regex_parse_alternation(regex_parser* p);
+
+static size_t regex_parse_atom(regex_parser* p) {
+  char c = regex_peek(p);
+  size_t node = REGEX_NO_NODE;
+
+  switch (c) {
+    case '(':
+      if (++p->depth > REGEX_MAX_NESTING) {
+        p->status = CSTRING_ERR_OVERFLOW;
+        return REGEX_NO_NODE;
+      }
+      p->position += 1;
+      // Groups never capture, so (?:...) is accepted as a plain group
+      if (p->position + 1 < p->length && p->pattern[p->position] == '?' &&
+          p->pattern[p->position + 1] == ':') {
+        p->position += 2;
+      }
+      node = regex_parse_alternation(p);
+      if (regex_peek(p) != ')') {
+        regex_syntax_error(p);
+        return REGEX_NO_NODE;
+      }
+      p->position += 1;
+      p->depth -= 1;
+      return node;
+    case '[':
+      p->position += 1;
+      return regex_parse_class(p);
+    case '.': {
+      p->position += 1;
+      size_t first = p->range_count;
+      regex_add_range(p, '\n', '\n');
+      return regex_finish_class(p, first, true);
+    }
+    case '^':
+      p->position += 1;
+      return regex_new_node(p, REGEX_NODE_BEGIN);
+    case '$':
+      p->position += 1;
+      return regex_new_node(p, REGEX_NODE_END);
+    case '\\': {
+      p->position += 1;
+      if (!regex_at_end(p)) {
+        size_t first = p->range_count;
+        if (regex_add_perl_class(p, regex_peek(p))) {
+          p->position += 1;
+          return regex_finish_class(p, first, false);
+        }
+      }
+      uint32_t codepoint = regex_parse_escape(p);
+      if (codepoint == UINT32_MAX) {
+        regex_syntax_error(p);
+        return REGEX_NO_NODE;
+      }
+      node = regex_new_node(p, REGEX_NODE_LITERAL);
+      if (node != REGEX_NO_NODE) {
+        p->nodes[node].codepoint = codepoint;
+      }
+      return node;
+    }
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+      // A quantifier with nothing to repeat
+      regex_syntax_error(p);
+      return REGEX_NO_NODE;
+    default:
+      node = regex_new_node(p, REGEX_NODE_LITERAL);
+      if (node != REGEX_NO_NODE) {
+        p->nodes[node].codepoint = regex_next_codepoint(p);
+      }
+      return node;
+  }
+}
+
+// Decimal count of a bounded repeat, or -1
+static int regex_parse_count(regex_parser* p) {
+  int value = -1;
+  while (!regex_at_end(p) && regex_peek(p) >= '0' && regex_peek(p) <= '9') {
+    value = (value < 0 ? 0 : value * 10) + (regex_peek(p) - '0');
+    if (value > REGEX_MAX_REPEAT) {
+      p->status = CSTRING_ERR_OVERFLOW;
+      return -1;
+    }
+    p->position += 1;
+  }
+  return value;
+}
+
+static size_t regex_parse_repeat(regex_parser* p) {
+  size_t atom = regex_parse_atom(p);
+  if (atom == REGEX_NO_NODE) {
+    return REGEX_NO_NODE;
+  }
+
+  char c = regex_peek(p);
+  int min = 0;
+  int max = -1;
+  if (c == '*') {
+    p->position += 1;
+  } else if (c == '+') {
+    min = 1;
+    p->position += 1;
+  } else if (c == '?') {
+    max = 1;
+    p->position += 1;
+  } else if (c == '{') {
+    p->position += 1;
+    min = regex_parse_count(p);
+    max = min;
+    if (regex_peek(p) == ',') {
+      p->position += 1;
+      max = regex_parse_count(p);
+    }
+    if (p->status != CSTRING_OK) {
+      return REGEX_NO_NODE;
+    }
+    if (min < 0 || regex_peek(p) != '}' || (max >= 0 && max < min)) {
+      regex_syntax_error(p);
+      return REGEX_NO_NODE;
+    }
+    p->position += 1;
+  } else {
+    return atom;
+  }
+
+  size_t node = regex_new_pair(p, REGEX_NODE_REPEAT, atom, REGEX_NO_NODE);
+  if (node == REGEX_NO_NODE) {
+    return REGEX_NO_NODE;
+  }
+  p->nodes[node].min = min;
+  p->nodes[node].max = max;
+  p->nodes[node].greedy = true;
+  if (regex_peek(p) == '?') {
+    p->nodes[node].greedy = false;
+    p->position += 1;
+  }
+
+  c = regex_peek(p);
+  if (c == '*' || c == '+' || c == '?' || c == '{') {
+    // Nested repetition such as a** is almost always a mistake
+    regex_syntax_error(p);
+    return REGEX_NO_NODE;
+  }
+  return node;
+}
+
+static size_t regex_parse_concat(regex_parser* p) {
+  size_t node = REGEX_NO_NODE;
+  while (p->status == CSTRING_OK && !regex_at_end(p) && regex_peek(p) != '|' &&
+         regex_peek(p) != ')') {
+    size_t next = regex_parse_repeat(p);
+    node = node == REGEX_NO_NODE
+               ? next
+               : regex_new_pair(p, REGEX_NODE_CONCAT, node, next);
+  }
+  if (node == REGEX_NO_NODE) {
+    node = regex_new_node(p, REGEX_NODE_EMPTY);
+  }
+  return p->status == CSTRING_OK ? node : REGEX_NO_NODE;
+}
+
+static size_t regex_parse_alternation(regex_parser* p) {
+  size_t node = regex_parse_concat(p);
+  while (p->status == CSTRING_OK && regex_peek(p) == '|') {
+    p->position += 1;
+    size_t next = regex_parse_concat(p);
+    node = regex_new_pair(p, REGEX_NODE_ALTERNATE, node, next);
+  }
+  return p->status == CSTRING_OK ? node : REGEX_NO_NODE;
+}
+
+// Compilation
+
+static uint32_t regex_emit(regex_program* prog, RegexOp op) {
+  if (prog->status != CSTRING_OK) {
+    return 0;
+  }
+  if (prog->count == REGEX_MAX_PROGRAM) {
+    prog->status = CSTRING_ERR_OVERFLOW;
+    return 0;
+  }
+  if (prog->count == prog->capacity) {
+    size_t capacity = prog->capacity ? prog->capacity * 2 : 64;
+    regex_inst* insts = realloc(prog->insts, capacity * sizeof(*insts));
+    if (!insts) {
+      prog->status = CSTRING_ERR_NO_MEMORY;
+      return 0;
+    }
+    prog->insts = insts;
+    prog->capacity = capacity;
+  }
+
+  regex_inst* inst = &prog->insts[prog->count];
+  memset(inst, 0, sizeof(*inst));
+  inst->op = (unsigned char)op;
+  inst->out = REGEX_NO_HOLE;
+  inst->out1 = REGEX_NO_HOLE;
+  return (uint32_t)prog->count++;
+}
+
+static uint32_t regex_hole(uint32_t pc, bool second) {
+  return pc << 1 | (second ? 1u : 0u);
+}
+
+static uint32_t* regex_hole_field(regex_program* prog, uint32_t hole) {
+  regex_inst* inst = &prog->insts[hole >> 1];
+  return (hole & 1) ? &inst->out1 : &inst->out;
+}
+
+static void regex_patch(regex_program* prog, uint32_t holes, uint32_t target) {
+  while (holes != REGEX_NO_HOLE) {
+    uint32_t* field = regex_hole_field(prog, holes);
+    holes = *field;
+    *field = target;
+  }
+}
+
+static uint32_t regex_join_holes(regex_program* prog, uint32_t first,
+                                 uint32_t second) {
+  if (first == REGEX_NO_HOLE) {
+    return second;
+  }
+  uint32_t last = first;
+  while (*regex_hole_field(prog, last) != REGEX_NO_HOLE) {
+    last = *regex_hole_field(prog, last);
+  }
+  *regex_hole_field(prog, last) = second;
+  return first;
+}
+
+// Chain of byte ranges, emitted back to front for the reverse program
+static regex_frag regex_emit_bytes(regex_program* prog,
+                                   const unsigned char* lo,
+                                   const unsigned char* hi, size_t length,
+                                   bool reverse) {
+  regex_frag frag = {0, REGEX_NO_HOLE};
+  uint32_t previous = 0;
+  for (size_t i = 0; i < length; i++) {
+    size_t at = reverse ? length - 1 - i : i;
+    uint32_t pc = regex_emit(prog, REGEX_OP_BYTES);
+    if (prog->status != CSTRING_OK) {
+      return frag;
+    }
+    prog->insts[pc].lo = lo[at];
+    prog->insts[pc].hi = hi[at];
+    if (i == 0) {
+      frag.start = pc;
+    } else {
+      prog->insts[previous].out = pc;
+    }
+    previous = pc;
+  }
+  frag.holes = regex_hole(previous, false);
+  return frag;
+}
+
+typedef struct {
+  regex_frag frag;
+  uint32_t split_hole;  // where the next alternative attaches
+  bool empty;
+} regex_alternatives;
+
+// Add one UTF-8 byte sequence as the lowest-priority alternative
+static void regex_add_sequence(regex_program* prog, regex_alternatives* alts,
+                               const unsigned char* lo, const unsigned char* hi,
+                               size_t length, bool reverse) {
+  regex_frag bytes = regex_emit_bytes(prog, lo, hi, length, reverse);
+  uint32_t split = regex_emit(prog, REGEX_OP_SPLIT);
+  if (prog->status != CSTRING_OK) {
+    return;
+  }
+
+  prog->insts[split].out = bytes.start;
+  if (alts->empty) {
+    alts->frag.start = split;
+    alts->empty = false;
+  } else {
+    regex_patch(prog, alts->split_hole, split);
+  }
+  alts->split_hole = regex_hole(split, true);
+  alts->frag.holes = regex_join_holes(prog, alts->frag.holes, bytes.holes);
+}
+
+// Cut [lo, hi], which holds no surrogates, into ranges whose UTF-8 encodings
+// differ only within each byte's own range, and add one sequence per range.
+static void regex_add_utf8_ranges(regex_program* prog,
+                                  regex_alternatives* alts, uint32_t lo,
+                                  uint32_t hi, bool reverse) {
+  static const uint32_t length_limits[] = {0x7F, 0x7FF, 0xFFFF};
+  for (size_t i = 0; i < 3; i++) {
+    if (lo <= length_limits[i] && hi > length_limits[i]) {
+      regex_add_utf8_ranges(prog, alts, lo, length_limits[i], reverse);
+      regex_add_utf8_ranges(prog, alts, length_limits[i] + 1, hi, reverse);
+      return;
+    }
+  }
+
+  if (hi > 0x7F) {
+    for (unsigned int i = 1; i < 4; i++) {
+      uint32_t mask = (1u << (6 * i)) - 1;
+      if ((lo & ~mask) != (hi & ~mask)) {
+        if ((lo & mask) != 0) {
+          regex_add_utf8_ranges(prog, alts, lo, lo | mask, reverse);
+          regex_add_utf8_ranges(prog, alts, (lo | mask) + 1, hi, reverse);
+          return;
+        }
+        if ((hi & mask) != mask) {
+          regex_add_utf8_ranges(prog, alts, lo, (hi & ~mask) - 1, reverse);
+          regex_add_utf8_ranges(prog, alts, hi & ~mask, hi, reverse);
+          return;
+        }
+      }
+    }
+  }
+
+  char first[4];
+  char last[4];
+  size_t length = encode_utf8(lo, first);
+  encode_utf8(hi, last);
+  regex_add_sequence(prog, alts, (const unsigned char*)first,
+                     (const unsigned char*)last, length, reverse);
+}
+
+static regex_frag regex_compile_class(regex_program* prog,
+                                      const regex_range* ranges, size_t count,
+                                      bool reverse) {
+  regex_alternatives alts = {{0, REGEX_NO_HOLE}, REGEX_NO_HOLE, true};
+  for (size_t i = 0; i < count; i++) {
+    uint32_t lo = ranges[i].lo;
+    uint32_t hi = ranges[i].hi;
+    // Surrogates have no UTF-8 encoding
+    if (lo < 0xD800 && hi >= 0xD800) {
+      regex_add_utf8_ranges(prog, &alts, lo, 0xD7FF, reverse);
+      lo = 0xE000;
+    } else if (lo >= 0xD800 && lo <= 0xDFFF) {
+      lo = 0xE000;
+    }
+    if (lo <= hi) {
+      regex_add_utf8_ranges(prog, &alts, lo, hi, reverse);
+    }
+  }
+
+  if (alts.empty) {
+    // Nothing to match: a byte range that no byte falls in
+    static const unsigned char none_lo = 1;
+    static const unsigned char none_hi = 0;
+    return regex_emit_bytes(prog, &none_lo, &none_hi, 1, reverse);
+  }
+
+  // The last alternative has nothing after it to fall back to
+  if (prog->status == CSTRING_OK) {
+    prog->insts[alts.split_hole >> 1].op = REGEX_OP_NOP;
+  }
+  return alts.frag;
+}
+
+static regex_frag regex_compile_node(regex_program* prog,
+                                     const regex_parser* p, size_t index,
+                                     bool reverse);
+
+// x{min,max} as min copies of x followed by either x* or nested optional
+// copies x(x(x)?)?, which keep the number of live threads small.
+static regex_frag regex_compile_repeat(regex_program* prog,
+                                       const regex_parser* p,
+                                       const regex_node* node, bool reverse) {
+  regex_frag result = {0, REGEX_NO_HOLE};
+  bool empty = true;
+
+  for (int i = 0; i < node->min && prog->status == CSTRING_OK; i++) {
+    regex_frag copy = regex_compile_node(prog, p, node->left, reverse);
+    if (prog->status != CSTRING_OK) {
+      break;
+    }
+    if (empty) {
+      result = copy;
+      empty = false;
+    } else {
+      regex_patch(prog, result.holes, copy.start);
+      result.holes = copy.holes;
+    }
+  }
+
+  int optional = node->max < 0 ? 1 : node->max - node->min;
+  uint32_t pending = REGEX_NO_HOLE;  // holes of the previous optional copy
+  for (int i = 0; i < optional && prog->status == CSTRING_OK; i++) {
+    uint32_t split = regex_emit(prog, REGEX_OP_SPLIT);
+    regex_frag copy = regex_compile_node(prog, p, node->left, reverse);
+    if (prog->status != CSTRING_OK) {
+      break;
+    }
+
+    if (node->greedy) {
+      prog->insts[split].out = copy.start;
+    } else {
+      prog->insts[split].out1 = copy.start;
+    }
+    uint32_t exit = regex_hole(split, node->greedy);
+
+    if (node->max < 0) {
+      // Loop back for another iteration
+      regex_patch(prog, copy.holes, split);
+      copy.holes = REGEX_NO_HOLE;
+    }
+
+    if (empty) {
+      result.start = split;
+      empty = false;
+    } else if (i == 0) {
+      regex_patch(prog, result.holes, split);
+      result.holes = REGEX_NO_HOLE;
+    } else {
+      regex_patch(prog, pending, split);
+    }
+    result.holes = regex_join_holes(prog, result.holes, exit);
+    pending = copy.holes;
+  }
+  result.holes = regex_join_holes(prog, result.holes, pending);
+
+  if (empty) {
+    uint32_t nop = regex_emit(prog, REGEX_OP_NOP);
+    result.start = nop;
+    result.holes = regex_hole(nop, false);
+  }
+  return result;
+}
+
+// The parser builds left-deep chains, (((a b) c) d), as long as the pattern,
+// so chains are walked down their left spine in a loop instead of recursing
+// into it. Only the right operands recurse, and those are at most as deep as
+// the pattern's groups. The spine yields the operands last to first, which
+// is scan order for the reverse program; the forward program is assembled
+// back to front instead.
+static regex_frag regex_compile_concat(regex_program* prog,
+                                       const regex_parser* p, size_t index,
+                                       bool reverse) {
+  regex_frag result = {0, REGEX_NO_HOLE};
+  bool empty = true;
+  size_t next = index;
+  while (prog->status == CSTRING_OK) {
+    const regex_node* node = &p->nodes[next];
+    bool chain = node->kind == REGEX_NODE_CONCAT;
+    regex_frag operand =
+        regex_compile_node(prog, p, chain ? node->right : next, reverse);
+    if (prog->status != CSTRING_OK) {
+      break;
+    }
+
+    if (empty) {
+      result = operand;
+      empty = false;
+    } else if (reverse) {
+      regex_patch(prog, result.holes, operand.start);
+      result.holes = operand.holes;
+    } else {
+      regex_patch(prog, operand.holes, result.start);
+      result.start = operand.start;
+    }
+
+    if (!chain) {
+      break;
+    }
+    next = node->left;
+  }
+  return result;
+}
+
+// a|b|c|d as a chain of splits, each preferring the alternatives before it
+static regex_frag regex_compile_alternate(regex_program* prog,
+                                          const regex_parser* p, size_t index,
+                                          bool reverse) {
+  regex_frag result = {0, REGEX_NO_HOLE};
+  uint32_t previous = REGEX_NO_HOLE;  // split waiting for its preferred branch
+  size_t next = index;
+  while (prog->status == CSTRING_OK) {
+    const regex_node* node = &p->nodes[next];
+    if (node->kind != REGEX_NODE_ALTERNATE) {
+      regex_frag first = regex_compile_node(prog, p, next, reverse);
+      if (prog->status == CSTRING_OK) {
+        prog->insts[previous].out = first.start;
+        result.holes = regex_join_holes(prog, result.holes, first.holes);
+      }
+      break;
+    }
+
+    uint32_t split = regex_emit(prog, REGEX_OP_SPLIT);
+    regex_frag last = regex_compile_node(prog, p, node->right, reverse);
+    if (prog->status != CSTRING_OK) {
+      break;
+    }
+    prog->insts[split].out1 = last.start;
+    if (previous == REGEX_NO_HOLE) {
+      result.start = split;
+    } else {
+      prog->insts[previous].out = split;
+    }
+    result.holes = regex_join_holes(prog, result.holes, last.holes);
+    previous = split;
+    next = node->left;
+  }
+  return result;
+}
+
+static regex_frag regex_compile_node(regex_program* prog,
+                                     const regex_parser* p, size_t index,
+                                     bool reverse) {
+  regex_frag frag = {0, REGEX_NO_HOLE};
+  if (prog->status != CSTRING_OK) {
+    return frag;
+  }
+
+  const regex_node* node = &p->nodes[index];
+  switch ((RegexNodeKind)node->kind) {
+    case REGEX_NODE_EMPTY: {
+      uint32_t nop = regex_emit(prog, REGEX_OP_NOP);
+      frag.start = nop;
+      frag.holes = regex_hole(nop, false);
+      return frag;
+    }
+    case REGEX_NODE_LITERAL: {
+      char bytes[4];
+      size_t length = encode_utf8(node->codepoint, bytes);
+      return regex_emit_bytes(prog, (const unsigned char*)bytes,
+                              (const unsigned char*)bytes, length, reverse);
+    }
+    case REGEX_NODE_CLASS:
+      return regex_compile_class(prog, p->ranges + node->left, node->right,
+                                 reverse);
+    case REGEX_NODE_BEGIN:
+    case REGEX_NODE_END: {
+      uint32_t pc = regex_emit(prog, REGEX_OP_ASSERT);
+      if (prog->status == CSTRING_OK) {
+        bool begin = node->kind == REGEX_NODE_BEGIN;
+        prog->insts[pc].edge = (unsigned char)(begin != reverse
+                                                   ? REGEX_EDGE_BEHIND
+                                                   : REGEX_EDGE_AHEAD);
+      }
+      frag.start = pc;
+      frag.holes = regex_hole(pc, false);
+      return frag;
+    }
+    case REGEX_NODE_CONCAT:
+      return regex_compile_concat(prog, p, index, reverse);
+    case REGEX_NODE_ALTERNATE:
+      return regex_compile_alternate(prog, p, index, reverse);
+    case REGEX_NODE_REPEAT:
+      return regex_compile_repeat(prog, p, node, reverse);
+  }
+  return frag;
+}
+
+// Group the bytes that every instruction treats alike, so DFA states need one
+// transition per group rather than per byte.
+static void regex_compute_classes(regex_program* prog) {
+  bool boundary[257] = {false};
+  for (size_t i = 0; i < prog->count; i++) {
+    const regex_inst* inst = &prog->insts[i];
+    if (inst->op == REGEX_OP_BYTES && inst->lo <= inst->hi) {
+      boundary[inst->lo] = true;
+      boundary[inst->hi + 1] = true;
+    }
+  }
+
+  size_t current = 0;
+  for (size_t b = 0; b < 256; b++) {
+    if (boundary[b] && b > 0) {
+      current += 1;
+    }
+    prog->classes[b] = (unsigned char)current;
+    prog->class_bytes[current] = (unsigned char)b;
+  }
+  prog->class_count = current + 1;
+}
+
+// Compile the pattern into `prog`. The forward program is preceded by a lazy
+// any-byte loop so one scan tries every start position, earliest first.
+static CStringStatus regex_build_program(regex_program* prog,
+                                         const regex_parser* p, size_t root,
+                                         bool reverse) {
+  memset(prog, 0, sizeof(*prog));
+
+  uint32_t loop = 0;
+  if (!reverse) {
+    loop = regex_emit(prog, REGEX_OP_SPLIT);
+    uint32_t any = regex_emit(prog, REGEX_OP_BYTES);
+    if (prog->status == CSTRING_OK) {
+      prog->insts[any].lo = 0x00;
+      prog->insts[any].hi = 0xFF;
+      prog->insts[any].out = loop;
+      prog->insts[loop].out1 = any;
+    }
+  }
+
+  regex_frag frag = regex_compile_node(prog, p, root, reverse);
+  uint32_t match = regex_emit(prog, REGEX_OP_MATCH);
+  if (prog->status != CSTRING_OK) {
+    return prog->status;
+  }
+  regex_patch(prog, frag.holes, match);
+  prog->start = frag.start;
+  if (!reverse) {
+    prog->insts[loop].out = frag.start;
+  }
+
+  regex_compute_classes(prog);
+  return CSTRING_OK;
+}
+
+// First instruction other than a NOP on the way from `pc`
+static uint32_t regex_skip_nops(const regex_program* prog, uint32_t pc) {
+  while (prog->insts[pc].op == REGEX_OP_NOP) {
+    pc = prog->insts[pc].out;
+  }
+  return pc;
+}
+
+// Bytes every match starts with, read off the run of single-byte
+// instructions at the start of the forward program. Returns true when the
+// run is the whole pattern, which is then a literal.
+static bool regex_collect_prefix(const regex_program* prog, char* out,
+                                 size_t* length) {
+  uint32_t pc = regex_skip_nops(prog, prog->start);
+  while (prog->insts[pc].op == REGEX_OP_BYTES &&
+         prog->insts[pc].lo == prog->insts[pc].hi) {
+    if (*length == REGEX_PREFIX_CAPACITY) {
+      return false;
+    }
+    out[(*length)++] = (char)prog->insts[pc].lo;
+    pc = regex_skip_nops(prog, prog->insts[pc].out);
+  }
+  return prog->insts[pc].op == REGEX_OP_MATCH;
+}
+
+static bool regex_starts_anchored(const regex_program* prog) {
+  const regex_inst* inst = &prog->insts[regex_skip_nops(prog, prog->start)];
+  return inst->op == REGEX_OP_ASSERT && inst->edge == REGEX_EDGE_BEHIND;
+}
+
+// Lazy DFA
+
+static void regex_dfa_flush(regex_dfa* dfa) {
+  dfa->flushes += 1;
+  dfa->state_count = 0;
+  dfa->pool_count = 0;
+  for (size_t i = 0; i < 4; i++) {
+    dfa->start[i] = REGEX_UNKNOWN;
+  }
+  for (size_t i = 0; i < 2 * REGEX_DFA_MAX_STATES; i++) {
+    dfa->table[i] = REGEX_UNKNOWN;
+  }
+
+  // State 0 is the dead state: no threads left, no match
+  dfa->states[0].first = 0;
+  dfa->states[0].count = 0;
+  dfa->states[0].hash = 0;
+  dfa->states[0].match = false;
+  for (size_t i = 0; i < dfa->stride; i++) {
+    dfa->next[i] = REGEX_DEAD;
+  }
+  dfa->state_count = 1;
+}
+
+static CStringStatus regex_dfa_init(regex_dfa* dfa, const regex_program* prog,
+                                    uint32_t entry, bool longest) {
+  memset(dfa, 0, sizeof(*dfa));
+  dfa->program = prog;
+  dfa->entry = entry;
+  dfa->longest = longest;
+  dfa->stride = prog->class_count + 1;
+
+  // Room for the dead state plus one more, and for the longest possible
+  // thread list, so that after a flush a state can always be added without
+  // allocating.
+  dfa->state_capacity = 16;
+  dfa->pool_capacity = prog->count * 2;
+  dfa->states = malloc(dfa->state_capacity * sizeof(regex_dfa_state));
+  dfa->next = malloc(dfa->state_capacity * dfa->stride * sizeof(int32_t));
+  dfa->pool = malloc(dfa->pool_capacity * sizeof(uint32_t));
+  dfa->table = malloc(2 * REGEX_DFA_MAX_STATES * sizeof(int32_t));
+  dfa->list = malloc(prog->count * sizeof(uint32_t));
+  dfa->stack = malloc((2 * prog->count + 1) * sizeof(uint32_t));
+  dfa->marks = calloc(prog->count, sizeof(uint32_t));
+  if (!dfa->states || !dfa->next || !dfa->pool || !dfa->table || !dfa->list ||
+      !dfa->stack || !dfa->marks) {
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  regex_dfa_flush(dfa);
+  return CSTRING_OK;
+}
+
+static void regex_dfa_destroy(regex_dfa* dfa) {
+  free(dfa->states);
+  free(dfa->next);
+  free(dfa->pool);
+  free(dfa->table);
+  free(dfa->list);
+  free(dfa->stack);
+  free(dfa->marks);
+  memset(dfa, 0, sizeof(*dfa));
+}
+
+// Append the threads reachable from `pc` without consuming input to the
+// list, in priority order. Returns true when a match was reached and the
+// lower-priority threads still to come were cut.
+static bool regex_dfa_closure(regex_dfa* dfa, uint32_t pc, unsigned edges,
+                              size_t* count) {
+  const regex_inst* insts = dfa->program->insts;
+  size_t top = 0;
+  dfa->stack[top++] = pc;
+
+  while (top > 0) {
+    pc = dfa->stack[--top];
+    if (dfa->marks[pc] == dfa->generation) {
+      continue;
+    }
+    dfa->marks[pc] = dfa->generation;
+
+    const regex_inst* inst = &insts[pc];
+    switch ((RegexOp)inst->op) {
+      case REGEX_OP_NOP:
+        dfa->stack[top++] = inst->out;
+        break;
+      case REGEX_OP_SPLIT:
+        dfa->stack[top++] = inst->out1;
+        dfa->stack[top++] = inst->out;
+        break;
+      case REGEX_OP_ASSERT:
+        if (edges & inst->edge) {
+          dfa->stack[top++] = inst->out;
+        } else if (inst->edge == REGEX_EDGE_AHEAD) {
+          // Decided once the scan reaches the end of the text
+          dfa->list[(*count)++] = pc;
+        }
+        break;
+      case REGEX_OP_BYTES:
+        dfa->list[(*count)++] = pc;
+        break;
+      case REGEX_OP_MATCH:
+        dfa->list[(*count)++] = pc;
+        if (!dfa->longest) {
+          return true;
+        }
+        break;
+    }
+  }
+  return false;
+}
+
+static void regex_dfa_next_generation(regex_dfa* dfa) {
+  dfa->generation += 1;
+  if (dfa->generation == 0) {
+    memset(dfa->marks, 0, dfa->program->count * sizeof(uint32_t));
+    dfa->generation = 1;
+  }
+}
+
+// Index of the state for the `count` threads in dfa->list, adding it when
+// new. Never fails: when memory runs out, or the state limit is reached, the
+// cache is flushed to make room.
+static int32_t regex_dfa_state_for(regex_dfa* dfa, size_t count) {
+  const regex_inst* insts = dfa->program->insts;
+  uint64_t hash = cstring_hash(dfa->list, count * sizeof(uint32_t), 0);
+  size_t mask = 2 * REGEX_DFA_MAX_STATES - 1;
+
+  size_t slot = (size_t)hash & mask;
+  while (dfa->table[slot] != REGEX_UNKNOWN) {
+    const regex_dfa_state* s = &dfa->states[dfa->table[slot]];
+    if (s->hash == hash && s->count == count &&
+        memcmp(dfa->pool + s->first, dfa->list, count * sizeof(uint32_t)) ==
+            0) {
+      return dfa->table[slot];
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  if (count == 0) {
+    return REGEX_DEAD;
+  }
+
+  bool full = dfa->state_count == REGEX_DFA_MAX_STATES;
+  if (!full && dfa->state_count == dfa->state_capacity) {
+    size_t capacity = dfa->state_capacity * 2;
+    regex_dfa_state* states =
+        realloc(dfa->states, capacity * sizeof(regex_dfa_state));
+    if (states) {
+      dfa->states = states;
+      int32_t* next =
+          realloc(dfa->next, capacity * dfa->stride * sizeof(int32_t));
+      if (next) {
+        dfa->next = next;
+        dfa->state_capacity = capacity;
+      }
+    }
+    full = dfa->state_count == dfa->state_capacity;
+  }
+  if (!full && dfa->pool_count + count > dfa->pool_capacity) {
+    size_t capacity = dfa->pool_capacity * 2;
+    uint32_t* pool = realloc(dfa->pool, capacity * sizeof(uint32_t));
+    if (pool) {
+      dfa->pool = pool;
+      dfa->pool_capacity = capacity;
+    }
+    full = dfa->pool_count + count > dfa->pool_capacity;
+  }
+  if (full) {
+    regex_dfa_flush(dfa);
+    slot = (size_t)hash & mask;
+  }
+
+  int32_t index = (int32_t)dfa->state_count++;
+  regex_dfa_state* s = &dfa->states[index];
+  s->first = dfa->pool_count;
+  s->count = count;
+  s->hash = hash;
+  s->match = false;
+  for (size_t i = 0; i < count; i++) {
+    s->match |= insts[dfa->list[i]].op == REGEX_OP_MATCH;
+  }
+  memcpy(dfa->pool + dfa->pool_count, dfa->list, count * sizeof(uint32_t));
+  dfa->pool_count += count;
+
+  for (size_t i = 0; i < dfa->stride; i++) {
+    dfa->next[(size_t)index * dfa->stride + i] = REGEX_UNKNOWN;
+  }
+  while (dfa->table[slot] != REGEX_UNKNOWN) {
+    slot = (slot + 1) & mask;
+  }
+  dfa->table[slot] = index;
+  return index;
+}
+
+// State at the start of a scan. `edges` says which edges of the text the
+// start position touches; an empty text touches both.
+static int32_t regex_dfa_start(regex_dfa* dfa, unsigned edges) {
+  if (dfa->start[edges] != REGEX_UNKNOWN) {
+    return dfa->start[edges];
+  }
+
+  regex_dfa_next_generation(dfa);
+  size_t count = 0;
+  regex_dfa_closure(dfa, dfa->entry, edges, &count);
+  int32_t state = regex_dfa_state_for(dfa, count);
+  dfa->start[edges] = state;
+  return state;
+}
+
+// State after `state` consumes byte class `symbol_class`, or reaches the end
+// of the text when `symbol_class` is the program's class_count
+static int32_t regex_dfa_transition(regex_dfa* dfa, int32_t state,
+                                    size_t symbol_class) {
+  size_t slot = (size_t)state * dfa->stride + symbol_class;
+  if (dfa->next[slot] != REGEX_UNKNOWN) {
+    return dfa->next[slot];
+  }
+
+  const regex_program* prog = dfa->program;
+  bool end_of_text = symbol_class == prog->class_count;
+  unsigned int byte = end_of_text ? REGEX_END_OF_TEXT
+                                  : prog->class_bytes[symbol_class];
+  const regex_dfa_state* s = &dfa->states[state];
+  const uint32_t* threads = dfa->pool + s->first;
+
+  regex_dfa_next_generation(dfa);
+  size_t count = 0;
+  for (size_t i = 0; i < s->count; i++) {
+    const regex_inst* inst = &prog->insts[threads[i]];
+    bool cut = false;
+    if (inst->op == REGEX_OP_BYTES && byte >= inst->lo && byte <= inst->hi) {
+      cut = regex_dfa_closure(dfa, inst->out, 0, &count);
+    } else if (inst->op == REGEX_OP_ASSERT && end_of_text) {
+      cut = regex_dfa_closure(dfa, inst->out, REGEX_EDGE_AHEAD, &count);
+    }
+    if (cut) {
+      break;
+    }
+  }
+
+  size_t flushes = dfa->flushes;
+  int32_t target = regex_dfa_state_for(dfa, count);
+  // A flush dropped `state` along with its transitions
+  if (dfa->flushes == flushes) {
+    dfa->next[slot] = target;
+  }
+  return target;
+}
+
+// Matching
+
+// End of the leftmost-first match starting at or after `from`
+static bool regex_scan_forward(c_string_regex* re, const char* data,
+                               size_t length, size_t from, size_t* end) {
+  regex_dfa* dfa = &re->forward_dfa;
+  const regex_program* prog = dfa->program;
+
+  if (re->has_prefix) {
+    c_string_view haystack = {data, length, 0, false};
+    size_t candidate = view_find(haystack, &re->prefix, from);
+    if (candidate == CSTRING_NPOS) {
+      return false;
+    }
+    from = candidate;
+  }
+
+  if (re->has_prefix) {
+    // Known up front so the loop below can tell when it is back at the start
+    regex_dfa_start(dfa, 0);
+  }
+
+  bool found = false;
+  int32_t state =
+      regex_dfa_start(dfa, (from == 0 ? REGEX_EDGE_BEHIND : 0u) |
+                               (from == length ? REGEX_EDGE_AHEAD : 0u));
+  size_t p = from;
+  for (;;) {
+    if (dfa->states[state].match) {
+      found = true;
+      *end = p;
+    }
+    if (state == REGEX_DEAD) {
+      break;
+    }
+    if (p == length) {
+      state = regex_dfa_transition(dfa, state, prog->class_count);
+      if (dfa->states[state].match) {
+        found = true;
+        *end = p;
+      }
+      break;
+    }
+
+    if (re->has_prefix && state == dfa->start[0]) {
+      // Nothing in progress: skip ahead to the next place a match can start
+      c_string_view haystack = {data, length, 0, false};
+      size_t candidate = view_find(haystack, &re->prefix, p);
+      if (candidate == CSTRING_NPOS) {
+        break;
+      }
+      p = candidate;
+    }
+
+    state = regex_dfa_transition(dfa, state,
+                                 prog->classes[(unsigned char)data[p]]);
+    p += 1;
+  }
+  return found;
+}
+
+// Earliest start, not before `from`, of a match ending at `end`
+static size_t regex_scan_reverse(c_string_regex* re, const char* data,
+                                 size_t length, size_t from, size_t end) {
+  regex_dfa* dfa = &re->reverse_dfa;
+  const regex_program* prog = dfa->program;
+
+  size_t start = end;
+  int32_t state =
+      regex_dfa_start(dfa, (end == length ? REGEX_EDGE_BEHIND : 0u) |
+                               (end == 0 ? REGEX_EDGE_AHEAD : 0u));
+  size_t p = end;
+  for (;;) {
+    if (dfa->states[state].match) {
+      start = p;
+    }
+    if (state == REGEX_DEAD) {
+      break;
+    }
+    if (p == from) {
+      if (p == 0) {
+        state = regex_dfa_transition(dfa, state, prog->class_count);
+        if (dfa->states[state].match) {
+          start = 0;
+        }
+      }
+      break;
+    }
+    p -= 1;
+    state = regex_dfa_transition(dfa, state,
+                                 prog->classes[(unsigned char)data[p]]);
+  }
+  return start;
+}
+
+static bool regex_search(c_string_regex* re, const char* data, size_t length,
+                         size_t from, c_string_span* match) {
+  if (from > length || (re->anchored && from > 0)) {
+    return false;
+  }
+
+  c_string_span found;
+  if (re->literal) {
+    c_string_view haystack = {data, length, 0, false};
+    found.offset = view_find(haystack, &re->prefix, from);
+    if (found.offset == CSTRING_NPOS) {
+      return false;
+    }
+    found.length = re->prefix.length;
+  } else {
+    size_t end = 0;
+    if (!regex_scan_forward(re, data, length, from, &end)) {
+      return false;
+    }
+    found.offset =
+        re->anchored ? 0 : regex_scan_reverse(re, data, length, from, end);
+    found.length = end - found.offset;
+  }
+
+  if (match) {
+    *match = found;
+  }
+  return true;
+}
+
+// Where to look for the next match after `match`. An empty match moves on by
+// one code point so the scan always advances.
+static size_t regex_resume(const char* data, size_t length,
+                           c_string_span match) {
+  size_t end = match.offset + match.length;
+  if (match.length > 0) {
+    return end;
+  }
+  return end < length ? skip_codepoints(data, length, end, 1) : length + 1;
+}
+
+CStringStatus regex_compile(const char* pattern, c_string_regex** out) {
+  if (!pattern || !out) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  *out = NULL;
+
+  size_t length = strlen(pattern);
+  if (!analyze_utf8(pattern, length).valid) {
+    return CSTRING_ERR_INVALID_UTF8;
+  }
+
+  regex_parser p;
+  memset(&p, 0, sizeof(p));
+  p.pattern = pattern;
+  p.length = length;
+  p.status = CSTRING_OK;
+
+  size_t root = regex_parse_alternation(&p);
+  if (p.status == CSTRING_OK && !regex_at_end(&p)) {
+    // An unmatched ')'
+    regex_syntax_error(&p);
+  }
+  if (p.status != CSTRING_OK) {
+    free(p.nodes);
+    free(p.ranges);
+    return p.status;
+  }
+
+  c_string_regex* re = calloc(1, sizeof(*re));
+  if (!re) {
+    free(p.nodes);
+    free(p.ranges);
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  CStringStatus status = regex_build_program(&re->forward, &p, root, false);
+  if (status == CSTRING_OK) {
+    status = regex_build_program(&re->reverse, &p, root, true);
+  }
+
+  if (status == CSTRING_OK) {
+    re->anchored = regex_starts_anchored(&re->forward);
+    size_t prefix_length = 0;
+    bool literal =
+        regex_collect_prefix(&re->forward, re->prefix_bytes, &prefix_length);
+    if (prefix_length > 0) {
+      re->has_prefix = true;
+      re->literal = literal;
+      needle_compile(&re->prefix, re->prefix_bytes, prefix_length);
+    }
+
+    // Anchored patterns try the single start position only
+    status = regex_dfa_init(&re->forward_dfa, &re->forward,
+                            re->anchored ? re->forward.start : 0, false);
+  }
+  if (status == CSTRING_OK) {
+    status = regex_dfa_init(&re->reverse_dfa, &re->reverse, re->reverse.start,
+                            true);
+  }
+
+  free(p.nodes);
+  free(p.ranges);
+  if (status != CSTRING_OK) {
+    regex_destroy(re);
+    return status;
+  }
+
+  *out = re;
+  return CSTRING_OK;
+}
+
+void regex_destroy(c_string_regex* re) {
+  if (!re) {
+    return;
+  }
+
+  regex_dfa_destroy(&re->forward_dfa);
+  regex_dfa_destroy(&re->reverse_dfa);
+  free(re->forward.insts);
+  free(re->reverse.insts);
+  free(re);
+}
+
+bool view_regex_find(c_string_regex* re, c_string_view haystack, size_t from,
+                     c_string_span* match) {
+  if (!re || (haystack.length > 0 && !haystack.data)) {
+    return false;
+  }
+  return regex_search(re, haystack.data, haystack.length, from, match);
+}
+
+bool string_regex_find(c_string_regex* re, const c_string* haystack,
+                       size_t from, c_string_span* match) {
+  if (!haystack) {
+    return false;
+  }
+  return view_regex_find(re, string_view(haystack), from, match);
+}
+
+size_t view_regex_find_all(c_string_regex* re, c_string_view haystack,
+                           c_string_span* matches, size_t max_matches) {
+  if (!re || (haystack.length > 0 && !haystack.data)) {
+    return 0;
+  }
+
+  size_t count = 0;
+  size_t from = 0;
+  c_string_span match;
+  while (regex_search(re, haystack.data, haystack.length, from, &match)) {
+    if (matches && count < max_matches) {
+      matches[count] = match;
+    }
+    count += 1;
+    from = regex_resume(haystack.data, haystack.length, match);
+  }
+  return count;
+}
+
+size_t string_regex_find_all(c_string_regex* re, const c_string* haystack,
+                             c_string_span* matches, size_t max_matches) {
+  if (!haystack) {
+    return 0;
+  }
+  return view_regex_find_all(re, string_view(haystack), matches, max_matches);
+}
+
+static CStringStatus regex_split_view(c_string_regex* re, c_string_view v,
+                                      bool copy, c_string_split* out) {
+  if (!re || !out || (v.length > 0 && !v.data)) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  out->data = NULL;
+  out->spans = NULL;
+  out->count = 0;
+
+  // The matches are collected first and then turned, in place, into the
+  // tokens between them; there is always one more token than matches.
+  size_t capacity = 16;
+  size_t count = 0;
+  c_string_span* spans = malloc(capacity * sizeof(c_string_span));
+  if (!spans) {
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  size_t from = 0;
+  c_string_span match;
+  while (regex_search(re, v.data, v.length, from, &match)) {
+    if (count + 1 == capacity) {
+      c_string_span* grown =
+          realloc(spans, capacity * 2 * sizeof(c_string_span));
+      if (!grown) {
+        free(spans);
+        return CSTRING_ERR_NO_MEMORY;
+      }
+      spans = grown;
+      capacity *= 2;
+    }
+    spans[count++] = match;
+    from = regex_resume(v.data, v.length, match);
+  }
+
+  size_t copy_length = copy ? v.length : 0;
+  size_t span_bytes = (count + 1) * sizeof(c_string_span);
+  if (copy_length > SIZE_MAX - span_bytes) {
+    free(spans);
+    return CSTRING_ERR_OVERFLOW;
+  }
+  c_string_span* tokens = realloc(spans, span_bytes + copy_length);
+  if (!tokens) {
+    free(spans);
+    return CSTRING_ERR_NO_MEMORY;
+  }
+
+  for (size_t i = count + 1; i-- > 0;) {
+    size_t end = i < count ? tokens[i].offset : v.length;
+    size_t start = i > 0 ? tokens[i - 1].offset + tokens[i - 1].length : 0;
+    tokens[i].offset = start;
+    tokens[i].length = end - start;
+  }
+
+  out->data = v.data;
+  if (copy) {
+    char* bytes = (char*)tokens + span_bytes;
+    if (copy_length > 0) {
+      memcpy(bytes, v.data, copy_length);
+    }
+    out->data = bytes;
+  }
+  out->spans = tokens;
+  out->count = count + 1;
+  // Matches are whole code points, and empty ones are only tried on code
+  // point boundaries, so the tokens of valid input are valid.
+  out->known_valid = v.utf8_valid;
+  out->ascii = v.utf8_valid && v.codepoint_length == v.length;
+  return CSTRING_OK;
+}
+
+CStringStatus string_regex_split(c_string_regex* re, const c_string* s,
+                                 c_string_split* out) {
+  if (!s) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  return regex_split_view(re, string_view(s), true, out);
+}
+
+CStringStatus view_regex_split(c_string_regex* re, c_string_view v,
+                               c_string_split* out) {
+  return regex_split_view(re, v, false, out);
+}
+
+CStringResult view_regex_replace(c_string_regex* re, c_string_view v,
+                                 const char* replacement) {
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  if (!re || !replacement || (v.length > 0 && !v.data)) {
+    result.status = CSTRING_ERR_INVALID_ARG;
+    return result;
+  }
+
+  c_string_builder b;
+  result.status = builder_init(&b, v.length);
+  if (result.status != CSTRING_OK) {
+    return result;
+  }
+
+  size_t replacement_length = strlen(replacement);
+  size_t copied = 0;
+  size_t from = 0;
+  c_string_span match;
+  while (result.status == CSTRING_OK &&
+         regex_search(re, v.data, v.length, from, &match)) {
+    result.status =
+        builder_append_bytes(&b, v.data + copied, match.offset - copied);
+    if (result.status == CSTRING_OK) {
+      result.status =
+          builder_append_bytes(&b, replacement, replacement_length);
+    }
+    copied = match.offset + match.length;
+    from = regex_resume(v.data, v.length, match);
+  }
+  if (result.status == CSTRING_OK) {
+    result.status =
+        builder_append_bytes(&b, v.data + copied, v.length - copied);
+  }
+
+  if (result.status != CSTRING_OK) {
+    builder_destroy(&b);
+    return result;
+  }
+  return builder_finish(&b);
+}
+
+CStringResult string_regex_replace(c_string_regex* re, const c_string* s,
+                                   const char* replacement) {
+  if (!s) {
+    CStringResult result = {.value = NULL, .status = CSTRING_ERR_INVALID_ARG};
+    return result;
+  }
+  return view_regex_replace(re, string_view(s), replacement);
+}
+
+/* Number Formatting */
+
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536"
+    "37383940414243444546474849505152535455565758596061626364656667686970717273"
+    "7475767778798081828384858687888990919293949596979899";
+
+size_t format_uint64(uint64_t value, char* buffer) {
+  // Digits are produced from the right, two per division, then moved into
+  // place.
+  char digits[20];
+  size_t position = sizeof(digits);
+
+  while (value >= 100) {
+    size_t pair = (size_t)(value % 100) * 2;
+    value /= 100;
+    position -= 2;
+    memcpy(digits + position, digit_pairs + pair, 2);
+  }
+
+  if (value >= 10) {
+    position -= 2;
+    memcpy(digits + position, digit_pairs + value * 2, 2);
+  } else {
+    digits[--position] = (char)('0' + value);
+  }
+
+  size_t length = sizeof(digits) - position;
+  memcpy(buffer, digits + position, length);
+  buffer[length] = '\0';
+  return length;
+}
+
+size_t format_int64(int64_t value, char* buffer) {
+  if (value < 0) {
+    buffer[0] = '-';
+    // Negate in unsigned arithmetic so INT64_MIN does not overflow.
+    return 1 + format_uint64(0 - (uint64_t)value, buffer + 1);
+  }
+  return format_uint64((uint64_t)value, buffer);
+}
+
+size_t format_int32(int32_t value, char* buffer) {
+  return format_int64(value, buffer);
 }
 
-// Return string inside c_string with a null-terminator in case an external
-// function requires it
-char* get_null_terminated_string(c_string* s) {
-  char* result = malloc(s->length + 1);
-  if (!result) {
-    fputs("Memory allocation failure", stderr);
-    exit(EXIT_FAILURE);
+// Grisu2 (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+// with Integers"), following Milo Yip's formulation. It always produces digits
+// that read back to the same double and is shortest in all but a tiny
+// fraction of cases.
+
+typedef struct {
+  uint64_t f;
+  int e;
+} DiyFp;
+
+#define DOUBLE_SIGNIFICAND_SIZE 52
+#define DOUBLE_EXPONENT_BIAS (0x3FF + DOUBLE_SIGNIFICAND_SIZE)
+#define DOUBLE_HIDDEN_BIT (UINT64_C(1) << DOUBLE_SIGNIFICAND_SIZE)
+
+// Normalized 64-bit significands and binary exponents of 10^k for
+// k = -348, -340, ..., 340, generated with exact rational arithmetic.
+static const uint64_t grisu_cached_powers_f[] = {
+    UINT64_C(0xfa8fd5a0081c0288), UINT64_C(0xbaaee17fa23ebf76),
+    UINT64_C(0x8b16fb203055ac76), UINT64_C(0xcf42894a5dce35ea),
+    UINT64_C(0x9a6bb0aa55653b2d), UINT64_C(0xe61acf033d1a45df),
+    UINT64_C(0xab70fe17c79ac6ca), UINT64_C(0xff77b1fcbebcdc4f),
+    UINT64_C(0xbe5691ef416bd60c), UINT64_C(0x8dd01fad907ffc3c),
+    UINT64_C(0xd3515c2831559a83), UINT64_C(0x9d71ac8fada6c9b5),
+    UINT64_C(0xea9c227723ee8bcb), UINT64_C(0xaecc49914078536d),
+    UINT64_C(0x823c12795db6ce57), UINT64_C(0xc21094364dfb5637),
+    UINT64_C(0x9096ea6f3848984f), UINT64_C(0xd77485cb25823ac7),
+    UINT64_C(0xa086cfcd97bf97f4), UINT64_C(0xef340a98172aace5),
+    UINT64_C(0xb23867fb2a35b28e), UINT64_C(0x84c8d4dfd2c63f3b),
+    UINT64_C(0xc5dd44271ad3cdba), UINT64_C(0x936b9fcebb25c996),
+    UINT64_C(0xdbac6c247d62a584), UINT64_C(0xa3ab66580d5fdaf6),
+    UINT64_C(0xf3e2f893dec3f126), UINT64_C(0xb5b5ada8aaff80b8),
+    UINT64_C(0x87625f056c7c4a8b), UINT64_C(0xc9bcff6034c13053),
+    UINT64_C(0x964e858c91ba2655), UINT64_C(0xdff9772470297ebd),
+    UINT64_C(0xa6dfbd9fb8e5b88f), UINT64_C(0xf8a95fcf88747d94),
+    UINT64_C(0xb94470938fa89bcf), UINT64_C(0x8a08f0f8bf0f156b),
+    UINT64_C(0xcdb02555653131b6), UINT64_C(0x993fe2c6d07b7fac),
+    UINT64_C(0xe45c10c42a2b3b06), UINT64_C(0xaa242499697392d3),
+    UINT64_C(0xfd87b5f28300ca0e), UINT64_C(0xbce5086492111aeb),
+    UINT64_C(0x8cbccc096f5088cc), UINT64_C(0xd1b71758e219652c),
+    UINT64_C(0x9c40000000000000), UINT64_C(0xe8d4a51000000000),
+    UINT64_C(0xad78ebc5ac620000), UINT64_C(0x813f3978f8940984),
+    UINT64_C(0xc097ce7bc90715b3), UINT64_C(0x8f7e32ce7bea5c70),
+    UINT64_C(0xd5d238a4abe98068), UINT64_C(0x9f4f2726179a2245),
+    UINT64_C(0xed63a231d4c4fb27), UINT64_C(0xb0de65388cc8ada8),
+    UINT64_C(0x83c7088e1aab65db), UINT64_C(0xc45d1df942711d9a),
+    UINT64_C(0x924d692ca61be758), UINT64_C(0xda01ee641a708dea),
+    UINT64_C(0xa26da3999aef774a), UINT64_C(0xf209787bb47d6b85),
+    UINT64_C(0xb454e4a179dd1877), UINT64_C(0x865b86925b9bc5c2),
+    UINT64_C(0xc83553c5c8965d3d), UINT64_C(0x952ab45cfa97a0b3),
+    UINT64_C(0xde469fbd99a05fe3), UINT64_C(0xa59bc234db398c25),
+    UINT64_C(0xf6c69a72a3989f5c), UINT64_C(0xb7dcbf5354e9bece),
+    UINT64_C(0x88fcf317f22241e2), UINT64_C(0xcc20ce9bd35c78a5),
+    UINT64_C(0x98165af37b2153df), UINT64_C(0xe2a0b5dc971f303a),
+    UINT64_C(0xa8d9d1535ce3b396), UINT64_C(0xfb9b7cd9a4a7443c),
+    UINT64_C(0xbb764c4ca7a44410), UINT64_C(0x8bab8eefb6409c1a),
+    UINT64_C(0xd01fef10a657842c), UINT64_C(0x9b10a4e5e9913129),
+    UINT64_C(0xe7109bfba19c0c9d), UINT64_C(0xac2820d9623bf429),
+    UINT64_C(0x80444b5e7aa7cf85), UINT64_C(0xbf21e44003acdd2d),
+    UINT64_C(0x8e679c2f5e44ff8f), UINT64_C(0xd433179d9c8cb841),
+    UINT64_C(0x9e19db92b4e31ba9), UINT64_C(0xeb96bf6ebadf77d9),
+    UINT64_C(0xaf87023b9bf0ee6b)};
+
+static const int16_t grisu_cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954,
+    -927, -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635,
+    -608, -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316,
+    -289, -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30, 56,
+    83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348, 375, 402, 428, 455,
+    481, 508, 534, 561, 588, 614, 641, 667, 694, 720, 747, 774, 800, 827, 853,
+    880, 907, 933, 960, 986, 1013, 1039, 1066};
+
+static const uint64_t grisu_pow10[] = {UINT64_C(1),
+                                       UINT64_C(10),
+                                       UINT64_C(100),
+                                       UINT64_C(1000),
+                                       UINT64_C(10000),
+                                       UINT64_C(100000),
+                                       UINT64_C(1000000),
+                                       UINT64_C(10000000),
+                                       UINT64_C(100000000),
+                                       UINT64_C(1000000000),
+                                       UINT64_C(10000000000),
+                                       UINT64_C(100000000000),
+                                       UINT64_C(1000000000000),
+                                       UINT64_C(10000000000000),
+                                       UINT64_C(100000000000000),
+                                       UINT64_C(1000000000000000),
+                                       UINT64_C(10000000000000000),
+                                       UINT64_C(100000000000000000),
+                                       UINT64_C(1000000000000000000),
+                                       UINT64_C(10000000000000000000)};
+
+static DiyFp diyfp_from_double(double value) {
+  uint64_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+
+  int biased_exponent = (int)((bits >> DOUBLE_SIGNIFICAND_SIZE) & 0x7FF);
+  uint64_t significand = bits & (DOUBLE_HIDDEN_BIT - 1);
+
+  DiyFp result;
+  if (biased_exponent != 0) {
+    result.f = significand + DOUBLE_HIDDEN_BIT;
+    result.e = biased_exponent - DOUBLE_EXPONENT_BIAS;
+  } else {
+    // Subnormal: no hidden bit, smallest exponent.
+    result.f = significand;
+    result.e = 1 - DOUBLE_EXPONENT_BIAS;
   }
+  return result;
+}
 
-  result[s->length] = '\0';
-  memcpy(result, s->string, s->length);
+// Upper 64 bits of the 128-bit product, rounded.
+static DiyFp diyfp_multiply(DiyFp x, DiyFp y) {
+  const uint64_t mask32 = 0xFFFFFFFFu;
+  uint64_t a = x.f >> 32;
+  uint64_t b = x.f & mask32;
+  uint64_t c = y.f >> 32;
+  uint64_t d = y.f & mask32;
+  uint64_t ac = a * c;
+  uint64_t bc = b * c;
+  uint64_t ad = a * d;
+  uint64_t bd = b * d;
+  uint64_t middle = (bd >> 32) + (ad & mask32) + (bc & mask32);
+  middle += UINT64_C(1) << 31;
 
+  DiyFp result = {ac + (ad >> 32) + (bc >> 32) + (middle >> 32),
+                  x.e + y.e + 64};
   return result;
 }
 
-/* Free the string's content and the string itself */
-void destroy_string(c_string* input) {
-  free(input->string);
-  free(input);
+static DiyFp diyfp_normalize(DiyFp x) {
+  while (!(x.f & (UINT64_C(1) << 63))) {
+    x.f <<= 1;
+    x.e -= 1;
+  }
+  return x;
 }
 
-/* Help function used to free the memory used by the c_string** in string_delim
- */
-void destroy_delim_string(c_string** s) {
-  size_t i = 0;
-  while (s[i] != NULL) {
-    destroy_string(s[i]);
-    i += 1;
+// The neighbours halfway to the next and previous doubles, scaled to share an
+// exponent with the normalized upper bound.
+static void diyfp_boundaries(DiyFp v, DiyFp* minus, DiyFp* plus) {
+  DiyFp upper = {(v.f << 1) + 1, v.e - 1};
+  while (!(upper.f & (DOUBLE_HIDDEN_BIT << 1))) {
+    upper.f <<= 1;
+    upper.e -= 1;
   }
+  upper.f <<= 64 - DOUBLE_SIGNIFICAND_SIZE - 2;
+  upper.e -= 64 - DOUBLE_SIGNIFICAND_SIZE - 2;
 
-  free(s);
+  // Powers of two have a closer lower neighbour.
+  DiyFp lower = v.f == DOUBLE_HIDDEN_BIT ? (DiyFp){(v.f << 2) - 1, v.e - 2}
+                                         : (DiyFp){(v.f << 1) - 1, v.e - 1};
+  lower.f <<= lower.e - upper.e;
+  lower.e = upper.e;
+
+  *minus = lower;
+  *plus = upper;
 }
 
-/* Concatenate input into string s */
-void string_concat(c_string* s, const char* input) {
-  // TODO: Check how to handle possible allocation size overflow
-  s->string = realloc(s->string, s->length + strlen(input));
-  if (!(s->string)) {
-    fputs("Memory allocation failure", stderr);
-    exit(EXIT_FAILURE);
+// Pick the cached power 10^-k that brings the binary exponent into Grisu's
+// target range and return k.
+static DiyFp grisu_cached_power(int e, int* k) {
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int rounded = (int)dk;
+  if (dk - rounded > 0.0) {
+    rounded += 1;
   }
 
-  memcpy(s->string + s->length, input, strlen(input));
-  s->length += strlen(input);
+  size_t index = (size_t)((rounded >> 3) + 1);
+  *k = -(-348 + (int)(index << 3));
+
+  DiyFp power = {grisu_cached_powers_f[index], grisu_cached_powers_e[index]};
+  return power;
 }
 
-void string_modify(c_string* s, const char* input) {
-  size_t length = strlen(input);
-  char* temp = realloc(s->string, length);
-  if (temp != NULL) {
-    s->string = temp;
-    s->length = length;
-    memcpy(s->string, input, length);
+// Nudge the last digit down while that keeps it inside the rounding interval
+// and brings it closer to the exact value.
+static void grisu_round(char* buffer, size_t length, uint64_t delta,
+                        uint64_t rest, uint64_t ten_kappa, uint64_t distance) {
+  while (rest < distance && delta - rest >= ten_kappa &&
+         (rest + ten_kappa < distance ||
+          distance - rest > rest + ten_kappa - distance)) {
+    buffer[length - 1] -= 1;
+    rest += ten_kappa;
   }
 }
 
-/* Check if two strings are equal.
-   Longer string is considered greater.
-   Return > 0 if first is greater than second.
-   Return 0 if they are equal.
-   Return < 0 if second is greater than first. */
-int string_compare(const c_string* first, const c_string* second) {
-  if (first->length > second->length) {
-    return 1;
-  } else if (first->length < second->length) {
-    return -1;
+static int count_decimal_digits32(uint32_t n) {
+  int digits = 1;
+  while (n >= 10) {
+    n /= 10;
+    digits += 1;
+  }
+  return digits;
+}
+
+static size_t grisu_digit_gen(DiyFp w, DiyFp upper, uint64_t delta,
+                              char* buffer, int* k) {
+  const DiyFp one = {UINT64_C(1) << -upper.e, upper.e};
+  const uint64_t distance = upper.f - w.f;
+  uint32_t integral = (uint32_t)(upper.f >> -one.e);
+  uint64_t fractional = upper.f & (one.f - 1);
+  int kappa = count_decimal_digits32(integral);
+  size_t length = 0;
+
+  while (kappa > 0) {
+    uint32_t divisor = (uint32_t)grisu_pow10[kappa - 1];
+    uint32_t digit = integral / divisor;
+    integral %= divisor;
+    if (digit || length) {
+      buffer[length++] = (char)('0' + digit);
+    }
+    kappa -= 1;
+
+    uint64_t rest = ((uint64_t)integral << -one.e) + fractional;
+    if (rest <= delta) {
+      *k += kappa;
+      grisu_round(buffer, length, delta, rest,
+                  grisu_pow10[kappa] << -one.e, distance);
+      return length;
+    }
   }
 
-  return memcmp(first->string, second->string, first->length);
+  for (;;) {
+    fractional *= 10;
+    delta *= 10;
+    char digit = (char)(fractional >> -one.e);
+    if (digit || length) {
+      buffer[length++] = (char)('0' + digit);
+    }
+    fractional &= one.f - 1;
+    kappa -= 1;
+
+    if (fractional < delta) {
+      *k += kappa;
+      int index = -kappa;
+      grisu_round(buffer, length, delta, fractional, one.f,
+                  distance * (index < 20 ? grisu_pow10[index] : 0));
+      return length;
+    }
+  }
 }
 
-/* Printing Functions */
+// Shortest digits of a positive, finite value: value = digits * 10^k.
+static size_t grisu2(double value, char* digits, int* k) {
+  DiyFp v = diyfp_from_double(value);
+  DiyFp minus;
+  DiyFp plus;
+  diyfp_boundaries(v, &minus, &plus);
 
-void print(const c_string* s) { printf("%.*s", (int)s->length, s->string); }
+  DiyFp power = grisu_cached_power(plus.e, k);
+  DiyFp w = diyfp_multiply(diyfp_normalize(v), power);
+  DiyFp upper = diyfp_multiply(plus, power);
+  DiyFp lower = diyfp_multiply(minus, power);
+  lower.f += 1;
+  upper.f -= 1;
 
-void print_delim_strings(c_string** s) {
-  size_t i = 0;
-  printf("[");
-  while (s[i + 1] != NULL) {
-    printf("'");
-    print(s[i]);
-    printf("', ");
-    i += 1;
+  return grisu_digit_gen(w, upper, upper.f - lower.f, digits, k);
+}
+
+static size_t write_exponent(int exponent, char* buffer) {
+  size_t length = 0;
+  buffer[length++] = 'e';
+  buffer[length++] = exponent < 0 ? '-' : '+';
+  if (exponent < 0) {
+    exponent = -exponent;
   }
-  printf("'");
-  print(s[i]);
-  printf("']");
+  return length + format_uint64((uint64_t)exponent, buffer + length);
 }
 
-// Supported Colors: Red, Green, Yellow, Blue, Magenta and Cyan
-void print_colored(const c_string* s, const char* color) {
-  if ((strcmp(color, "red") == 0) || (strcmp(color, "Red")) == 0) {
-    printf(ANSI_COLOR_RED "%.*s" ANSI_COLOR_RESET, (int)s->length, s->string);
-  } else if ((strcmp(color, "green") == 0) || (strcmp(color, "Green")) == 0) {
-    printf(ANSI_COLOR_GREEN "%.*s" ANSI_COLOR_RESET, (int)s->length, s->string);
-  } else if ((strcmp(color, "yellow") == 0) || (strcmp(color, "Yellow")) == 0) {
-    printf(ANSI_COLOR_YELLOW "%.*s" ANSI_COLOR_RESET, (int)s->length,
-           s->string);
-  } else if ((strcmp(color, "blue") == 0) || (strcmp(color, "Blue")) == 0) {
-    printf(ANSI_COLOR_BLUE "%.*s" ANSI_COLOR_RESET, (int)s->length, s->string);
-  } else if ((strcmp(color, "magenta") == 0) ||
-             (strcmp(color, "Magenta")) == 0) {
-    printf(ANSI_COLOR_MAGENTA "%.*s" ANSI_COLOR_RESET, (int)s->length,
-           s->string);
-  } else if ((strcmp(color, "cyan") == 0) || (strcmp(color, "Cyan")) == 0) {
-    printf(ANSI_COLOR_CYAN "%.*s" ANSI_COLOR_RESET, (int)s->length, s->string);
-  } else if ((strcmp(color, "white") == 0) || (strcmp(color, "White")) == 0) {
-    printf(ANSI_COLOR_WHITE "%.*s" ANSI_COLOR_RESET, (int)s->length, s->string);
+size_t format_double(double value, char* buffer) {
+  size_t length = 0;
+  uint64_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+
+  if (bits >> 63) {
+    buffer[length++] = '-';
+    value = -value;
+  }
+
+  // Spell the special values the way printf's %g does.
+  if (value != value) {
+    memcpy(buffer, "nan", 4);
+    return 3;
+  }
+  if (value > 1.7976931348623157e308) {
+    memcpy(buffer + length, "inf", 4);
+    return length + 3;
+  }
+  if (value == 0.0) {
+    memcpy(buffer + length, "0", 2);
+    return length + 1;
+  }
+
+  char digits[24];
+  int k = 0;
+  size_t count = grisu2(value, digits, &k);
+  // Position of the decimal point relative to the first digit.
+  int point = (int)count + k;
+  char* out = buffer + length;
+
+  if (k >= 0 && point <= 21) {
+    // 1234e5 -> 123400000
+    memcpy(out, digits, count);
+    memset(out + count, '0', (size_t)k);
+    length += (size_t)point;
+  } else if (point > 0 && point <= 21) {
+    // 1234e-2 -> 12.34
+    memcpy(out, digits, (size_t)point);
+    out[point] = '.';
+    memcpy(out + point + 1, digits + point, count - (size_t)point);
+    length += count + 1;
+  } else if (point > -6 && point <= 0) {
+    // 1234e-6 -> 0.001234
+    size_t zeros = (size_t)-point;
+    memcpy(out, "0.", 2);
+    memset(out + 2, '0', zeros);
+    memcpy(out + 2 + zeros, digits, count);
+    length += 2 + zeros + count;
+  } else {
+    // 1234e30 -> 1.234e+33
+    out[0] = digits[0];
+    size_t written = 1;
+    if (count > 1) {
+      out[1] = '.';
+      memcpy(out + 2, digits + 1, count - 1);
+      written = count + 1;
+    }
+    length += written + write_exponent(point - 1, out + written);
   }
+
+  buffer[length] = '\0';
+  return length;
 }
 
-void print_utf8_info(const c_string* s) {
+// Wrap formatted ASCII output in a c_string; ASCII needs no UTF-8 analysis.
+static CStringResult string_from_ascii_in(c_string_arena* arena,
+                                          const char* bytes, size_t length) {
+  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+
+  c_string* s = allocate_string(arena, length);
   if (!s) {
-    printf("<null c_string>\n");
-    return;
+    result.status = CSTRING_ERR_NO_MEMORY;
+    return result;
   }
 
-  printf("string=%.*s bytes=%zu codepoints=%zu utf8_valid=%s\n", (int)s->length,
-         s->string, s->length, s->codepoint_length,
-         s->utf8_valid ? "true" : "false");
+  memcpy(s->string, bytes, length);
+  s->codepoint_length = length;
+  s->utf8_valid = true;
+  result.value = s;
+  return result;
 }
 
-size_t get_delim_string_length(c_string** s) {
-  size_t i = 0;
-  while (s[i + 1] != NULL) {
-    i += 1;
+CStringStatus builder_append_int64(c_string_builder* b, int64_t value) {
+  char buffer[CSTRING_INT_BUFFER_SIZE];
+  return builder_append_bytes(b, buffer, format_int64(value, buffer));
+}
+
+CStringStatus builder_append_uint64(c_string_builder* b, uint64_t value) {
+  char buffer[CSTRING_INT_BUFFER_SIZE];
+  return builder_append_bytes(b, buffer, format_uint64(value, buffer));
+}
+
+CStringStatus builder_append_double(c_string_builder* b, double value) {
+  char buffer[CSTRING_DOUBLE_BUFFER_SIZE];
+  return builder_append_bytes(b, buffer, format_double(value, buffer));
+}
+
+/* Number Parsing */
+
+#define EIGHT_BYTES(byte) (UINT64_C(0x0101010101010101) * (byte))
+
+// True when all eight bytes of the little-endian word are ASCII digits.
+static bool swar_all_digits(uint64_t word) {
+  return ((word & EIGHT_BYTES(0xF0)) |
+          (((word + EIGHT_BYTES(0x06)) & EIGHT_BYTES(0xF0)) >> 4)) ==
+         EIGHT_BYTES(0x33);
+}
+
+// Value of eight ASCII digits loaded as a little-endian word, first digit in
+// the lowest byte. Adjacent digits are merged pairwise in three multiplies.
+static uint32_t swar_eight_digits(uint64_t word) {
+  word -= EIGHT_BYTES('0');
+  word = (word * 10 + (word >> 8)) & UINT64_C(0x00FF00FF00FF00FF);
+  word = (word * 100 + (word >> 16)) & UINT64_C(0x0000FFFF0000FFFF);
+  return (uint32_t)((word * 10000 + (word >> 32)) & 0xFFFFFFFFu);
+}
+
+static bool load_eight_digits(const char* p, uint64_t* word) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(word, p, sizeof(*word));
+#else
+  *word = 0;
+  for (size_t i = 0; i < 8; i++) {
+    *word |= (uint64_t)(unsigned char)p[i] << (8 * i);
   }
+#endif
+  return swar_all_digits(*word);
+}
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
 
+// Number of leading ASCII digits in [p, p + length).
+static size_t count_digits(const char* p, size_t length) {
+  size_t i = 0;
+  uint64_t word;
+  while (length - i >= 8 && load_eight_digits(p + i, &word)) {
+    i += 8;
+  }
+  while (i < length && is_digit(p[i])) {
+    i++;
+  }
   return i;
 }
 
-// Read stdin input into c_string
-void scan_string(c_string* s, const char* prompt);
+// Parse an unsigned decimal that must span the whole range.
+static CStringStatus parse_uint64_digits(const char* p, size_t length,
+                                         uint64_t* out) {
+  if (length == 0 || count_digits(p, length) != length) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
 
-/* String Transformation Functions */
+  size_t i = 0;
+  while (i < length && p[i] == '0') {
+    i++;
+  }
+  // 20 significant digits may still fit; 21 never do.
+  if (length - i > 20) {
+    return CSTRING_ERR_OVERFLOW;
+  }
 
-// Split string according to given delimiter.
-//  * If delimiter size > input size, we consider that the delimiter was not
-//  found and return the original input.
-//  * If delimiter is exactly the input string, we return ['', ''] since we have
-//  nothing "before" and "after" the delimiter match.
-c_string** string_delim(const c_string* s, const char* delim) {
-  // Count number of delimiter occurences.
-  // We start the count at 1 since no match = returning the original string.
-  size_t delim_counter = 1;
-  const size_t delim_size = strlen(delim);
-
-  if (delim_size > 0 && delim_size <= s->length) {
-    for (size_t i = 0; i <= s->length - delim_size;) {
-      if ((memcmp(s->string + i, delim, delim_size) == 0)) {
-        delim_counter += 1;
-        i += delim_size;
-      } else {
-        i += 1;
-      }
+  // Up to 19 digits cannot overflow, so only the 20th needs a check.
+  uint64_t value = 0;
+  size_t safe_end = length - i == 20 ? length - 1 : length;
+  uint64_t word;
+  while (safe_end - i >= 8) {
+    load_eight_digits(p + i, &word);
+    value = value * 100000000 + swar_eight_digits(word);
+    i += 8;
+  }
+  while (i < safe_end) {
+    value = value * 10 + (uint64_t)(p[i++] - '0');
+  }
+  if (i < length) {
+    uint64_t digit = (uint64_t)(p[i] - '0');
+    if (value > (UINT64_MAX - digit) / 10) {
+      return CSTRING_ERR_OVERFLOW;
     }
+    value = value * 10 + digit;
   }
 
-  c_string** new_split_string = calloc(delim_counter + 1, sizeof(c_string*));
-  if (!new_split_string) {
-    return NULL;
+  *out = value;
+  return CSTRING_OK;
+}
+
+CStringStatus view_to_uint64(c_string_view v, uint64_t* out) {
+  if (!out || (!v.data && v.length)) {
+    return CSTRING_ERR_INVALID_ARG;
   }
 
-  // If we encounter no delimiter matches, return the original input string.
-  // We allocate with size 2 to make use of a NULL terminator at the end.
-  // This helps us print the resulting c_string*.
-  if (delim_counter == 1) {
-    CStringResult copy = string_new(s);
-    if (copy.status != CSTRING_OK) {
-      free(new_split_string);
-      return NULL;
-    }
-    new_split_string[0] = copy.value;
-    new_split_string[1] = NULL;
-    return new_split_string;
-  }
-
-  size_t last_location = 0;
-  size_t result_index = 0;
-  for (size_t i = 0; i <= s->length - delim_size;) {
-    if ((memcmp(s->string + i, delim, delim_size) == 0)) {
-      if (i - last_location > 0) {
-        CStringResult slice = string_from_char(s->string + last_location,
-                                               (int)(i - last_location));
-        if (slice.status != CSTRING_OK) {
-          destroy_delim_string(new_split_string);
-          return NULL;
-        }
-        new_split_string[result_index] = slice.value;
-      } else {
-        // There's nothing before the matched delimiter, so we add an empty
-        // string.
-        CStringResult empty = initialize_buffer(0);
-        if (empty.status != CSTRING_OK) {
-          destroy_delim_string(new_split_string);
-          return NULL;
-        }
-        new_split_string[result_index] = empty.value;
-      }
+  const char* p = v.data;
+  size_t length = v.length;
+  if (length && p[0] == '+') {
+    p++;
+    length--;
+  }
+  return parse_uint64_digits(p, length, out);
+}
 
-      last_location = i + delim_size;
-      result_index += 1;
-      i += delim_size;
-    } else {
-      i += 1;
-    }
+CStringStatus view_to_int64(c_string_view v, int64_t* out) {
+  if (!out || (!v.data && v.length)) {
+    return CSTRING_ERR_INVALID_ARG;
   }
 
-  if (last_location < s->length) {
-    CStringResult tail = string_from_char(s->string + last_location,
-                                          (int)(s->length - last_location));
-    if (tail.status != CSTRING_OK) {
-      destroy_delim_string(new_split_string);
-      return NULL;
-    }
-    new_split_string[result_index] = tail.value;
+  const char* p = v.data;
+  size_t length = v.length;
+  bool negative = false;
+  if (length && (p[0] == '+' || p[0] == '-')) {
+    negative = p[0] == '-';
+    p++;
+    length--;
+  }
+
+  uint64_t magnitude = 0;
+  CStringStatus status = parse_uint64_digits(p, length, &magnitude);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+
+  const uint64_t limit = (uint64_t)INT64_MAX + (negative ? 1 : 0);
+  if (magnitude > limit) {
+    return CSTRING_ERR_OVERFLOW;
+  }
+  if (!negative) {
+    *out = (int64_t)magnitude;
+  } else if (magnitude == limit) {
+    *out = INT64_MIN;
   } else {
-    CStringResult empty = initialize_buffer(0);
-    if (empty.status != CSTRING_OK) {
-      destroy_delim_string(new_split_string);
-      return NULL;
+    *out = -(int64_t)magnitude;
+  }
+  return CSTRING_OK;
+}
+
+static bool equals_ignore_case(const char* p, size_t length,
+                               const char* lower) {
+  size_t i = 0;
+  for (; i < length && lower[i]; i++) {
+    if ((p[i] | 0x20) != lower[i]) {
+      return false;
     }
-    new_split_string[result_index] = empty.value;
   }
-  new_split_string[result_index + 1] = NULL;
+  return i == length && !lower[i];
+}
 
-  return new_split_string;
+// Fold a run of digits into `value`, eight at a time where possible. The
+// caller guarantees the result fits.
+static uint64_t accumulate_digits(uint64_t value, const char* p,
+                                  size_t length) {
+  size_t i = 0;
+  uint64_t word;
+  for (; length - i >= 8; i += 8) {
+    load_eight_digits(p + i, &word);
+    value = value * 100000000 + swar_eight_digits(word);
+  }
+  for (; i < length; i++) {
+    value = value * 10 + (uint64_t)(p[i] - '0');
+  }
+  return value;
 }
 
-CStringResult trim_char(const c_string* s, const char c) {
-  CStringResult result = {.value = NULL, .status = CSTRING_OK};
+// Exact powers of ten representable in a double.
+static const double exact_pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                     1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                     1e18, 1e19, 1e20, 1e21, 1e22};
 
-  if (!s) {
-    result.status = CSTRING_ERR_INVALID_ARG;
-    return result;
+#define MAX_EXACT_MANTISSA (UINT64_C(1) << 53)
+
+// Clinger's fast path: when both the mantissa and the power of ten are exact
+// doubles, one IEEE multiply or divide is correctly rounded. Needs arithmetic
+// done in plain double precision (not x87 extended).
+static bool clinger_fast_path(uint64_t mantissa, int64_t exponent,
+                              double* out) {
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+  if (mantissa > MAX_EXACT_MANTISSA) {
+    return false;
+  }
+  if (exponent >= -22 && exponent <= 22) {
+    *out = exponent < 0 ? (double)mantissa / exact_pow10[-exponent]
+                        : (double)mantissa * exact_pow10[exponent];
+    return true;
+  }
+  // 12e30: move spare powers of ten into the mantissa while it stays exact.
+  if (exponent > 22 && exponent <= 22 + 15) {
+    uint64_t scale = (uint64_t)exact_pow10[exponent - 22];
+    if (mantissa <= MAX_EXACT_MANTISSA / scale) {
+      *out = (double)(mantissa * scale) * exact_pow10[22];
+      return true;
+    }
   }
+#else
+  (void)mantissa;
+  (void)exponent;
+  (void)out;
+#endif
+  return false;
+}
 
-  if (s->length > 0 && !s->string) {
-    result.status = CSTRING_ERR_INVALID_ARG;
-    return result;
+// 768 significant digits decide the rounding of any double; one extra
+// non-zero digit stands in for everything after them.
+#define DECIMAL_DIGITS_LIMIT 768
+#define EXPONENT_LIMIT 100000
+
+CStringStatus view_to_double(c_string_view v, double* out) {
+  if (!out || (!v.data && v.length)) {
+    return CSTRING_ERR_INVALID_ARG;
   }
 
-  size_t num_of_occurences = 0;
+  const char* p = v.data;
+  const char* end = v.data + v.length;
+  bool negative = false;
+  if (p < end && (*p == '+' || *p == '-')) {
+    negative = *p == '-';
+    p++;
+  }
 
-  // Count number of character occurences
-  for (size_t i = 0; i < s->length; i++) {
-    if (s->string[i] == c) {
-      num_of_occurences += 1;
-    }
+  size_t rest = (size_t)(end - p);
+  if (equals_ignore_case(p, rest, "inf") ||
+      equals_ignore_case(p, rest, "infinity")) {
+    *out = negative ? -HUGE_VAL : HUGE_VAL;
+    return CSTRING_OK;
   }
+  if (equals_ignore_case(p, rest, "nan")) {
+    *out = negative ? -NAN : NAN;
+    return CSTRING_OK;
+  }
+
+  const char* int_part = p;
+  size_t int_digits = count_digits(p, rest);
+  p += int_digits;
 
-  // If the input string does not contain the target character, return a copy of
-  // the input string.
-  if (num_of_occurences == 0) {
-    return string_new(s);
+  const char* frac_part = p;
+  size_t frac_digits = 0;
+  if (p < end && *p == '.') {
+    frac_part = ++p;
+    frac_digits = count_digits(p, (size_t)(end - p));
+    p += frac_digits;
+  }
+  if (int_digits + frac_digits == 0) {
+    return CSTRING_ERR_INVALID_ARG;
   }
 
-  // If the input string is the target character itself, return an empty buffer.
-  if (s->length == num_of_occurences) {
-    return initialize_buffer(0);
+  int64_t exponent = 0;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool exponent_negative = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+      exponent_negative = *p == '-';
+      p++;
+    }
+    size_t exponent_digits = count_digits(p, (size_t)(end - p));
+    if (exponent_digits == 0) {
+      return CSTRING_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < exponent_digits; i++) {
+      // Saturate; anything this large is zero or infinity anyway.
+      if (exponent < EXPONENT_LIMIT) {
+        exponent = exponent * 10 + (p[i] - '0');
+      }
+    }
+    p += exponent_digits;
+    if (exponent_negative) {
+      exponent = -exponent;
+    }
+  }
+  if (p != end) {
+    return CSTRING_ERR_INVALID_ARG;
   }
 
-  CStringResult buffer = initialize_buffer(s->length - num_of_occurences);
-  if (buffer.status != CSTRING_OK) {
-    return buffer;
+  // Significant digits are int_part ++ frac_part with leading and trailing
+  // zeros dropped; trailing zeros move into the exponent.
+  size_t total = int_digits + frac_digits;
+  size_t first = 0;
+  while (first < total &&
+         (first < int_digits ? int_part[first]
+                             : frac_part[first - int_digits]) == '0') {
+    first++;
+  }
+  if (first == total) {
+    *out = negative ? -0.0 : 0.0;
+    return CSTRING_OK;
+  }
+  size_t last = total - 1;
+  while ((last < int_digits ? int_part[last]
+                            : frac_part[last - int_digits]) == '0') {
+    last--;
   }
 
-  c_string* result_string = buffer.value;
+  size_t significant = last - first + 1;
+  int64_t scale = exponent - (int64_t)frac_digits + (int64_t)(total - 1 - last);
 
-  size_t last_location = 0;
-  size_t copy_position = 0;
-  for (size_t i = 0; i < s->length; i++) {
-    if (s->string[i] == c) {
-      if (i > last_location) {
-        memcpy(result_string->string + copy_position, s->string + last_location,
-               i - last_location);
-        copy_position += i - last_location;
-      }
+  double value = 0.0;
+  bool exact = false;
+  if (significant <= 19) {
+    uint64_t mantissa = 0;
+    if (first < int_digits) {
+      size_t int_end = last < int_digits ? last + 1 : int_digits;
+      mantissa = accumulate_digits(0, int_part + first, int_end - first);
+    }
+    if (last >= int_digits) {
+      size_t frac_begin = first > int_digits ? first - int_digits : 0;
+      mantissa = accumulate_digits(mantissa, frac_part + frac_begin,
+                                   last - int_digits + 1 - frac_begin);
+    }
+    exact = clinger_fast_path(mantissa, scale, &value);
+  }
 
-      // Increment last_location even if current index matches to avoid trailing
-      // copies.
-      last_location = i + 1;
+  if (!exact) {
+    // Rare slow path: hand strtod a canonical "digitsE exponent" form on the
+    // stack. Leaving out the decimal point keeps it locale-independent.
+    char buffer[DECIMAL_DIGITS_LIMIT + 1 + 1 + CSTRING_INT_BUFFER_SIZE];
+    size_t kept = significant > DECIMAL_DIGITS_LIMIT ? DECIMAL_DIGITS_LIMIT
+                                                     : significant;
+    size_t length = 0;
+    for (size_t k = first; k < first + kept; k++) {
+      buffer[length++] =
+          k < int_digits ? int_part[k] : frac_part[k - int_digits];
+    }
+    if (kept < significant) {
+      // The dropped digits end in a non-zero one, so they are never all zero.
+      buffer[length++] = '1';
+      scale += (int64_t)(significant - kept - 1);
     }
+    if (scale > EXPONENT_LIMIT) {
+      scale = EXPONENT_LIMIT;
+    } else if (scale < -EXPONENT_LIMIT) {
+      scale = -EXPONENT_LIMIT;
+    }
+    buffer[length++] = 'e';
+    format_int64(scale, buffer + length);
+    value = strtod(buffer, NULL);
   }
 
-  if (last_location < s->length) {
-    memcpy(result_string->string + copy_position, s->string + last_location,
-           s->length - last_location);
+  if (value > DBL_MAX) {
+    return CSTRING_ERR_OVERFLOW;
   }
+  *out = negative ? -value : value;
+  return CSTRING_OK;
+}
 
-  result.value = result_string;
-  return result;
+CStringStatus string_to_int(const c_string* s, int* out) {
+  if (!s || !out) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+
+  int64_t value = 0;
+  CStringStatus status = view_to_int64(string_view(s), &value);
+  if (status != CSTRING_OK) {
+    return status;
+  }
+  if (value < INT_MIN || value > INT_MAX) {
+    return CSTRING_ERR_OVERFLOW;
+  }
+
+  *out = (int)value;
+  return CSTRING_OK;
+}
+
+CStringStatus string_to_int64(const c_string* s, int64_t* out) {
+  if (!s) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  return view_to_int64(string_view(s), out);
+}
+
+CStringStatus string_to_uint64(const c_string* s, uint64_t* out) {
+  if (!s) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  return view_to_uint64(string_view(s), out);
+}
+
+CStringStatus string_to_double(const c_string* s, double* out) {
+  if (!s) {
+    return CSTRING_ERR_INVALID_ARG;
+  }
+  return view_to_double(string_view(s), out);
 }
 
 CStringResult string_from_printf(const char* fmt, ...) {
   CStringResult result = {.value = NULL, .status = CSTRING_OK};
 
-  va_list args;
-  va_start(args, fmt);
-  int length = vsnprintf(NULL, 0, fmt, args);
-  va_end(args);
-
-  // Malformed format strings, encoding errors or other problems can make
-  // vsnprintf return a negative value instead of a byte count.
-  if (length < 0) {
-    result.status = CSTRING_ERR_INTERNAL;
+  c_string_builder builder;
+  result.status = builder_init(&builder, 32);
+  if (result.status != CSTRING_OK) {
     return result;
   }
 
-  size_t buf_size = (size_t)(length + 1);
-  char* buf = malloc(buf_size);
-
+  va_list args;
   va_start(args, fmt);
-  int written = vsnprintf(buf, buf_size, fmt, args);
+  result.status = builder_append_vprintf(&builder, fmt, args);
   va_end(args);
 
-  // Live state (locale changes, shared buffers) can diverge between the probe
-  // and this write, so bail out if the second pass fails or needs more space.
-  if (written < 0 || written > length) {
-    free(buf);
-    result.status = CSTRING_ERR_INTERNAL;
+  if (result.status != CSTRING_OK) {
+    builder_destroy(&builder);
     return result;
   }
 
-  CStringResult wrapped = string_from_char(buf, length);
-  free(buf);
-  return wrapped;
+  return builder_finish(&builder);
 }
 
-CStringResult int_to_string(int x) { return string_from_printf("%d", x); }
+CStringResult int_to_string(int x) { return int_to_string_in(NULL, x); }
+
+CStringResult int_to_string_in(c_string_arena* arena, int x) {
+  char buffer[CSTRING_INT_BUFFER_SIZE];
+  return string_from_ascii_in(arena, buffer, format_int64(x, buffer));
+}
 
 CStringResult double_to_string(double x) { return string_from_printf("%g", x); }
 
+CStringResult double_to_string_shortest(double x) {
+  return double_to_string_shortest_in(NULL, x);
+}
+
+CStringResult double_to_string_shortest_in(c_string_arena* arena, double x) {
+  char buffer[CSTRING_DOUBLE_BUFFER_SIZE];
+  return string_from_ascii_in(arena, buffer, format_double(x, buffer));
+}
+
 const char* cstring_status_str(CStringStatus status) {
   switch (status) {
     case CSTRING_OK:
@@ -1,17 +1,75 @@
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Lets GCC and Clang check printf-style arguments against the format string
+#if defined(__GNUC__)
+#define CSTRING_PRINTF_FORMAT(fmt_index, args_index) \
+  __attribute__((format(printf, fmt_index, args_index)))
+#else
+#define CSTRING_PRINTF_FORMAT(fmt_index, args_index)
+#endif
+
 /* String Struct Definition */
 
+// Where a c_string's header and payload were allocated. Heap strings are
+// released by destroy_string, arena strings by arena_reset/arena_destroy.
+// Inline strings are heap headers whose payload lives in `local.inline_data`,
+// so they cost a single allocation. Borrowed headers (delimiter tokens) point
+// into bytes owned by another string and are never destroyed. Mapped strings
+// point into a private file mapping that destroy_string unmaps.
+typedef enum {
+  CSTRING_STORAGE_HEAP = 0,
+  CSTRING_STORAGE_ARENA,
+  CSTRING_STORAGE_INLINE,
+  CSTRING_STORAGE_BORROWED,
+  CSTRING_STORAGE_MAPPED,
+} CStringStorage;
+
+// Heap payloads up to this many bytes are stored inside the header, which then
+// fills exactly one 64-byte cache line on 64-bit targets.
+#define CSTRING_INLINE_CAPACITY 24
+
+// Sparse code point -> byte offset table, built on demand by
+// sub_string_codepoint
+typedef struct c_string_codepoint_index c_string_codepoint_index;
+
 typedef struct {
-  char* string;
+  char* string;             // payload; use string_data() to read it
   size_t length;            // number of bytes stored in `string`
+  size_t capacity;          // bytes allocated for `string` (>= length)
   size_t codepoint_length;  // number of UTF-8 code points represented
   bool utf8_valid;          // true when `string` contains valid UTF-8 data
+  unsigned char storage;    // CStringStorage; zero (heap) for calloc'd strings
+  bool codepoint_index_stale;  // set by create_string: drop before use
+  // Inline strings keep their payload here. Longer strings never need it, so
+  // they reuse the space for their code point index (NULL until built).
+  union {
+    char inline_data[CSTRING_INLINE_CAPACITY];
+    c_string_codepoint_index* codepoint_index;
+  } local;
 } c_string;
 
+// Non-owning window into UTF-8 bytes that live somewhere else (a c_string, a
+// literal, a file buffer). Views never allocate and must not outlive the bytes
+// they point at.
+typedef struct {
+  const char* data;
+  size_t length;            // number of bytes in the view
+  size_t codepoint_length;  // number of UTF-8 code points represented
+  bool utf8_valid;          // true when `data` contains valid UTF-8 data
+} c_string_view;
+
+// Which ends view_strip_bytes and view_strip_whitespace trim
+typedef enum {
+  CSTRING_STRIP_LEFT = 1,
+  CSTRING_STRIP_RIGHT = 2,
+  CSTRING_STRIP_BOTH = 3,
+} CStringStripSide;
+
 typedef enum {
   CSTRING_OK = 0,
   CSTRING_ERR_NO_MEMORY,
@@ -27,38 +85,189 @@ typedef struct {
   CStringStatus status;
 } CStringResult;
 
+// Returned by the search functions when there is no match
+#define CSTRING_NPOS ((size_t)-1)
+
+// Needle compiled once by needle_compile and reusable across any number of
+// haystacks. The needle borrows `bytes`, which must outlive it.
+typedef struct {
+  const char* bytes;
+  size_t length;
+  unsigned char algorithm;    // search strategy picked by needle_compile
+  unsigned char shift[256];   // Horspool bad-character shifts (long needles)
+} c_string_needle;
+
+// Set of patterns compiled by multi_needle_compile into one automaton, so a
+// haystack is scanned once whatever the number of patterns. Opaque; it keeps
+// no pointers to the patterns.
+typedef struct c_string_multi_needle c_string_multi_needle;
+
+// Lazily walks the same tokens string_delim returns, one per call, without
+// counting matches up front or allocating. Tokens point into `source`.
+typedef struct {
+  c_string_view source;
+  c_string_needle delim;
+  size_t position;   // byte offset where the next token starts
+  bool finished;     // set once the final token has been handed out
+  bool known_valid;  // tokens are valid UTF-8 without rescanning
+} c_string_delim_iter;
+
+// One token of a c_string_split: `length` bytes starting `offset` bytes into
+// the split's `data`
+typedef struct {
+  size_t offset;
+  size_t length;
+} c_string_span;
+
+// Every token of a split as (offset, length) pairs into one buffer instead of
+// a c_string per token. The spans and, for string_split, a copy of the source
+// bytes share a single allocation that split_destroy releases.
+typedef struct {
+  const char* data;      // bytes the spans point into
+  c_string_span* spans;  // `count` tokens in input order
+  size_t count;
+  bool known_valid;      // tokens are valid UTF-8 without rescanning
+  bool ascii;            // every token has as many code points as bytes
+} c_string_split;
+
+// Open-addressing hash map from string keys to caller-owned values. Slots are
+// probed sixteen at a time through one control byte each (Swiss table), and
+// each entry keeps its key's hash so growing never rehashes the bytes.
+typedef struct {
+  c_string* key;  // the map's own copy of the key
+  void* value;
+  uint64_t hash;
+} c_string_map_entry;
+
+typedef struct {
+  c_string_map_entry* entries;  // `capacity` slots
+  signed char* control;         // per slot: empty, deleted or 7 hash bits
+  size_t capacity;              // 0 or a power of two, at least 16
+  size_t count;                 // live entries
+  size_t deleted;               // tombstones left by string_map_remove
+  uint64_t seed;
+} c_string_map;
+
+// Appends into the spare capacity of a c_string and hands that same string
+// over on builder_finish, so the finished value is never copied.
+typedef struct {
+  c_string* string;  // string under construction; NULL once finished
+} c_string_builder;
+
+// Buffered line reader over a FILE* or file descriptor. Lines are handed out
+// as views into the reader's buffer, so reading does not allocate per line.
+typedef struct {
+  FILE* file;            // source when reading through stdio, otherwise NULL
+  int fd;                // source when `file` is NULL
+  char* buffer;          // holds the current line and read-ahead bytes
+  size_t capacity;       // size of `buffer`; grows for lines that do not fit
+  size_t start;          // first byte not yet handed out
+  size_t end;            // one past the last byte read
+  size_t line_number;    // number of lines returned so far
+  bool eof;              // the source reported end of input
+  CStringStatus status;  // CSTRING_ERR_IO once a read failed
+} c_string_reader;
+
+/* Arena Allocator */
+
+typedef struct c_string_arena_block c_string_arena_block;
+
+// Bump allocator that places a c_string header and its payload in a single
+// allocation. Strings created through the `_in` constructors stay valid until
+// the arena is reset or destroyed.
+typedef struct {
+  c_string_arena_block* head;     // first block, kept across resets
+  c_string_arena_block* current;  // block new allocations are carved from
+  size_t block_size;              // default size of each new block in bytes
+} c_string_arena;
+
+// Prepare an empty arena. A block_size of 0 selects a 64 KiB default. No memory
+// is allocated until the first string is created.
+CStringStatus arena_init(c_string_arena* arena, size_t block_size);
+
+// Return `size` bytes of 16-byte aligned memory, or NULL when out of memory
+void* arena_alloc(c_string_arena* arena, size_t size);
+
+// Invalidate every allocation in O(1) while keeping the blocks for reuse
+void arena_reset(c_string_arena* arena);
+
+// Release every block owned by the arena
+void arena_destroy(c_string_arena* arena);
+
+// Payload bytes of `s`. Inline strings keep `string` pointed at their own
+// `local.inline_data`, which goes stale if the header is copied by value, so
+// prefer this accessor over reading the field.
+char* string_data(const c_string* s);
+
 // Create string from an input
 void create_string(c_string* s, size_t length, char* input);
 
 // Initialize string buffer
 CStringResult initialize_buffer(size_t length);
 
-// Copy contents of a c_string into a new one ("Copy Constructor")
+// Copy contents of a c_string into a new one ("Copy Constructor"). The UTF-8
+// metadata of a valid source is reused instead of rescanning the copy.
 CStringResult string_new(const c_string* s);
 
 CStringResult string_from_char(const char* s, const int length);
 
-// Start and End are inclusive bounds
+// Map the file at `path` instead of copying it. The mapping is private, so
+// edits never reach the file; growing the string moves it to the heap. Fails
+// with CSTRING_ERR_IO when the file cannot be opened or mapped (pipes, for
+// instance) and CSTRING_ERR_INVALID_UTF8 when its contents are not UTF-8.
+CStringResult string_from_file_mmap(const char* path);
+
+// Start and End are inclusive bounds. For valid input only the two ends are
+// checked for splitting a sequence, and the code points are counted, not
+// decoded.
 CStringResult sub_string_checked(c_string* s, size_t start, size_t end);
 
 // Start and End are inclusive bounds
 CStringResult sub_string_codepoint(c_string* s, size_t start, size_t end);
 
+// Arena-backed constructors. They behave like their heap counterparts but
+// bump-allocate the header and payload together from `arena`; passing a NULL
+// arena falls back to the heap.
+CStringResult initialize_buffer_in(c_string_arena* arena, size_t length);
+
+CStringResult string_new_in(c_string_arena* arena, const c_string* s);
+
+CStringResult string_from_char_in(c_string_arena* arena, const char* s,
+                                  const int length);
+
+CStringResult sub_string_checked_in(c_string_arena* arena, c_string* s,
+                                    size_t start, size_t end);
+
+CStringResult sub_string_codepoint_in(c_string_arena* arena, c_string* s,
+                                      size_t start, size_t end);
+
 // Return string inside c_string with a null-terminator in case an external
 // function requires it
 char* get_null_terminated_string(c_string* s);
 
-/* Free the string's content and the string itself */
+/* Free the string's content and the string itself. Arena strings are left
+   alone; they are reclaimed by arena_reset or arena_destroy. */
 void destroy_string(c_string* input);
 
 /* Help function used to free the memory used by the c_string** in string_delim
  */
 void destroy_delim_string(c_string** s);
 
-/* Concatenate input into string s */
-void string_concat(c_string* s, const char* input);
+/* Concatenate input into string s. The buffer grows geometrically and only
+   the appended bytes are checked to keep the UTF-8 metadata current. */
+CStringStatus string_concat(c_string* s, const char* input);
 
-void string_modify(c_string* s, const char* input);
+// Append `length` raw bytes to s, like string_concat
+CStringStatus string_append(c_string* s, const char* bytes, size_t length);
+
+// Replace the contents of s with input, reusing the existing capacity
+CStringStatus string_modify(c_string* s, const char* input);
+
+// Make sure s can hold at least `capacity` bytes without reallocating
+CStringStatus string_reserve(c_string* s, size_t capacity);
+
+// Release any capacity beyond the current length (no-op for arena strings)
+CStringStatus string_shrink_to_fit(c_string* s);
 
 /* Check if two strings are equal.
    Longer string is considered greater.
@@ -67,6 +276,266 @@ void string_modify(c_string* s, const char* input);
    Return < 0 if second is greater than first. */
 int string_compare(const c_string* first, const c_string* second);
 
+// Lexicographic byte order (which is code point order for UTF-8), usable for
+// sorting and range lookups; a proper prefix sorts first. memcmp-style result.
+int string_compare_lex(const c_string* first, const c_string* second);
+
+// Equality that rejects on length, code point count and last byte before
+// comparing the bytes
+bool string_equals(const c_string* first, const c_string* second);
+
+// Lexicographic order with ASCII letters folded to lowercase; other bytes
+// compare as they are. Runs 16-32 bytes at a time.
+int string_compare_ignore_case(const c_string* first, const c_string* second);
+
+bool string_equals_ignore_case(const c_string* first, const c_string* second);
+
+bool string_starts_with(const c_string* s, const char* prefix);
+
+bool string_ends_with(const c_string* s, const char* suffix);
+
+/* String View Functions */
+
+// View over the whole contents of `s`, sharing its UTF-8 metadata
+c_string_view string_view(const c_string* s);
+
+// Wrap `length` bytes of `s` without copying them. Fails with
+// CSTRING_ERR_INVALID_UTF8 when the bytes are not valid UTF-8.
+CStringStatus view_from_char(const char* s, size_t length, c_string_view* out);
+
+// Copy a view into a newly allocated c_string
+CStringResult string_from_view(c_string_view v);
+
+CStringResult string_from_view_in(c_string_arena* arena, c_string_view v);
+
+// Start and End are inclusive byte bounds, as in sub_string_checked
+CStringStatus view_sub_string_checked(c_string_view s, size_t start,
+                                      size_t end, c_string_view* out);
+
+// Start and End are inclusive code point bounds, as in sub_string_codepoint
+CStringStatus view_sub_string_codepoint(c_string_view s, size_t start,
+                                        size_t end, c_string_view* out);
+
+// Split `s` around the first occurrence of `delim`. Returns false (with
+// `before` set to `s` and `after` empty) when the delimiter does not occur.
+bool view_split_once(c_string_view s, const char* delim, c_string_view* before,
+                     c_string_view* after);
+
+// Drop every leading and trailing `c` byte
+c_string_view view_strip_char(c_string_view s, const char c);
+
+// Drop the leading and/or trailing bytes that occur in the null-terminated
+// `set`. Like every view function it returns a window into `s` and never
+// allocates.
+c_string_view view_strip_bytes(c_string_view s, const char* set,
+                               CStringStripSide side);
+
+// Drop leading and/or trailing Unicode White_Space code points: ASCII
+// whitespace, U+0085, U+00A0, U+1680, U+2000-U+200A, U+2028, U+2029, U+202F,
+// U+205F and U+3000.
+c_string_view view_strip_whitespace(c_string_view s, CStringStripSide side);
+
+// Same ordering as string_compare: longer views are greater
+int view_compare(c_string_view first, c_string_view second);
+
+int view_compare_lex(c_string_view first, c_string_view second);
+
+bool view_equals(c_string_view first, c_string_view second);
+
+int view_compare_ignore_case(c_string_view first, c_string_view second);
+
+bool view_equals_ignore_case(c_string_view first, c_string_view second);
+
+bool view_starts_with(c_string_view s, const char* prefix);
+
+bool view_ends_with(c_string_view s, const char* suffix);
+
+/* Hashing */
+
+// Seeded 64-bit hash of `length` bytes (wyhash). Equal bytes hash equally
+// whatever they are stored in. The values are stable within a process but not
+// a portable format.
+uint64_t cstring_hash(const void* data, size_t length, uint64_t seed);
+
+uint64_t string_hash(const c_string* s, uint64_t seed);
+
+uint64_t view_hash(c_string_view v, uint64_t seed);
+
+/* Hash Map */
+
+// Prepare an empty map with room for `initial_capacity` entries before it
+// grows. Nothing is allocated until the first insertion.
+CStringStatus string_map_init(c_string_map* m, size_t initial_capacity);
+
+// Free the map's keys and tables. Values belong to the caller.
+void string_map_destroy(c_string_map* m);
+
+// Insert `key` or replace its value. The key bytes are copied and need not be
+// valid UTF-8; the stored key's utf8_valid tells which.
+CStringStatus string_map_put(c_string_map* m, c_string_view key, void* value);
+
+// Look up `key` without allocating. Returns false when it is absent.
+bool string_map_get(const c_string_map* m, c_string_view key, void** value);
+
+// Remove `key`, handing back its value. Returns false when it is absent.
+bool string_map_remove(c_string_map* m, c_string_view key, void** value);
+
+// Step through the entries in no particular order. Start with *cursor = 0;
+// the map must not be modified during the walk.
+bool string_map_next(const c_string_map* m, size_t* cursor,
+                     const c_string** key, void** value);
+
+/* String Interning */
+
+// Canonical copies of repeated strings. Interning equal bytes always returns
+// the same immutable c_string, so interned strings compare equal exactly when
+// their pointers do. The strings live in the pool's arena until the pool is
+// destroyed.
+typedef struct {
+  c_string_map table;     // canonical strings, keyed by themselves
+  c_string_arena arena;   // holds every canonical string
+  size_t hits;            // lookups answered by an existing string
+  size_t misses;          // lookups that added a new string
+  size_t string_bytes;    // payload bytes of the distinct strings
+} c_string_intern_pool;
+
+typedef struct {
+  size_t strings;       // distinct strings held
+  size_t hits;
+  size_t misses;
+  size_t string_bytes;
+  size_t memory_bytes;  // arena blocks plus hash table
+} c_string_intern_stats;
+
+typedef struct c_string_intern_stripe c_string_intern_stripe;
+
+// Thread-safe interning. Strings are spread by hash over independent pools,
+// each behind its own lock, so threads interning different strings rarely
+// wait for each other.
+typedef struct {
+  c_string_intern_stripe* stripes;
+  size_t stripe_count;  // power of two
+} c_string_shared_intern_pool;
+
+CStringStatus intern_pool_init(c_string_intern_pool* pool);
+
+// Release every interned string at once
+void intern_pool_destroy(c_string_intern_pool* pool);
+
+// Canonical string holding the bytes of `v`, created on first sight. Fails
+// with CSTRING_ERR_INVALID_UTF8 for bytes string_from_char would reject.
+CStringStatus intern_pool_get(c_string_intern_pool* pool, c_string_view v,
+                              const c_string** out);
+
+void intern_pool_stats(const c_string_intern_pool* pool,
+                       c_string_intern_stats* stats);
+
+// `stripe_count` is rounded up to a power of two; 0 selects 16. Builds
+// without threads have no locks.
+CStringStatus shared_intern_pool_init(c_string_shared_intern_pool* pool,
+                                      size_t stripe_count);
+
+void shared_intern_pool_destroy(c_string_shared_intern_pool* pool);
+
+// Safe to call from several threads at once
+CStringStatus shared_intern_pool_get(c_string_shared_intern_pool* pool,
+                                     c_string_view v, const c_string** out);
+
+// Totals over every stripe
+void shared_intern_pool_stats(const c_string_shared_intern_pool* pool,
+                              c_string_intern_stats* stats);
+
+/* String Builder */
+
+// Start an empty builder with room for `initial_capacity` bytes
+CStringStatus builder_init(c_string_builder* b, size_t initial_capacity);
+
+// Same as builder_init, but the finished string lives in `arena`
+CStringStatus builder_init_in(c_string_builder* b, c_string_arena* arena,
+                              size_t initial_capacity);
+
+CStringStatus builder_append_bytes(c_string_builder* b, const char* bytes,
+                                   size_t length);
+
+CStringStatus builder_append_cstr(c_string_builder* b, const char* input);
+
+CStringStatus builder_append_char(c_string_builder* b, const char c);
+
+// Format straight into the spare capacity; the buffer is only grown, and the
+// format run a second time, when the output does not fit.
+CStringStatus builder_append_printf(c_string_builder* b, const char* fmt, ...)
+    CSTRING_PRINTF_FORMAT(2, 3);
+
+CStringStatus builder_append_vprintf(c_string_builder* b, const char* fmt,
+                                     va_list args) CSTRING_PRINTF_FORMAT(2, 0);
+
+// Hand the built string to the caller without copying and leave the builder
+// empty. The caller owns the result.
+CStringResult builder_finish(c_string_builder* b);
+
+// Free an unfinished builder's contents
+void builder_destroy(c_string_builder* b);
+
+/* Ropes */
+
+// Text kept as a balanced tree of short c_string leaves, so edits in the
+// middle of a large document copy O(log n) nodes and at most a leaf or two of
+// bytes instead of the whole buffer. Every node caches its byte and code point
+// counts, and positions are code point indices. Trees are immutable and
+// reference counted: slices and concatenations share nodes with their
+// sources. The counts are not atomic, so ropes that share nodes must not be
+// edited or destroyed from different threads at once.
+typedef struct c_string_rope_node c_string_rope_node;
+
+typedef struct {
+  c_string_rope_node* root;  // NULL for the empty rope
+} c_string_rope;
+
+// Deeper than any rope that fits in memory can grow
+#define CSTRING_ROPE_MAX_HEIGHT 96
+
+// Walks a rope's leaves in order. The rope must not change while it is in
+// use.
+typedef struct {
+  const c_string_rope_node* stack[CSTRING_ROPE_MAX_HEIGHT];
+  size_t depth;
+} c_string_rope_iter;
+
+// Start an empty rope
+void rope_init(c_string_rope* r);
+
+// New rope holding a copy of `v`, which must be valid UTF-8
+CStringStatus rope_from_view(c_string_view v, c_string_rope* out);
+
+void rope_destroy(c_string_rope* r);
+
+size_t rope_length(const c_string_rope* r);
+
+size_t rope_codepoint_length(const c_string_rope* r);
+
+// Insert a copy of `text` before code point `index`; `index` may equal the
+// rope's code point length to append.
+CStringStatus rope_insert(c_string_rope* r, size_t index, c_string_view text);
+
+// Remove `count` code points starting at code point `start`
+CStringStatus rope_delete(c_string_rope* r, size_t start, size_t count);
+
+// Append `tail`, sharing its nodes; `tail` itself is left unchanged
+CStringStatus rope_concat(c_string_rope* r, const c_string_rope* tail);
+
+// `count` code points of `r` from `start` as a new rope in `out`, which shares
+// nodes with `r` and is released with rope_destroy.
+CStringStatus rope_slice(const c_string_rope* r, size_t start, size_t count,
+                         c_string_rope* out);
+
+// Copy the whole rope into one contiguous string
+CStringResult rope_flatten(const c_string_rope* r);
+
+void rope_iter_init(c_string_rope_iter* it, const c_string_rope* r);
+
+// Hand out the next leaf's bytes as a view; false once every leaf was seen
+bool rope_iter_next(c_string_rope_iter* it, c_string_view* chunk);
+
 /* Printing Functions */
 
 void print(const c_string* s);
@@ -81,20 +550,289 @@ void print_utf8_info(const c_string* s);
 
 size_t get_delim_string_length(c_string** s);
 
-// Read stdin input into c_string
-void scan_string(c_string* s, const char* prompt);
+// Print `prompt` (when not NULL) and read one line from stdin into `s`,
+// reusing its capacity. The line terminator is not stored. Returns
+// CSTRING_ERR_IO on end of input or read failure and CSTRING_ERR_INVALID_UTF8
+// when the line is not valid UTF-8 (the bytes are kept).
+CStringStatus scan_string(c_string* s, const char* prompt);
+
+/* Line Reader */
+
+// Read from a file descriptor with read(), or from a FILE* with fread() so
+// bytes stdio has already buffered are not skipped. `buffer_size` is the
+// initial buffer size; 0 selects the 64 KiB default.
+CStringStatus reader_init_fd(c_string_reader* r, int fd, size_t buffer_size);
+
+CStringStatus reader_init_file(c_string_reader* r, FILE* file,
+                               size_t buffer_size);
+
+// Produce the next line without its "\n" or "\r\n" terminator. The view points
+// into the reader's buffer and stays valid until the next call; its UTF-8
+// metadata is computed once per line. Returns false at end of input or when a
+// read fails, in which case `r->status` is CSTRING_ERR_IO.
+bool reader_next_line(c_string_reader* r, c_string_view* line);
+
+// Like reader_next_line, but copies the line into `line`, reusing its
+// capacity so a loop stops allocating once the longest line fits.
+bool reader_next_line_string(c_string_reader* r, c_string* line);
+
+// Release the buffer. The FILE* or descriptor is left open.
+void reader_destroy(c_string_reader* r);
 
 /* String Transformation Functions */
 
 // Split string according to given delimiter
 c_string** string_delim(const c_string* s, const char* delim);
 
+// Byte offsets of every non-overlapping match of `delim`, scanning left to
+// right, in a malloc'd array the caller frees with free(). Inputs above the
+// parallel threshold are searched on several threads; the offsets come back in
+// input order either way. An empty delimiter never matches.
+CStringStatus string_delim_offsets(const c_string* s, const char* delim,
+                                   size_t** offsets, size_t* count);
+
+CStringStatus view_delim_offsets(c_string_view v, const char* delim,
+                                 size_t** offsets, size_t* count);
+
+// Split like string_delim, but into a c_string_split holding its own copy of
+// the bytes, so `s` may be freed afterwards. Tokens of a valid source are
+// never revalidated.
+CStringStatus string_split(const c_string* s, const char* delim,
+                           c_string_split* out);
+
+// Like string_split, but the spans borrow `v`'s bytes, which must outlive the
+// result.
+CStringStatus view_split(c_string_view v, const char* delim,
+                         c_string_split* out);
+
+// Split around every match of any of `delims`, taking matches left to right
+// as string_find_any reports them
+c_string** string_delim_any(const c_string* s,
+                            const c_string_multi_needle* delims);
+
+CStringStatus string_split_any(const c_string* s,
+                               const c_string_multi_needle* needles,
+                               c_string_split* out);
+
+CStringStatus view_split_any(c_string_view v,
+                             const c_string_multi_needle* needles,
+                             c_string_split* out);
+
+// View over token `index` (< split->count)
+c_string_view split_get(const c_string_split* split, size_t index);
+
+void split_destroy(c_string_split* split);
+
+/* Substring Search */
+
+// Prepare `length` bytes for repeated searching. Single bytes use memchr,
+// short needles a vectorized first/last byte filter and long needles
+// Boyer-Moore-Horspool. An empty needle never matches.
+CStringStatus needle_compile(c_string_needle* needle, const char* bytes,
+                             size_t length);
+
+// Byte offset of the first match at or after `from`, or CSTRING_NPOS
+size_t string_find(const c_string* haystack, const c_string_needle* needle,
+                   size_t from);
+
+size_t view_find(c_string_view haystack, const c_string_needle* needle,
+                 size_t from);
+
+// Record the offsets of non-overlapping matches, scanning left to right, in
+// `positions` (up to `max_positions` of them). Returns the total number of
+// matches, so a first call with max_positions = 0 sizes the array.
+size_t string_find_all(const c_string* haystack, const c_string_needle* needle,
+                       size_t* positions, size_t max_positions);
+
+// Compile `count` null-terminated patterns into an Aho-Corasick automaton.
+// Empty patterns never match. When every pattern is a single byte the search
+// is a vectorized byte-set scan instead.
+CStringStatus multi_needle_compile(const char* const* patterns, size_t count,
+                                   c_string_multi_needle** out);
+
+void multi_needle_destroy(c_string_multi_needle* needles);
+
+// Byte offset of the leftmost match of any pattern at or after `from`, or
+// CSTRING_NPOS. Of the matches starting there the longest wins, and its index
+// in the compiled list is stored in `pattern` when that is not NULL.
+size_t string_find_any(const c_string* haystack,
+                       const c_string_multi_needle* needles, size_t from,
+                       size_t* pattern);
+
+size_t view_find_any(c_string_view haystack,
+                     const c_string_multi_needle* needles, size_t from,
+                     size_t* pattern);
+
+// Prepare `it` to walk `s` split by `delim`. Neither may be freed or modified
+// while the iterator is in use.
+void delim_iter_init(c_string_delim_iter* it, const c_string* s,
+                     const char* delim);
+
+// Store the next token in `token` and return true, or return false once every
+// token has been produced.
+bool delim_iter_next(c_string_delim_iter* it, c_string_view* token);
+
+// Like delim_iter_next, but fills a caller-provided c_string header whose
+// `string` borrows the source bytes. The token must not be passed to
+// destroy_string or mutated.
+bool delim_iter_next_string(c_string_delim_iter* it, c_string* token);
+
+// Restart the iteration from the first token
+void delim_iter_reset(c_string_delim_iter* it);
+
+// Copy `s` without any `c` byte, in one pass that compacts 16-32 bytes at a
+// time
 CStringResult trim_char(const c_string* s, const char c);
 
+// Unicode-aware case conversion using the simple (one code point to one code
+// point) mappings from UnicodeData.txt; bytes that are not valid UTF-8 are
+// copied through unchanged. ASCII runs are converted 16-32 bytes at a time.
 CStringResult to_lower(const c_string* s);
 
+CStringResult to_lower_in(c_string_arena* arena, const c_string* s);
+
+CStringResult to_upper(const c_string* s);
+
+CStringResult to_upper_in(c_string_arena* arena, const c_string* s);
+
+// Convert in place. No allocation happens unless a mapping changes the byte
+// length (e.g. U+023A -> U+2C65), in which case the tail is re-encoded.
+CStringStatus to_lower_in_place(c_string* s);
+
+CStringStatus to_upper_in_place(c_string* s);
+
+// Format into a new c_string; built on c_string_builder so the output is
+// written and validated once
+CStringResult string_from_printf(const char* fmt, ...)
+    CSTRING_PRINTF_FORMAT(1, 2);
+
 CStringResult int_to_string(int x);
 
+CStringResult int_to_string_in(c_string_arena* arena, int x);
+
+// Formats with "%g", i.e. six significant digits
 CStringResult double_to_string(double x);
 
+// Shortest digits that read back to exactly `x` (see format_double)
+CStringResult double_to_string_shortest(double x);
+
+CStringResult double_to_string_shortest_in(c_string_arena* arena, double x);
+
+/* Regular Expressions */
+
+// Compiled pattern. Supports literals, `.`, classes such as [a-zé] and [^0-9],
+// \d \w \s and their negations, ^ and $ (start and end of the text), groups,
+// alternation, and the greedy or lazy repeats * + ? {n} {n,} {n,m}. Classes
+// and `.` match whole UTF-8 code points. Matches are leftmost-first, as in
+// Perl, and searching takes time linear in the haystack: the pattern runs as
+// a DFA built lazily from a Thompson NFA, so there is no backtracking. Since
+// DFA states are cached inside the regex, one regex must not be used from
+// several threads at once.
+typedef struct c_string_regex c_string_regex;
+
+// Fails with CSTRING_ERR_INVALID_ARG on a syntax error and
+// CSTRING_ERR_OVERFLOW for patterns too large to compile (e.g. x{1000}{1000})
+CStringStatus regex_compile(const char* pattern, c_string_regex** out);
+
+void regex_destroy(c_string_regex* re);
+
+// Find the leftmost match starting at or after byte `from`. `match` receives
+// its byte offset and length and may be NULL.
+bool view_regex_find(c_string_regex* re, c_string_view haystack, size_t from,
+                     c_string_span* match);
+
+bool string_regex_find(c_string_regex* re, const c_string* haystack,
+                       size_t from, c_string_span* match);
+
+// Record successive non-overlapping matches in `matches` (up to
+// `max_matches`). Returns the total number of matches, as string_find_all.
+// After an empty match the search resumes one code point further on.
+size_t view_regex_find_all(c_string_regex* re, c_string_view haystack,
+                           c_string_span* matches, size_t max_matches);
+
+size_t string_regex_find_all(c_string_regex* re, const c_string* haystack,
+                             c_string_span* matches, size_t max_matches);
+
+// Split around every match. Like string_split, the string_ form copies the
+// source bytes into the split and the view_ form borrows them.
+CStringStatus string_regex_split(c_string_regex* re, const c_string* s,
+                                 c_string_split* out);
+
+CStringStatus view_regex_split(c_string_regex* re, c_string_view v,
+                               c_string_split* out);
+
+// Copy with every match replaced by the literal `replacement`
+CStringResult string_regex_replace(c_string_regex* re, const c_string* s,
+                                   const char* replacement);
+
+CStringResult view_regex_replace(c_string_regex* re, c_string_view v,
+                                 const char* replacement);
+
+/* Number Formatting */
+
+// Buffer sizes that fit any formatted value plus the null terminator
+#define CSTRING_INT_BUFFER_SIZE 21
+#define CSTRING_DOUBLE_BUFFER_SIZE 32
+
+// Write the decimal digits of `value` into `buffer` (null-terminated, output
+// identical to "%d"/"%" PRIu64) and return the number of characters written,
+// without going through printf.
+size_t format_int32(int32_t value, char* buffer);
+
+size_t format_int64(int64_t value, char* buffer);
+
+size_t format_uint64(uint64_t value, char* buffer);
+
+// Write the shortest decimal representation that strtod reads back as exactly
+// `value` (Grisu2). Plain notation is used for decimal exponents from -6 to
+// 21 and scientific notation ("1.5e+300") outside that range; NaN and
+// infinities print as "nan" and "inf". Returns the number of characters.
+size_t format_double(double value, char* buffer);
+
+CStringStatus builder_append_int64(c_string_builder* b, int64_t value);
+
+CStringStatus builder_append_uint64(c_string_builder* b, uint64_t value);
+
+CStringStatus builder_append_double(c_string_builder* b, double value);
+
+/* Number Parsing */
+
+// Parse the whole string as a decimal number without allocating or needing a
+// null terminator. Integers accept an optional sign and digits only; doubles
+// also accept a fraction, an exponent, "inf", "infinity" and "nan". Returns
+// CSTRING_ERR_INVALID_ARG on malformed input and CSTRING_ERR_OVERFLOW when the
+// value does not fit; `*out` is only written on success.
+CStringStatus string_to_int(const c_string* s, int* out);
+
+CStringStatus string_to_int64(const c_string* s, int64_t* out);
+
+CStringStatus string_to_uint64(const c_string* s, uint64_t* out);
+
+CStringStatus string_to_double(const c_string* s, double* out);
+
+CStringStatus view_to_int64(c_string_view v, int64_t* out);
+
+CStringStatus view_to_uint64(c_string_view v, uint64_t* out);
+
+CStringStatus view_to_double(c_string_view v, double* out);
+
 const char* cstring_status_str(CStringStatus status);
+
+// Enable or disable the SSE2/AVX2 code paths (enabled by default). Results are
+// identical either way; disabling is meant for benchmarking and testing.
+void cstring_set_simd_enabled(bool enabled);
+
+// Validate `length` bytes and count their code points. Returns
+// CSTRING_ERR_INVALID_UTF8 on malformed input and, if `error_offset` is not
+// NULL, stores the byte offset of the first bad sequence there.
+CStringStatus cstring_validate_utf8(const char* data, size_t length,
+                                    size_t* codepoints, size_t* error_offset);
+
+// Buffers of at least `bytes` (default 8 MiB) are validated and split in
+// chunks on several threads. The result is the same as the single-threaded
+// pass.
+void cstring_set_parallel_threshold(size_t bytes);
+
+// Upper bound on scanning threads, caller included. 0 (the default) uses
+// one per online CPU and 1 disables threading.
+void cstring_set_thread_count(size_t threads);
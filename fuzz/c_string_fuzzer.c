@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "c_string.h"
@@ -33,11 +34,35 @@ static size_t read_input_file(const char* path, uint8_t* buffer,
   return bytes_read;
 }
 
+// The vectorized UTF-8 validator must agree with the scalar one on every
+// input; abort so afl++ records any disagreement as a crash.
+static void check_simd_matches_scalar(const uint8_t* data, size_t size) {
+  cstring_set_simd_enabled(false);
+  CStringResult scalar = string_from_char((const char*)data, (int)size);
+  cstring_set_simd_enabled(true);
+  CStringResult simd = string_from_char((const char*)data, (int)size);
+
+  if (scalar.status != simd.status ||
+      (scalar.value &&
+       scalar.value->codepoint_length != simd.value->codepoint_length)) {
+    abort();
+  }
+
+  if (scalar.value) {
+    destroy_string(scalar.value);
+  }
+  if (simd.value) {
+    destroy_string(simd.value);
+  }
+}
+
 static void exercise_library(const uint8_t* data, size_t size) {
   if (!data || size > (size_t)INT_MAX) {
     return;
   }
 
+  check_simd_matches_scalar(data, size);
+
   CStringResult base = string_from_char((const char*)data, (int)size);
   if (base.status != CSTRING_OK || !base.value) {
     return;
@@ -80,10 +105,47 @@ static void exercise_library(const uint8_t* data, size_t size) {
 
     c_string** split = string_delim(input, delim_buf);
     if (split) {
+      // The lazy iterator must yield exactly the tokens string_delim built.
+      c_string_delim_iter it;
+      c_string_view token;
+      size_t index = 0;
+      delim_iter_init(&it, input, delim_buf);
+      while (delim_iter_next(&it, &token)) {
+        if (!split[index] || split[index]->length != token.length ||
+            (token.length > 0 &&
+             memcmp(split[index]->string, token.data, token.length) != 0)) {
+          abort();
+        }
+        index += 1;
+      }
+      if (split[index]) {
+        abort();
+      }
       destroy_delim_string(split);
     }
   }
 
+  // Copying and in-place case conversion must agree, and simple mappings
+  // never change the code point count.
+  CStringResult lower = to_lower(input);
+  CStringResult copy = string_new(input);
+  if (lower.status == CSTRING_OK && copy.status == CSTRING_OK) {
+    if (to_lower_in_place(copy.value) != CSTRING_OK ||
+        copy.value->length != lower.value->length ||
+        copy.value->codepoint_length != input->codepoint_length ||
+        lower.value->codepoint_length != input->codepoint_length ||
+        memcmp(string_data(copy.value), string_data(lower.value),
+               lower.value->length) != 0) {
+      abort();
+    }
+  }
+  if (lower.value) {
+    destroy_string(lower.value);
+  }
+  if (copy.value) {
+    destroy_string(copy.value);
+  }
+
   destroy_string(input);
 }
 
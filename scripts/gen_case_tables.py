@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""Generate c_string_case_tables.h from the Unicode Character Database.
+
+Usage: scripts/gen_case_tables.py UnicodeData.txt UNICODE_VERSION \
+           > c_string_case_tables.h
+
+Only the simple (one code point to one code point) uppercase and lowercase
+mappings, fields 12 and 13 of UnicodeData.txt, are used. Each mapping becomes
+a two-level table: stage1 maps a block of 2^SHIFT code points to a
+deduplicated stage2 block, whose bytes index a small palette of deltas.
+"""
+
+import sys
+
+SHIFT = 6
+BLOCK = 1 << SHIFT
+
+
+def load_mappings(path):
+    lower = {}
+    upper = {}
+    with open(path, encoding="utf-8") as data:
+        for line in data:
+            fields = line.rstrip("\n").split(";")
+            codepoint = int(fields[0], 16)
+            if fields[12]:
+                upper[codepoint] = int(fields[12], 16)
+            if fields[13]:
+                lower[codepoint] = int(fields[13], 16)
+    return lower, upper
+
+
+def build_table(mapping):
+    limit = (max(mapping) // BLOCK + 1) * BLOCK
+    deltas = [0]
+    palette = {0: 0}
+    blocks = {}
+    stage1 = []
+    stage2 = []
+
+    for start in range(0, limit, BLOCK):
+        block = []
+        for codepoint in range(start, start + BLOCK):
+            delta = mapping.get(codepoint, codepoint) - codepoint
+            if delta not in palette:
+                palette[delta] = len(deltas)
+                deltas.append(delta)
+            block.append(palette[delta])
+
+        block = tuple(block)
+        if block not in blocks:
+            blocks[block] = len(blocks)
+            stage2.extend(block)
+        stage1.append(blocks[block])
+
+    assert len(blocks) <= 256 and len(deltas) <= 256
+    return limit, stage1, stage2, deltas
+
+
+def format_array(c_type, name, values):
+    lines = ["static const %s %s[%d] = {" % (c_type, name, len(values))]
+    row = "   "
+    for value in values:
+        item = " %d," % value
+        if len(row) + len(item) > 80:
+            lines.append(row)
+            row = "   "
+        row += item
+    lines.append(row)
+    lines.append("};")
+    return "\n".join(lines)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+
+    lower, upper = load_mappings(sys.argv[1])
+    print("// Generated by scripts/gen_case_tables.py from UnicodeData.txt "
+          "(Unicode")
+    print("// %s). Do not edit by hand." % sys.argv[2])
+    print("//")
+    print("// Simple case mappings: a code point c below CASE_*_LIMIT maps to")
+    print("// c + deltas[stage2[(stage1[c >> CASE_TABLE_SHIFT] << "
+          "CASE_TABLE_SHIFT) +")
+    print("// (c & (CASE_TABLE_BLOCK - 1))]]; everything else maps to itself.")
+    print()
+    print("#define CASE_TABLE_SHIFT %d" % SHIFT)
+    print("#define CASE_TABLE_BLOCK %d" % BLOCK)
+
+    for name, mapping in (("lower", lower), ("upper", upper)):
+        limit, stage1, stage2, deltas = build_table(mapping)
+        print()
+        print("#define CASE_%s_LIMIT 0x%X" % (name.upper(), limit))
+        print()
+        print(format_array("uint8_t", "case_%s_stage1" % name, stage1))
+        print()
+        print(format_array("uint8_t", "case_%s_stage2" % name, stage2))
+        print()
+        print(format_array("int32_t", "case_%s_deltas" % name, deltas))
+
+
+if __name__ == "__main__":
+    main()
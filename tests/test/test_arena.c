@@ -0,0 +1,104 @@
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+static c_string_arena arena;
+
+void setUp(void) {
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, arena_init(&arena, 256));
+}
+
+void tearDown(void) { arena_destroy(&arena); }
+
+void test_string_from_char_in_places_header_and_payload_together(void) {
+  const char* literal = "héł🧊";
+  CStringResult result =
+      string_from_char_in(&arena, literal, (int)strlen(literal));
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_NOT_NULL(result.value);
+  TEST_ASSERT_EQUAL_INT(CSTRING_STORAGE_ARENA, result.value->storage);
+  TEST_ASSERT_TRUE((char*)(result.value + 1) == result.value->string);
+  TEST_ASSERT_EQUAL_size_t(strlen(literal), result.value->length);
+  TEST_ASSERT_EQUAL_size_t(4, result.value->codepoint_length);
+  TEST_ASSERT_TRUE(result.value->utf8_valid);
+
+  // destroy_string must leave arena strings alone.
+  destroy_string(result.value);
+}
+
+void test_arena_constructors_match_heap_constructors(void) {
+  CStringResult source = string_from_char_in(&arena, "mañana", 7);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, source.status);
+
+  CStringResult copy = string_new_in(&arena, source.value);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, copy.status);
+  TEST_ASSERT_EQUAL_MEMORY(source.value->string, copy.value->string, 7);
+  TEST_ASSERT_EQUAL_size_t(6, copy.value->codepoint_length);
+
+  CStringResult bytes = sub_string_checked_in(&arena, source.value, 0, 1);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, bytes.status);
+  TEST_ASSERT_EQUAL_MEMORY("ma", bytes.value->string, 2);
+
+  CStringResult codepoints =
+      sub_string_codepoint_in(&arena, source.value, 2, 3);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, codepoints.status);
+  TEST_ASSERT_EQUAL_size_t(3, codepoints.value->length);
+  TEST_ASSERT_EQUAL_MEMORY("ña", codepoints.value->string, 3);
+
+  CStringResult buffer = initialize_buffer_in(&arena, 0);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, buffer.status);
+  TEST_ASSERT_NULL(buffer.value->string);
+  TEST_ASSERT_TRUE(buffer.value->utf8_valid);
+}
+
+void test_arena_rejects_invalid_utf8_without_leaking_space(void) {
+  const char payload[] = {(char)0xC3, (char)0x28};
+  void* before = arena_alloc(&arena, 1);
+
+  CStringResult result = string_from_char_in(&arena, payload, 2);
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_UTF8, result.status);
+  TEST_ASSERT_NULL(result.value);
+
+  // The failed string was the latest allocation, so its space is reused.
+  void* after = arena_alloc(&arena, 1);
+  TEST_ASSERT_TRUE((char*)after == (char*)before + 16);
+}
+
+void test_arena_reset_reuses_blocks(void) {
+  CStringResult first = string_from_char_in(&arena, "reuse", 5);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, first.status);
+
+  // Spill into further blocks, including one larger than the block size.
+  char big[1024];
+  memset(big, 'x', sizeof(big));
+  for (int i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                          string_from_char_in(&arena, big, 200).status);
+  }
+  TEST_ASSERT_EQUAL_INT(
+      CSTRING_OK, string_from_char_in(&arena, big, (int)sizeof(big)).status);
+
+  arena_reset(&arena);
+
+  CStringResult again = string_from_char_in(&arena, "reuse", 5);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, again.status);
+  TEST_ASSERT_TRUE(first.value == again.value);
+}
+
+void test_string_concat_grows_arena_string(void) {
+  CStringResult base = string_from_char_in(&arena, "Hello", 5);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, base.status);
+
+  // Latest allocation: grows in place.
+  string_concat(base.value, ", ");
+  TEST_ASSERT_TRUE((char*)(base.value + 1) == base.value->string);
+
+  // Another allocation in between forces a move within the arena.
+  TEST_ASSERT_NOT_NULL(arena_alloc(&arena, 8));
+  string_concat(base.value, "World");
+
+  TEST_ASSERT_EQUAL_size_t(12, base.value->length);
+  TEST_ASSERT_EQUAL_MEMORY("Hello, World", base.value->string, 12);
+}
@@ -0,0 +1,182 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+static c_string* make_string(const char* bytes, size_t length) {
+  CStringResult result = string_from_char(bytes, (int)length);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  return result.value;
+}
+
+static void assert_lower(const char* input, const char* expected) {
+  c_string* s = make_string(input, strlen(input));
+  CStringResult lower = to_lower(s);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, lower.status);
+  TEST_ASSERT_EQUAL_size_t(strlen(expected), lower.value->length);
+  TEST_ASSERT_EQUAL_MEMORY(expected, string_data(lower.value),
+                           lower.value->length);
+  TEST_ASSERT_TRUE(lower.value->utf8_valid);
+  TEST_ASSERT_EQUAL_size_t(s->codepoint_length, lower.value->codepoint_length);
+
+  destroy_string(lower.value);
+  destroy_string(s);
+}
+
+static void assert_upper(const char* input, const char* expected) {
+  c_string* s = make_string(input, strlen(input));
+  CStringResult upper = to_upper(s);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, upper.status);
+  TEST_ASSERT_EQUAL_size_t(strlen(expected), upper.value->length);
+  TEST_ASSERT_EQUAL_MEMORY(expected, string_data(upper.value),
+                           upper.value->length);
+
+  destroy_string(upper.value);
+  destroy_string(s);
+}
+
+void setUp(void) {}
+
+void tearDown(void) { cstring_set_simd_enabled(true); }
+
+void test_to_lower_ascii_matches_tolower_across_simd_widths(void) {
+  char input[200];
+  char expected[200];
+  for (size_t i = 0; i < sizeof(input); i++) {
+    input[i] = (char)(32 + (i * 37) % 95);
+    expected[i] = (char)tolower((unsigned char)input[i]);
+  }
+
+  for (size_t length = 0; length <= sizeof(input); length += 7) {
+    c_string* s = make_string(input, length);
+    CStringResult lower = to_lower(s);
+    TEST_ASSERT_EQUAL_INT(CSTRING_OK, lower.status);
+    TEST_ASSERT_EQUAL_size_t(length, lower.value->length);
+    if (length > 0) {
+      TEST_ASSERT_EQUAL_MEMORY(expected, string_data(lower.value), length);
+    }
+    TEST_ASSERT_EQUAL_size_t(length, lower.value->codepoint_length);
+    destroy_string(lower.value);
+    destroy_string(s);
+  }
+}
+
+void test_to_lower_and_to_upper_map_unicode_letters(void) {
+  assert_lower("ÀÉÎÕÜ ΣΑΣ ПРИВЕТ Ǆ Ա 𐐀", "àéîõü σασ привет ǆ ա 𐐨");
+  assert_upper("àéîõü σας привет ǆ ա 𐐨", "ÀÉÎÕÜ ΣΑΣ ПРИВЕТ Ǆ Ա 𐐀");
+  // No simple uppercase mapping exists for ß.
+  assert_upper("straße ÿ", "STRAßE Ÿ");
+}
+
+void test_case_mappings_that_change_byte_length(void) {
+  // U+023A (2 bytes) -> U+2C65 (3 bytes)
+  assert_lower("Ⱥx", "ⱥx");
+  // KELVIN SIGN (3 bytes) -> k, U+0130 (2 bytes) -> i
+  assert_lower("\xE2\x84\xAA-İ", "k-i");
+  // U+2C65 (3 bytes) -> U+023A (2 bytes)
+  assert_upper("ⱥ", "Ⱥ");
+}
+
+void test_to_lower_copies_invalid_bytes_through(void) {
+  const char input[] = {'A', (char)0xC3, 'B', (char)0xFF, (char)0xC3,
+                        (char)0x89};
+  const char expected[] = {'a', (char)0xC3, 'b', (char)0xFF, (char)0xC3,
+                           (char)0xA9};
+  c_string s = {0};
+  char buffer[sizeof(input)];
+  s.string = buffer;
+  create_string(&s, sizeof(input), (char*)input);
+  TEST_ASSERT_FALSE(s.utf8_valid);
+
+  CStringResult lower = to_lower(&s);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, lower.status);
+  TEST_ASSERT_EQUAL_MEMORY(expected, string_data(lower.value),
+                           sizeof(expected));
+  TEST_ASSERT_FALSE(lower.value->utf8_valid);
+  destroy_string(lower.value);
+}
+
+void test_in_place_conversion_keeps_the_buffer_when_sizes_match(void) {
+  c_string* s = make_string("HELLO, ÑANDÚ AND FRIENDS OF THE WORLD",
+                            strlen("HELLO, ÑANDÚ AND FRIENDS OF THE WORLD"));
+  char* before = string_data(s);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, to_lower_in_place(s));
+  TEST_ASSERT_TRUE(string_data(s) == before);
+  TEST_ASSERT_EQUAL_MEMORY("hello, ñandú and friends of the world",
+                           string_data(s), s->length);
+  TEST_ASSERT_EQUAL_size_t(37, s->codepoint_length);
+  TEST_ASSERT_TRUE(s->utf8_valid);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, to_upper_in_place(s));
+  TEST_ASSERT_EQUAL_MEMORY("HELLO, ÑANDÚ AND FRIENDS OF THE WORLD",
+                           string_data(s), s->length);
+
+  destroy_string(s);
+}
+
+void test_in_place_conversion_handles_length_changes(void) {
+  const char* input = "AB Ⱥ CD \xE2\x84\xAA EF";
+  c_string* s = make_string(input, strlen(input));
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, to_lower_in_place(s));
+  TEST_ASSERT_EQUAL_size_t(strlen("ab ⱥ cd k ef"), s->length);
+  TEST_ASSERT_EQUAL_MEMORY("ab ⱥ cd k ef", string_data(s), s->length);
+  TEST_ASSERT_EQUAL_size_t(12, s->codepoint_length);
+  TEST_ASSERT_TRUE(s->utf8_valid);
+
+  destroy_string(s);
+}
+
+void test_simd_and_scalar_case_conversion_agree(void) {
+  const char* pieces[] = {"Hello ", "WORLD", "É", "ß", "Ⱥ", "ǅ", "Z", "\xFF"};
+  char input[512];
+  size_t length = 0;
+  uint32_t state = 12345;
+  while (length + 4 < sizeof(input)) {
+    state = state * 1103515245u + 12345u;
+    const char* piece = pieces[(state >> 16) % 8];
+    size_t piece_length = strlen(piece);
+    if (length + piece_length > sizeof(input)) {
+      break;
+    }
+    memcpy(input + length, piece, piece_length);
+    length += piece_length;
+  }
+
+  c_string* s = make_string(input, 0);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_append(s, input, length));
+
+  CStringResult vectorized = to_upper(s);
+  cstring_set_simd_enabled(false);
+  CStringResult scalar = to_upper(s);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, vectorized.status);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, scalar.status);
+  TEST_ASSERT_EQUAL_size_t(scalar.value->length, vectorized.value->length);
+  TEST_ASSERT_EQUAL_MEMORY(string_data(scalar.value),
+                           string_data(vectorized.value),
+                           scalar.value->length);
+
+  destroy_string(vectorized.value);
+  destroy_string(scalar.value);
+  destroy_string(s);
+}
+
+void test_to_lower_in_arena(void) {
+  c_string_arena arena;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, arena_init(&arena, 0));
+  CStringResult s = string_from_char_in(&arena, "ÀB", 3);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, s.status);
+
+  CStringResult lower = to_lower_in(&arena, s.value);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, lower.status);
+  TEST_ASSERT_EQUAL_MEMORY("àb", string_data(lower.value), 3);
+  TEST_ASSERT_EQUAL_INT(CSTRING_STORAGE_ARENA, lower.value->storage);
+
+  arena_destroy(&arena);
+}
@@ -0,0 +1,183 @@
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+static char document[4096];
+static size_t document_length;
+// Byte offset of every code point in `document`, plus the end offset.
+static size_t offsets[4096];
+static size_t codepoint_count;
+
+void setUp(void) {
+  const char* pieces[] = {"a", "é", "€", "🧊", "xyz"};
+  document_length = 0;
+  codepoint_count = 0;
+
+  for (size_t i = 0; document_length + 8 < sizeof(document); i++) {
+    const char* piece = pieces[(i * 7) % 5];
+    size_t piece_length = strlen(piece);
+    memcpy(document + document_length, piece, piece_length);
+
+    // Record where each code point of the piece starts.
+    for (size_t j = 0; j < piece_length; j++) {
+      if (((unsigned char)piece[j] & 0xC0) != 0x80) {
+        offsets[codepoint_count++] = document_length + j;
+      }
+    }
+    document_length += piece_length;
+  }
+  offsets[codepoint_count] = document_length;
+}
+
+void tearDown(void) {}
+
+static c_string* make_document(void) {
+  CStringResult result = string_from_char(document, (int)document_length);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_EQUAL_size_t(codepoint_count, result.value->codepoint_length);
+  return result.value;
+}
+
+static void assert_slice_matches(c_string* s, size_t start, size_t end) {
+  CStringResult slice = sub_string_codepoint(s, start, end);
+  size_t byte_start = offsets[start];
+  size_t byte_end = offsets[end + 1];
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, slice.status);
+  TEST_ASSERT_EQUAL_size_t(byte_end - byte_start, slice.value->length);
+  TEST_ASSERT_EQUAL_MEMORY(document + byte_start, string_data(slice.value),
+                           byte_end - byte_start);
+  TEST_ASSERT_EQUAL_size_t(end - start + 1, slice.value->codepoint_length);
+  destroy_string(slice.value);
+}
+
+void test_codepoint_slices_match_a_full_decode(void) {
+  c_string* s = make_document();
+
+  for (size_t start = 0; start < codepoint_count; start += 37) {
+    for (size_t width = 0; start + width < codepoint_count; width += 101) {
+      assert_slice_matches(s, start, start + width);
+    }
+  }
+  assert_slice_matches(s, 0, codepoint_count - 1);
+  assert_slice_matches(s, codepoint_count - 1, codepoint_count - 1);
+
+  destroy_string(s);
+}
+
+void test_codepoint_index_is_built_once_and_reused(void) {
+  c_string* s = make_document();
+  TEST_ASSERT_NULL(s->local.codepoint_index);
+
+  assert_slice_matches(s, 10, 20);
+  c_string_codepoint_index* index = s->local.codepoint_index;
+  TEST_ASSERT_NOT_NULL(index);
+
+  assert_slice_matches(s, 900, 1000);
+  TEST_ASSERT_TRUE(s->local.codepoint_index == index);
+
+  destroy_string(s);
+}
+
+void test_mutation_invalidates_the_codepoint_index(void) {
+  c_string* s = make_document();
+  assert_slice_matches(s, 0, 5);
+  TEST_ASSERT_NOT_NULL(s->local.codepoint_index);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_concat(s, "ñ"));
+  TEST_ASSERT_NULL(s->local.codepoint_index);
+
+  CStringResult tail = sub_string_codepoint(s, codepoint_count - 1,
+                                            codepoint_count);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, tail.status);
+  TEST_ASSERT_EQUAL_size_t(2, tail.value->codepoint_length);
+  const char* tail_bytes = string_data(tail.value);
+  TEST_ASSERT_EQUAL_MEMORY("ñ", tail_bytes + tail.value->length - 2, 2);
+  destroy_string(tail.value);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_modify(s, "short ñ"));
+  TEST_ASSERT_NULL(s->local.codepoint_index);
+  CStringResult last = sub_string_codepoint(s, 6, 6);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, last.status);
+  TEST_ASSERT_EQUAL_MEMORY("ñ", string_data(last.value), 2);
+  destroy_string(last.value);
+
+  destroy_string(s);
+}
+
+void test_create_string_releases_the_old_index(void) {
+  c_string* s = make_document();
+  assert_slice_matches(s, 0, 5);
+  TEST_ASSERT_NOT_NULL(s->local.codepoint_index);
+
+  // Reinitialize the header in place with different bytes of the same
+  // length: slicing must not use the old index, and the old index is freed
+  // rather than leaked
+  static char replacement[sizeof(document)];
+  size_t length = 0;
+  while (length + 2 <= document_length) {
+    memcpy(replacement + length, "ñ", 2);
+    length += 2;
+  }
+  if (length < document_length) {
+    replacement[length++] = 'a';
+  }
+  create_string(s, document_length, replacement);
+  TEST_ASSERT_EQUAL_size_t(document_length, s->length);
+
+  CStringResult slice = sub_string_codepoint(s, 1000, 1001);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, slice.status);
+  TEST_ASSERT_EQUAL_size_t(4, slice.value->length);
+  TEST_ASSERT_EQUAL_MEMORY("ññ", string_data(slice.value), 4);
+  destroy_string(slice.value);
+
+  destroy_string(s);
+}
+
+void test_create_string_leaves_the_index_slot_of_a_header_alone(void) {
+  // A caller's header whose fields other than `string` are leftovers
+  c_string s;
+  memset(&s, 0xAB, sizeof(s));
+  char buffer[8];
+  s.string = buffer;
+  s.storage = CSTRING_STORAGE_HEAP;
+
+  create_string(&s, 4, "día");
+  TEST_ASSERT_EQUAL_size_t(3, s.codepoint_length);
+  TEST_ASSERT_TRUE(s.utf8_valid);
+  TEST_ASSERT_EQUAL_MEMORY("día", buffer, 4);
+}
+
+void test_ascii_strings_slice_without_an_index(void) {
+  char ascii[1024];
+  memset(ascii, 'q', sizeof(ascii));
+  ascii[700] = '!';
+  CStringResult result = string_from_char(ascii, (int)sizeof(ascii));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+
+  CStringResult slice = sub_string_codepoint(result.value, 699, 701);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, slice.status);
+  TEST_ASSERT_EQUAL_MEMORY("q!q", string_data(slice.value), 3);
+  TEST_ASSERT_NULL(result.value->local.codepoint_index);
+
+  destroy_string(slice.value);
+  destroy_string(result.value);
+}
+
+void test_arena_strings_keep_their_index_in_the_arena(void) {
+  c_string_arena arena;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, arena_init(&arena, 0));
+
+  CStringResult result =
+      string_from_char_in(&arena, document, (int)document_length);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+
+  CStringResult slice = sub_string_codepoint_in(&arena, result.value, 500, 510);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, slice.status);
+  TEST_ASSERT_NOT_NULL(result.value->local.codepoint_index);
+  TEST_ASSERT_EQUAL_MEMORY(document + offsets[500], string_data(slice.value),
+                           offsets[511] - offsets[500]);
+
+  arena_destroy(&arena);
+}
@@ -0,0 +1,93 @@
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+static c_string* make_string(const char* literal) {
+  CStringResult result = string_from_char(literal, (int)strlen(literal));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_NOT_NULL(result.value);
+  return result.value;
+}
+
+// Walk the iterator and string_delim side by side; both must produce the
+// same tokens in the same order.
+static void expect_iter_matches_string_delim(const char* input,
+                                             const char* delim) {
+  c_string* s = make_string(input);
+  c_string** pieces = string_delim(s, delim);
+  TEST_ASSERT_NOT_NULL(pieces);
+
+  c_string_delim_iter it;
+  delim_iter_init(&it, s, delim);
+
+  size_t index = 0;
+  c_string_view token;
+  while (delim_iter_next(&it, &token)) {
+    TEST_ASSERT_NOT_NULL_MESSAGE(pieces[index],
+                                 "iterator produced an extra token");
+    TEST_ASSERT_EQUAL_size_t(pieces[index]->length, token.length);
+    TEST_ASSERT_EQUAL_MEMORY(pieces[index]->string, token.data, token.length);
+    TEST_ASSERT_EQUAL_size_t(pieces[index]->codepoint_length,
+                             token.codepoint_length);
+    index += 1;
+  }
+  TEST_ASSERT_NULL_MESSAGE(pieces[index], "iterator missed a token");
+
+  destroy_delim_string(pieces);
+  destroy_string(s);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_delim_iter_matches_string_delim(void) {
+  expect_iter_matches_string_delim("Hello,World,UTF-8", ",");
+  expect_iter_matches_string_delim(",a,,b,", ",");
+  expect_iter_matches_string_delim("mañana::día::", "::");
+  expect_iter_matches_string_delim("aaaa", "aa");
+  expect_iter_matches_string_delim("aaa", "aa");
+  expect_iter_matches_string_delim("abc", "abc");
+  expect_iter_matches_string_delim("abc", "abcd");
+  expect_iter_matches_string_delim("no delimiter here", ";");
+  expect_iter_matches_string_delim("a b", "");
+}
+
+void test_delim_iter_stops_early_and_resets(void) {
+  c_string* s = make_string("ts=1 level=info msg=hello extra=ignored");
+  c_string_delim_iter it;
+  delim_iter_init(&it, s, " ");
+
+  c_string_view token;
+  TEST_ASSERT_TRUE(delim_iter_next(&it, &token));
+  TEST_ASSERT_EQUAL_MEMORY("ts=1", token.data, token.length);
+  TEST_ASSERT_TRUE(delim_iter_next(&it, &token));
+  TEST_ASSERT_EQUAL_MEMORY("level=info", token.data, token.length);
+
+  delim_iter_reset(&it);
+  TEST_ASSERT_TRUE(delim_iter_next(&it, &token));
+  TEST_ASSERT_TRUE(token.data == s->string);
+  TEST_ASSERT_EQUAL_size_t(4, token.length);
+
+  destroy_string(s);
+}
+
+void test_delim_iter_next_string_borrows_source_bytes(void) {
+  c_string* s = make_string("añ|b");
+  c_string_delim_iter it;
+  delim_iter_init(&it, s, "|");
+
+  c_string token = {0};
+  TEST_ASSERT_TRUE(delim_iter_next_string(&it, &token));
+  TEST_ASSERT_TRUE(token.string == s->string);
+  TEST_ASSERT_EQUAL_size_t(3, token.length);
+  TEST_ASSERT_EQUAL_size_t(2, token.codepoint_length);
+  TEST_ASSERT_TRUE(token.utf8_valid);
+
+  TEST_ASSERT_TRUE(delim_iter_next_string(&it, &token));
+  TEST_ASSERT_EQUAL_MEMORY("b", token.string, 1);
+  TEST_ASSERT_FALSE(delim_iter_next_string(&it, &token));
+
+  destroy_string(s);
+}
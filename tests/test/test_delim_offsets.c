@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+// Four chunks of 256 KiB once the parallel threshold is lowered
+#define BUFFER_SIZE ((size_t)1024 * 1024)
+#define THREADS 4
+
+static char* buffer;
+
+void setUp(void) {
+  buffer = malloc(BUFFER_SIZE);
+  TEST_ASSERT_NOT_NULL(buffer);
+  memset(buffer, 'x', BUFFER_SIZE);
+  cstring_set_parallel_threshold(1);
+  cstring_set_thread_count(THREADS);
+}
+
+void tearDown(void) {
+  free(buffer);
+  cstring_set_parallel_threshold((size_t)8 * 1024 * 1024);
+  cstring_set_thread_count(0);
+}
+
+static c_string_view buffer_view(void) {
+  c_string_view v = {.data = buffer,
+                     .length = BUFFER_SIZE,
+                     .codepoint_length = BUFFER_SIZE,
+                     .utf8_valid = true};
+  return v;
+}
+
+// Run the split with one thread and with THREADS threads and check both
+// against a plain left-to-right scan.
+static size_t expect_serial_and_parallel_agree(const char* delim) {
+  c_string_needle needle;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        needle_compile(&needle, delim, strlen(delim)));
+  CStringResult s = string_from_char(buffer, (int)BUFFER_SIZE);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, s.status);
+  size_t expected_count = string_find_all(s.value, &needle, NULL, 0);
+  size_t* expected = malloc((expected_count + 1) * sizeof(size_t));
+  string_find_all(s.value, &needle, expected, expected_count);
+
+  for (size_t threads = 1; threads <= THREADS; threads += THREADS - 1) {
+    size_t* offsets = NULL;
+    size_t count = 0;
+    cstring_set_thread_count(threads);
+    TEST_ASSERT_EQUAL_INT(
+        CSTRING_OK, string_delim_offsets(s.value, delim, &offsets, &count));
+    TEST_ASSERT_EQUAL_size_t(expected_count, count);
+    if (count > 0) {
+      TEST_ASSERT_EQUAL_MEMORY(expected, offsets, count * sizeof(size_t));
+    }
+    free(offsets);
+  }
+
+  free(expected);
+  destroy_string(s.value);
+  return expected_count;
+}
+
+void test_offsets_of_newlines_come_back_in_order(void) {
+  for (size_t i = 79; i < BUFFER_SIZE; i += 80) {
+    buffer[i] = '\n';
+  }
+  TEST_ASSERT_EQUAL_size_t(BUFFER_SIZE / 80,
+                           expect_serial_and_parallel_agree("\n"));
+}
+
+void test_delimiters_across_chunk_boundaries_are_found_once(void) {
+  size_t chunk = BUFFER_SIZE / THREADS;
+  // "\r\n" straddling every boundary, plus matches right before and after
+  for (size_t t = 1; t < THREADS; t++) {
+    memcpy(buffer + chunk * t - 1, "\r\n", 2);
+    memcpy(buffer + chunk * t - 5, "\r\n", 2);
+    memcpy(buffer + chunk * t + 3, "\r\n", 2);
+  }
+  TEST_ASSERT_EQUAL_size_t(3 * (THREADS - 1),
+                           expect_serial_and_parallel_agree("\r\n"));
+
+  // A long delimiter that starts in one chunk and ends in the next
+  memcpy(buffer + chunk * 2 - 10, "<separator>", 11);
+  TEST_ASSERT_EQUAL_size_t(1, expect_serial_and_parallel_agree("<separator>"));
+}
+
+void test_self_overlapping_delimiters_match_the_serial_scan(void) {
+  // A run of 'a' with odd length across a chunk boundary
+  size_t chunk = BUFFER_SIZE / THREADS;
+  memset(buffer + chunk - 7, 'a', 13);
+  memset(buffer + 3 * chunk - 2, 'a', 5);
+  TEST_ASSERT_EQUAL_size_t(6 + 2, expect_serial_and_parallel_agree("aa"));
+}
+
+void test_no_matches_and_empty_delimiters(void) {
+  size_t* offsets = NULL;
+  size_t count = 1;
+  TEST_ASSERT_EQUAL_INT(
+      CSTRING_OK, view_delim_offsets(buffer_view(), ",", &offsets, &count));
+  TEST_ASSERT_EQUAL_size_t(0, count);
+  TEST_ASSERT_NULL(offsets);
+
+  count = 1;
+  TEST_ASSERT_EQUAL_INT(
+      CSTRING_OK, view_delim_offsets(buffer_view(), "", &offsets, &count));
+  TEST_ASSERT_EQUAL_size_t(0, count);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        view_delim_offsets(buffer_view(), NULL, &offsets,
+                                           &count));
+}
+
+void test_string_delim_splits_large_inputs(void) {
+  for (size_t i = 99; i < BUFFER_SIZE; i += 100) {
+    buffer[i] = ';';
+  }
+  CStringResult s = string_from_char(buffer, (int)BUFFER_SIZE);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, s.status);
+
+  c_string** pieces = string_delim(s.value, ";");
+  TEST_ASSERT_NOT_NULL(pieces);
+  size_t count = 0;
+  while (pieces[count]) {
+    count += 1;
+  }
+  TEST_ASSERT_EQUAL_size_t(BUFFER_SIZE / 100 + 1, count);
+  TEST_ASSERT_EQUAL_size_t(99, pieces[0]->length);
+  TEST_ASSERT_EQUAL_size_t(99, pieces[count / 2]->length);
+  TEST_ASSERT_EQUAL_size_t(BUFFER_SIZE % 100, pieces[count - 1]->length);
+
+  destroy_delim_string(pieces);
+  destroy_string(s.value);
+}
@@ -0,0 +1,128 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+static char path[] = "/tmp/c_string_mmapXXXXXX";
+
+static void write_file(const char* contents, size_t length) {
+  strcpy(path, "/tmp/c_string_mmapXXXXXX");
+  int fd = mkstemp(path);
+  TEST_ASSERT_TRUE(fd >= 0);
+  TEST_ASSERT_EQUAL_INT((int)length, (int)write(fd, contents, length));
+  close(fd);
+}
+
+static void assert_file_contents(const char* expected, size_t length) {
+  char buffer[256];
+  FILE* f = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL(f);
+  TEST_ASSERT_EQUAL_size_t(length, fread(buffer, 1, sizeof(buffer), f));
+  fclose(f);
+  TEST_ASSERT_EQUAL_MEMORY(expected, buffer, length);
+}
+
+void setUp(void) { path[0] = '\0'; }
+
+void tearDown(void) {
+  if (path[0]) {
+    remove(path);
+  }
+}
+
+void test_mmap_wraps_the_file_contents(void) {
+  const char contents[] = "timestamp,level,message\n1,info,héllo\n";
+  write_file(contents, sizeof(contents) - 1);
+
+  CStringResult result = string_from_file_mmap(path);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  c_string* s = result.value;
+  TEST_ASSERT_EQUAL_INT(CSTRING_STORAGE_MAPPED, s->storage);
+  TEST_ASSERT_EQUAL_size_t(sizeof(contents) - 1, s->length);
+  TEST_ASSERT_EQUAL_size_t(sizeof(contents) - 2, s->codepoint_length);
+  TEST_ASSERT_TRUE(s->utf8_valid);
+  TEST_ASSERT_EQUAL_MEMORY(contents, string_data(s), s->length);
+
+  destroy_string(s);
+}
+
+void test_search_split_and_slice_work_on_the_mapping(void) {
+  char contents[2048];
+  size_t length = 0;
+  for (int i = 0; i < 100; i++) {
+    length += (size_t)sprintf(contents + length, "line %02d ✓\n", i);
+  }
+  write_file(contents, length);
+
+  c_string* s = string_from_file_mmap(path).value;
+  TEST_ASSERT_NOT_NULL(s);
+
+  c_string_needle needle;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, needle_compile(&needle, "line 42", 7));
+  TEST_ASSERT_EQUAL_size_t(42 * 12, string_find(s, &needle, 0));
+
+  c_string_delim_iter it;
+  c_string_view token;
+  size_t tokens = 0;
+  delim_iter_init(&it, s, "\n");
+  while (delim_iter_next(&it, &token)) {
+    TEST_ASSERT_TRUE(token.data >= string_data(s));
+    tokens += 1;
+  }
+  TEST_ASSERT_EQUAL_size_t(101, tokens);
+
+  // Every line is 10 code points, so 800..806 is "line 80"
+  CStringResult slice = sub_string_codepoint(s, 800, 806);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, slice.status);
+  TEST_ASSERT_EQUAL_MEMORY("line 80", string_data(slice.value), 7);
+
+  destroy_string(slice.value);
+  destroy_string(s);
+}
+
+void test_edits_stay_private_to_the_string(void) {
+  const char contents[] = "mapped bytes";
+  write_file(contents, sizeof(contents) - 1);
+
+  c_string* s = string_from_file_mmap(path).value;
+  TEST_ASSERT_NOT_NULL(s);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, to_upper_in_place(s));
+  TEST_ASSERT_EQUAL_INT(CSTRING_STORAGE_MAPPED, s->storage);
+  TEST_ASSERT_EQUAL_MEMORY("MAPPED BYTES", string_data(s), 12);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_concat(s, " and more"));
+  TEST_ASSERT_EQUAL_INT(CSTRING_STORAGE_HEAP, s->storage);
+  TEST_ASSERT_EQUAL_MEMORY("MAPPED BYTES and more", string_data(s), 21);
+
+  assert_file_contents(contents, sizeof(contents) - 1);
+  destroy_string(s);
+}
+
+void test_mmap_rejects_invalid_utf8_and_missing_files(void) {
+  write_file("ok \xC3\x28", 5);
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_UTF8,
+                        string_from_file_mmap(path).status);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_IO,
+                        string_from_file_mmap("/nonexistent/file").status);
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_IO, string_from_file_mmap("/tmp").status);
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        string_from_file_mmap(NULL).status);
+}
+
+void test_mmap_of_an_empty_file_is_an_empty_string(void) {
+  write_file("", 0);
+
+  CStringResult result = string_from_file_mmap(path);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_EQUAL_size_t(0, result.value->length);
+  TEST_ASSERT_TRUE(result.value->utf8_valid);
+
+  destroy_string(result.value);
+}
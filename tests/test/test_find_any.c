@@ -0,0 +1,240 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+#define TEXT_LENGTH 4000
+
+static c_string_view literal_view(const char* literal) {
+  c_string_view view;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        view_from_char(literal, strlen(literal), &view));
+  return view;
+}
+
+static c_string_multi_needle* compile(const char* const* patterns,
+                                      size_t count) {
+  c_string_multi_needle* needles = NULL;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        multi_needle_compile(patterns, count, &needles));
+  TEST_ASSERT_NOT_NULL(needles);
+  return needles;
+}
+
+// Leftmost-longest match by brute force
+static size_t naive_find_any(const char* text, size_t length,
+                             const char* const* patterns, size_t count,
+                             size_t from, size_t* pattern) {
+  for (size_t i = from; i < length; i++) {
+    size_t best_length = 0;
+    for (size_t p = 0; p < count; p++) {
+      size_t m = strlen(patterns[p]);
+      if (m > best_length && m <= length - i &&
+          memcmp(text + i, patterns[p], m) == 0) {
+        best_length = m;
+        *pattern = p;
+      }
+    }
+    if (best_length > 0) {
+      return i;
+    }
+  }
+  return CSTRING_NPOS;
+}
+
+void setUp(void) {}
+
+void tearDown(void) { cstring_set_simd_enabled(true); }
+
+void test_find_any_is_leftmost_longest(void) {
+  static const char* const keywords[] = {"he", "she", "his", "hers"};
+  c_string_multi_needle* needles = compile(keywords, 4);
+  size_t pattern = 99;
+  TEST_ASSERT_EQUAL_size_t(
+      1, view_find_any(literal_view("ushers"), needles, 0, &pattern));
+  TEST_ASSERT_EQUAL_size_t(1, pattern);
+  TEST_ASSERT_EQUAL_size_t(
+      2, view_find_any(literal_view("ushers"), needles, 2, &pattern));
+  TEST_ASSERT_EQUAL_size_t(3, pattern);
+  TEST_ASSERT_EQUAL_size_t(
+      CSTRING_NPOS, view_find_any(literal_view("ushers"), needles, 3, NULL));
+  multi_needle_destroy(needles);
+
+  // "bcd" is complete before "abcdef", which starts earlier, is
+  static const char* const nested[] = {"bcd", "abcdef", "\r", "\r\n"};
+  needles = compile(nested, 4);
+  TEST_ASSERT_EQUAL_size_t(
+      0, view_find_any(literal_view("abcdef"), needles, 0, &pattern));
+  TEST_ASSERT_EQUAL_size_t(1, pattern);
+  TEST_ASSERT_EQUAL_size_t(
+      1, view_find_any(literal_view("abcdex"), needles, 0, &pattern));
+  TEST_ASSERT_EQUAL_size_t(0, pattern);
+  TEST_ASSERT_EQUAL_size_t(
+      1, view_find_any(literal_view("a\r\nb"), needles, 0, &pattern));
+  TEST_ASSERT_EQUAL_size_t(3, pattern);
+
+  CStringResult s = string_from_char("x\ry", 3);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, s.status);
+  TEST_ASSERT_EQUAL_size_t(1, string_find_any(s.value, needles, 0, &pattern));
+  TEST_ASSERT_EQUAL_size_t(2, pattern);
+  destroy_string(s.value);
+  multi_needle_destroy(needles);
+}
+
+void test_find_any_matches_naive_search(void) {
+  static const char* const pattern_sets[][6] = {
+      {"ab", "ba", "aab", "b", "abab", "bbb"},
+      {"é", "ü", "a", "\xC3", "\t", "\xFF"},
+      {"caf\xC3\xA9", "\xC3\xA9t\xC3\xA9", "a", "", "aaa", "t"},
+      {"\xBC", "\t", "\xFF", "b", "\xC3", "\xBC"},
+  };
+  static const char alphabet[] = {'a', 'b', 't', '\t', (char)0xC3,
+                                  (char)0xA9, (char)0xBC, (char)0xFF};
+  static char text[TEXT_LENGTH];
+
+  for (int simd = 0; simd <= 1; simd++) {
+    cstring_set_simd_enabled(simd == 1);
+    uint32_t seed = 99;
+    for (size_t set = 0; set < 4; set++) {
+      for (size_t i = 0; i < TEXT_LENGTH; i++) {
+        seed = seed * 1103515245u + 12345u;
+        // Rare pattern bytes in the third set exercise the skipping
+        text[i] = set == 2 && (seed >> 20) % 8 != 0
+                      ? 'z'
+                      : alphabet[(seed >> 16) % sizeof(alphabet)];
+      }
+      c_string_view v = {text, TEXT_LENGTH, 0, false};
+
+      const char* const* patterns = pattern_sets[set];
+      c_string_multi_needle* needles = compile(patterns, 6);
+      size_t from = 0;
+      for (;;) {
+        size_t expected_pattern = 0;
+        size_t pattern = 0;
+        size_t expected = naive_find_any(text, TEXT_LENGTH, patterns, 6, from,
+                                         &expected_pattern);
+        size_t match = view_find_any(v, needles, from, &pattern);
+        TEST_ASSERT_EQUAL_size_t(expected, match);
+        if (match == CSTRING_NPOS) {
+          break;
+        }
+        TEST_ASSERT_EQUAL_size_t(expected_pattern, pattern);
+        from = match + strlen(patterns[pattern]);
+      }
+      multi_needle_destroy(needles);
+    }
+  }
+}
+
+void test_byte_set_delimiters(void) {
+  // Byte sets both below and above the size compared byte by byte
+  static const char* const few[] = {",", ";", "\t"};
+  static const char* const many[] = {",", ";", "\t", " ", "|", ":", "/", "-",
+                                     "\xE2"};
+  const char* text = "alpha,beta;gamma\tdelta|epsilon with a longer tail,"
+                     "and another field;é";
+
+  for (int simd = 0; simd <= 1; simd++) {
+    cstring_set_simd_enabled(simd == 1);
+
+    c_string_multi_needle* needles = compile(few, 3);
+    c_string_split split;
+    TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                          view_split_any(literal_view(text), needles, &split));
+    static const char* const expected[] = {
+        "alpha", "beta", "gamma", "delta|epsilon with a longer tail",
+        "and another field", "é"};
+    TEST_ASSERT_EQUAL_size_t(6, split.count);
+    for (size_t i = 0; i < split.count; i++) {
+      c_string_view token = split_get(&split, i);
+      TEST_ASSERT_EQUAL_size_t(strlen(expected[i]), token.length);
+      TEST_ASSERT_EQUAL_MEMORY(expected[i], token.data, token.length);
+      TEST_ASSERT_TRUE(token.utf8_valid);
+    }
+    split_destroy(&split);
+    multi_needle_destroy(needles);
+
+    needles = compile(many, 9);
+    size_t pattern = 0;
+    TEST_ASSERT_EQUAL_size_t(
+        22, view_find_any(literal_view(text), needles, 17, &pattern));
+    TEST_ASSERT_EQUAL_size_t(4, pattern);
+    TEST_ASSERT_EQUAL_size_t(
+        3, view_find_any(literal_view("abc—"), needles, 0, &pattern));
+    TEST_ASSERT_EQUAL_size_t(8, pattern);
+    TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                          view_split_any(literal_view(text), needles, &split));
+    TEST_ASSERT_EQUAL_size_t(13, split.count);
+    // "\xE2" alone is not valid UTF-8, so the tokens are checked one by one
+    TEST_ASSERT_FALSE(split.known_valid);
+    split_destroy(&split);
+    multi_needle_destroy(needles);
+  }
+}
+
+void test_string_delim_any_splits_once(void) {
+  static const char* const delims[] = {"\r\n", "\n", " — "};
+  c_string_multi_needle* needles = compile(delims, 3);
+  const char* text = "first\r\nsecond\nthird — fourth\n";
+  CStringResult s = string_from_char(text, (int)strlen(text));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, s.status);
+
+  c_string** tokens = string_delim_any(s.value, needles);
+  TEST_ASSERT_NOT_NULL(tokens);
+  static const char* const expected[] = {"first", "second", "third", "fourth",
+                                         ""};
+  for (size_t i = 0; i < 5; i++) {
+    TEST_ASSERT_NOT_NULL(tokens[i]);
+    TEST_ASSERT_EQUAL_size_t(strlen(expected[i]), tokens[i]->length);
+    TEST_ASSERT_EQUAL_MEMORY(expected[i], tokens[i]->string,
+                             tokens[i]->length);
+    TEST_ASSERT_TRUE(tokens[i]->utf8_valid);
+  }
+  TEST_ASSERT_NULL(tokens[5]);
+  destroy_delim_string(tokens);
+
+  // The string_ form keeps its own copy of the bytes
+  c_string_split split;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_split_any(s.value, needles, &split));
+  TEST_ASSERT_TRUE(split.data != s.value->string);
+  TEST_ASSERT_EQUAL_size_t(5, split.count);
+  TEST_ASSERT_EQUAL_MEMORY("third", split_get(&split, 2).data, 5);
+  split_destroy(&split);
+
+  destroy_string(s.value);
+  multi_needle_destroy(needles);
+}
+
+void test_multi_needle_rejects_bad_arguments(void) {
+  c_string_multi_needle* needles = NULL;
+  static const char* const with_null[] = {"a", NULL};
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        multi_needle_compile(with_null, 2, &needles));
+  TEST_ASSERT_NULL(needles);
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        multi_needle_compile(NULL, 1, &needles));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        multi_needle_compile(with_null, 1, NULL));
+
+  // No patterns, or only empty ones, never match
+  static const char* const empty[] = {""};
+  needles = compile(empty, 1);
+  TEST_ASSERT_EQUAL_size_t(
+      CSTRING_NPOS, view_find_any(literal_view("abc"), needles, 0, NULL));
+  c_string_split split;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        view_split_any(literal_view("abc"), needles, &split));
+  TEST_ASSERT_EQUAL_size_t(1, split.count);
+  TEST_ASSERT_EQUAL_size_t(3, split_get(&split, 0).length);
+  split_destroy(&split);
+  multi_needle_destroy(needles);
+
+  needles = compile(NULL, 0);
+  TEST_ASSERT_EQUAL_size_t(
+      CSTRING_NPOS, view_find_any(literal_view("abc"), needles, 0, NULL));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        view_split_any(literal_view("abc"), NULL, &split));
+  TEST_ASSERT_NULL(string_delim_any(NULL, needles));
+  multi_needle_destroy(needles);
+}
@@ -0,0 +1,192 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+#if CSTRING_HAVE_THREADS
+#include <pthread.h>
+#endif
+
+#define THREAD_COUNT 8
+#define WORD_COUNT 2000
+
+static c_string_view literal_view(const char* literal) {
+  c_string_view view;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        view_from_char(literal, strlen(literal), &view));
+  return view;
+}
+
+// "word-<n>" in `buffer`
+static c_string_view numbered_word(char* buffer, size_t n) {
+  memcpy(buffer, "word-", 5);
+  size_t length = 5 + format_uint64(n, buffer + 5);
+  c_string_view view = {buffer, length, length, true};
+  return view;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_equal_bytes_share_one_string(void) {
+  c_string_intern_pool pool;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, intern_pool_init(&pool));
+
+  const c_string* first = NULL;
+  const c_string* second = NULL;
+  const c_string* other = NULL;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        intern_pool_get(&pool, literal_view("día"), &first));
+  // A different buffer with the same bytes
+  char copy[] = "día";
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        intern_pool_get(&pool, literal_view(copy), &second));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        intern_pool_get(&pool, literal_view("dia"), &other));
+
+  TEST_ASSERT_TRUE(first == second);
+  TEST_ASSERT_TRUE(first != other);
+  TEST_ASSERT_EQUAL_size_t(4, first->length);
+  TEST_ASSERT_EQUAL_size_t(3, first->codepoint_length);
+  TEST_ASSERT_EQUAL_MEMORY("día", first->string, 4);
+
+  c_string_intern_stats stats;
+  intern_pool_stats(&pool, &stats);
+  TEST_ASSERT_EQUAL_size_t(2, stats.strings);
+  TEST_ASSERT_EQUAL_size_t(1, stats.hits);
+  TEST_ASSERT_EQUAL_size_t(2, stats.misses);
+  TEST_ASSERT_EQUAL_size_t(7, stats.string_bytes);
+  TEST_ASSERT_TRUE(stats.memory_bytes > stats.string_bytes);
+
+  intern_pool_destroy(&pool);
+}
+
+void test_pool_keeps_strings_across_growth(void) {
+  c_string_intern_pool pool;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, intern_pool_init(&pool));
+
+  char buffer[32];
+  const c_string* seen[WORD_COUNT];
+  for (size_t i = 0; i < WORD_COUNT; i++) {
+    TEST_ASSERT_EQUAL_INT(
+        CSTRING_OK, intern_pool_get(&pool, numbered_word(buffer, i), &seen[i]));
+  }
+  for (size_t i = 0; i < WORD_COUNT; i++) {
+    const c_string* again = NULL;
+    TEST_ASSERT_EQUAL_INT(
+        CSTRING_OK, intern_pool_get(&pool, numbered_word(buffer, i), &again));
+    TEST_ASSERT_TRUE(seen[i] == again);
+  }
+
+  c_string_intern_stats stats;
+  intern_pool_stats(&pool, &stats);
+  TEST_ASSERT_EQUAL_size_t(WORD_COUNT, stats.strings);
+  TEST_ASSERT_EQUAL_size_t(WORD_COUNT, stats.hits);
+  TEST_ASSERT_EQUAL_size_t(WORD_COUNT, stats.misses);
+
+  intern_pool_destroy(&pool);
+}
+
+void test_pool_rejects_bad_input(void) {
+  c_string_intern_pool pool;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, intern_pool_init(&pool));
+
+  const c_string* out = NULL;
+  const char bad[] = {'a', (char)0xC3};
+  c_string_view invalid = {bad, sizeof(bad), 0, false};
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_UTF8,
+                        intern_pool_get(&pool, invalid, &out));
+  c_string_view missing = {NULL, 3, 3, true};
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        intern_pool_get(&pool, missing, &out));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        intern_pool_get(&pool, literal_view("a"), NULL));
+
+  c_string_intern_stats stats;
+  intern_pool_stats(&pool, &stats);
+  TEST_ASSERT_EQUAL_size_t(0, stats.strings);
+  TEST_ASSERT_EQUAL_size_t(0, stats.misses);
+
+  intern_pool_destroy(&pool);
+}
+
+#if CSTRING_HAVE_THREADS
+typedef struct {
+  c_string_shared_intern_pool* pool;
+  size_t first;  // each thread starts at a different word
+  const c_string* seen[WORD_COUNT];
+  bool failed;
+} intern_task;
+
+static void* intern_words(void* arg) {
+  intern_task* task = arg;
+  char buffer[32];
+  for (size_t i = 0; i < WORD_COUNT; i++) {
+    size_t n = (task->first + i) % WORD_COUNT;
+    if (shared_intern_pool_get(task->pool, numbered_word(buffer, n),
+                               &task->seen[n]) != CSTRING_OK) {
+      task->failed = true;
+    }
+  }
+  return NULL;
+}
+#endif
+
+void test_shared_pool_agrees_across_threads(void) {
+#if CSTRING_HAVE_THREADS
+  c_string_shared_intern_pool pool;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, shared_intern_pool_init(&pool, 5));
+  TEST_ASSERT_EQUAL_size_t(8, pool.stripe_count);
+
+  static intern_task tasks[THREAD_COUNT];
+  pthread_t threads[THREAD_COUNT];
+  for (size_t t = 0; t < THREAD_COUNT; t++) {
+    tasks[t].pool = &pool;
+    tasks[t].first = t * (WORD_COUNT / THREAD_COUNT);
+    tasks[t].failed = false;
+    TEST_ASSERT_EQUAL_INT(
+        0, pthread_create(&threads[t], NULL, intern_words, &tasks[t]));
+  }
+  for (size_t t = 0; t < THREAD_COUNT; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  for (size_t t = 0; t < THREAD_COUNT; t++) {
+    TEST_ASSERT_FALSE(tasks[t].failed);
+    for (size_t i = 0; i < WORD_COUNT; i++) {
+      TEST_ASSERT_TRUE(tasks[t].seen[i] == tasks[0].seen[i]);
+    }
+  }
+
+  c_string_intern_stats stats;
+  shared_intern_pool_stats(&pool, &stats);
+  TEST_ASSERT_EQUAL_size_t(WORD_COUNT, stats.strings);
+  TEST_ASSERT_EQUAL_size_t(WORD_COUNT, stats.misses);
+  TEST_ASSERT_EQUAL_size_t((THREAD_COUNT - 1) * WORD_COUNT, stats.hits);
+
+  shared_intern_pool_destroy(&pool);
+  TEST_ASSERT_NULL(pool.stripes);
+#else
+  TEST_IGNORE_MESSAGE("built without threads");
+#endif
+}
+
+void test_shared_pool_rejects_bad_arguments(void) {
+  c_string_shared_intern_pool pool;
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        shared_intern_pool_init(NULL, 0));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        shared_intern_pool_init(&pool, 4096));
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, shared_intern_pool_init(&pool, 0));
+  TEST_ASSERT_EQUAL_size_t(16, pool.stripe_count);
+  const c_string* out = NULL;
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        shared_intern_pool_get(&pool, literal_view("x"), NULL));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        shared_intern_pool_get(&pool, literal_view(""), &out));
+  TEST_ASSERT_EQUAL_size_t(0, out->length);
+  shared_intern_pool_destroy(&pool);
+}
@@ -0,0 +1,163 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+static FILE* file;
+
+static FILE* file_with(const char* contents, size_t length) {
+  FILE* f = tmpfile();
+  TEST_ASSERT_NOT_NULL(f);
+  TEST_ASSERT_EQUAL_size_t(length, fwrite(contents, 1, length, f));
+  rewind(f);
+  return f;
+}
+
+void setUp(void) { file = NULL; }
+
+void tearDown(void) {
+  if (file) {
+    fclose(file);
+  }
+}
+
+static void assert_line(c_string_reader* r, const char* expected) {
+  c_string_view line;
+  TEST_ASSERT_TRUE(reader_next_line(r, &line));
+  TEST_ASSERT_EQUAL_size_t(strlen(expected), line.length);
+  TEST_ASSERT_EQUAL_MEMORY(expected, line.data, line.length);
+  TEST_ASSERT_TRUE(line.utf8_valid);
+}
+
+void test_reader_splits_lines_and_strips_terminators(void) {
+  const char contents[] = "first\r\n\nthird line\nlast without newline";
+  file = file_with(contents, sizeof(contents) - 1);
+
+  c_string_reader r;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, reader_init_file(&r, file, 0));
+  assert_line(&r, "first");
+  assert_line(&r, "");
+  assert_line(&r, "third line");
+  assert_line(&r, "last without newline");
+  TEST_ASSERT_FALSE(reader_next_line(&r, NULL));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, r.status);
+  TEST_ASSERT_EQUAL_size_t(4, r.line_number);
+  reader_destroy(&r);
+}
+
+void test_reader_handles_lines_longer_than_the_buffer(void) {
+  char contents[3000];
+  size_t length = 0;
+  for (size_t line = 0; line < 20; line++) {
+    size_t width = (line * 53) % 140;
+    memset(contents + length, (char)('a' + line), width);
+    length += width;
+    contents[length++] = '\n';
+  }
+  file = file_with(contents, length);
+
+  c_string_reader r;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, reader_init_fd(&r, fileno(file), 8));
+  for (size_t line = 0; line < 20; line++) {
+    c_string_view view;
+    TEST_ASSERT_TRUE(reader_next_line(&r, &view));
+    TEST_ASSERT_EQUAL_size_t((line * 53) % 140, view.length);
+    for (size_t i = 0; i < view.length; i++) {
+      TEST_ASSERT_EQUAL_INT((int)('a' + line), view.data[i]);
+    }
+  }
+  TEST_ASSERT_FALSE(reader_next_line(&r, NULL));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, r.status);
+  reader_destroy(&r);
+}
+
+void test_reader_validates_utf8_per_line(void) {
+  const char contents[] = "día\n\xC3\x28\n🧊 ok\n";
+  file = file_with(contents, sizeof(contents) - 1);
+
+  c_string_reader r;
+  c_string_view line;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, reader_init_file(&r, file, 4));
+
+  TEST_ASSERT_TRUE(reader_next_line(&r, &line));
+  TEST_ASSERT_TRUE(line.utf8_valid);
+  TEST_ASSERT_EQUAL_size_t(3, line.codepoint_length);
+
+  TEST_ASSERT_TRUE(reader_next_line(&r, &line));
+  TEST_ASSERT_FALSE(line.utf8_valid);
+
+  TEST_ASSERT_TRUE(reader_next_line(&r, &line));
+  TEST_ASSERT_TRUE(line.utf8_valid);
+  TEST_ASSERT_EQUAL_size_t(4, line.codepoint_length);
+
+  reader_destroy(&r);
+}
+
+void test_reader_reuses_the_target_string(void) {
+  const char contents[] = "a line long enough to leave the inline buffer\n"
+                          "short\n";
+  file = file_with(contents, sizeof(contents) - 1);
+
+  c_string_reader r;
+  CStringResult line = initialize_buffer(0);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, line.status);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, reader_init_file(&r, file, 0));
+
+  TEST_ASSERT_TRUE(reader_next_line_string(&r, line.value));
+  TEST_ASSERT_EQUAL_size_t(45, line.value->length);
+  char* buffer = string_data(line.value);
+
+  TEST_ASSERT_TRUE(reader_next_line_string(&r, line.value));
+  TEST_ASSERT_TRUE(string_data(line.value) == buffer);
+  TEST_ASSERT_EQUAL_size_t(5, line.value->length);
+  TEST_ASSERT_EQUAL_MEMORY("short", buffer, 5);
+  TEST_ASSERT_EQUAL_size_t(5, line.value->codepoint_length);
+
+  TEST_ASSERT_FALSE(reader_next_line_string(&r, line.value));
+  reader_destroy(&r);
+  destroy_string(line.value);
+}
+
+void test_reader_reports_read_failures(void) {
+  int fds[2];
+  TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+  close(fds[1]);
+  close(fds[0]);
+
+  c_string_reader r;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, reader_init_fd(&r, fds[0], 0));
+  TEST_ASSERT_FALSE(reader_next_line(&r, NULL));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_IO, r.status);
+  reader_destroy(&r);
+}
+
+void test_scan_string_reads_one_line_from_stdin(void) {
+  char path[] = "/tmp/c_string_scanXXXXXX";
+  int fd = mkstemp(path);
+  TEST_ASSERT_TRUE(fd >= 0);
+  const char contents[] = "first ñ\r\nsecond\n";
+  TEST_ASSERT_EQUAL_INT((int)(sizeof(contents) - 1),
+                        (int)write(fd, contents, sizeof(contents) - 1));
+  close(fd);
+  TEST_ASSERT_NOT_NULL(freopen(path, "r", stdin));
+
+  CStringResult s = initialize_buffer(0);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, scan_string(s.value, NULL));
+  TEST_ASSERT_EQUAL_size_t(8, s.value->length);
+  TEST_ASSERT_EQUAL_MEMORY("first ñ", string_data(s.value), 8);
+  TEST_ASSERT_EQUAL_size_t(7, s.value->codepoint_length);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, scan_string(s.value, NULL));
+  TEST_ASSERT_EQUAL_MEMORY("second", string_data(s.value), 6);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_IO, scan_string(s.value, NULL));
+  TEST_ASSERT_EQUAL_size_t(0, s.value->length);
+
+  destroy_string(s.value);
+  remove(path);
+}
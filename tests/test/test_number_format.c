@@ -0,0 +1,165 @@
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void assert_int64_matches_printf(int64_t value) {
+  char expected[32];
+  char actual[CSTRING_INT_BUFFER_SIZE];
+  snprintf(expected, sizeof(expected), "%" PRId64, value);
+
+  TEST_ASSERT_EQUAL_size_t(strlen(expected), format_int64(value, actual));
+  TEST_ASSERT_EQUAL_STRING(expected, actual);
+}
+
+static void assert_uint64_matches_printf(uint64_t value) {
+  char expected[32];
+  char actual[CSTRING_INT_BUFFER_SIZE];
+  snprintf(expected, sizeof(expected), "%" PRIu64, value);
+
+  TEST_ASSERT_EQUAL_size_t(strlen(expected), format_uint64(value, actual));
+  TEST_ASSERT_EQUAL_STRING(expected, actual);
+}
+
+static void assert_double_round_trips(double value) {
+  char buffer[CSTRING_DOUBLE_BUFFER_SIZE];
+  size_t length = format_double(value, buffer);
+
+  TEST_ASSERT_EQUAL_size_t(strlen(buffer), length);
+  double parsed = strtod(buffer, NULL);
+  TEST_ASSERT_EQUAL_MEMORY(&value, &parsed, sizeof(value));
+}
+
+void test_format_integers_match_printf_at_the_edges(void) {
+  const int64_t signed_values[] = {0,         1,         -1,        9,
+                                   10,        99,        100,       -100,
+                                   12345,     INT32_MAX, INT32_MIN, INT64_MAX,
+                                   INT64_MIN, 999999999, 1000000000};
+  for (size_t i = 0; i < sizeof(signed_values) / sizeof(signed_values[0]);
+       i++) {
+    assert_int64_matches_printf(signed_values[i]);
+  }
+
+  assert_uint64_matches_printf(0);
+  assert_uint64_matches_printf(UINT64_MAX);
+
+  uint64_t power = 1;
+  for (int i = 0; i < 19; i++) {
+    assert_uint64_matches_printf(power - 1);
+    assert_uint64_matches_printf(power);
+    power *= 10;
+  }
+
+  char buffer[CSTRING_INT_BUFFER_SIZE];
+  TEST_ASSERT_EQUAL_size_t(11, format_int32(INT32_MIN, buffer));
+  TEST_ASSERT_EQUAL_STRING("-2147483648", buffer);
+}
+
+void test_format_double_picks_shortest_digits(void) {
+  char buffer[CSTRING_DOUBLE_BUFFER_SIZE];
+
+  format_double(0.1, buffer);
+  TEST_ASSERT_EQUAL_STRING("0.1", buffer);
+  format_double(0.1 + 0.2, buffer);
+  TEST_ASSERT_EQUAL_STRING("0.30000000000000004", buffer);
+  format_double(1.5, buffer);
+  TEST_ASSERT_EQUAL_STRING("1.5", buffer);
+  format_double(-42.0, buffer);
+  TEST_ASSERT_EQUAL_STRING("-42", buffer);
+  format_double(1e21, buffer);
+  TEST_ASSERT_EQUAL_STRING("1e+21", buffer);
+  format_double(1e20, buffer);
+  TEST_ASSERT_EQUAL_STRING("100000000000000000000", buffer);
+  format_double(0.000001, buffer);
+  TEST_ASSERT_EQUAL_STRING("0.000001", buffer);
+  format_double(1.25e-7, buffer);
+  TEST_ASSERT_EQUAL_STRING("1.25e-7", buffer);
+  format_double(5e-324, buffer);
+  TEST_ASSERT_EQUAL_STRING("5e-324", buffer);
+  format_double(1.7976931348623157e308, buffer);
+  TEST_ASSERT_EQUAL_STRING("1.7976931348623157e+308", buffer);
+}
+
+void test_format_double_special_values(void) {
+  char buffer[CSTRING_DOUBLE_BUFFER_SIZE];
+
+  format_double(0.0, buffer);
+  TEST_ASSERT_EQUAL_STRING("0", buffer);
+  format_double(-0.0, buffer);
+  TEST_ASSERT_EQUAL_STRING("-0", buffer);
+  format_double(1.0 / 0.0, buffer);
+  TEST_ASSERT_EQUAL_STRING("inf", buffer);
+  format_double(-1.0 / 0.0, buffer);
+  TEST_ASSERT_EQUAL_STRING("-inf", buffer);
+  format_double(0.0 / 0.0, buffer);
+  TEST_ASSERT_EQUAL_STRING("nan", buffer);
+}
+
+void test_format_double_round_trips_random_bit_patterns(void) {
+  uint64_t state = UINT64_C(0x9E3779B97F4A7C15);
+
+  for (int i = 0; i < 200000; i++) {
+    // xorshift64
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    double value;
+    memcpy(&value, &state, sizeof(value));
+    if (value != value || value - value != 0.0) {
+      continue;
+    }
+    assert_double_round_trips(value);
+  }
+}
+
+void test_int_to_string_builds_valid_ascii(void) {
+  CStringResult result = int_to_string(-2048);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_EQUAL_size_t(5, result.value->length);
+  TEST_ASSERT_EQUAL_MEMORY("-2048", result.value->string, 5);
+  TEST_ASSERT_EQUAL_size_t(5, result.value->codepoint_length);
+  TEST_ASSERT_TRUE(result.value->utf8_valid);
+
+  destroy_string(result.value);
+}
+
+void test_double_to_string_shortest_in_arena(void) {
+  c_string_arena arena;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, arena_init(&arena, 0));
+
+  CStringResult result = double_to_string_shortest_in(&arena, 2.5e-3);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_EQUAL_size_t(6, result.value->length);
+  TEST_ASSERT_EQUAL_MEMORY("0.0025", result.value->string, 6);
+
+  arena_destroy(&arena);
+}
+
+void test_builder_appends_numbers(void) {
+  c_string_builder builder;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_init(&builder, 0));
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_append_int64(&builder, -7));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_append_char(&builder, ' '));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_append_uint64(&builder, 18));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_append_char(&builder, ' '));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_append_double(&builder, 0.5));
+
+  CStringResult result = builder_finish(&builder);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_EQUAL_MEMORY("-7 18 0.5", result.value->string, 9);
+  TEST_ASSERT_EQUAL_size_t(9, result.value->length);
+
+  destroy_string(result.value);
+}
@@ -0,0 +1,219 @@
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static c_string_view view_of(const char* text) {
+  c_string_view v = {0};
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, view_from_char(text, strlen(text), &v));
+  return v;
+}
+
+static void assert_double_parses_like_strtod(const char* text) {
+  double parsed = 0.0;
+  double expected = strtod(text, NULL);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, view_to_double(view_of(text), &parsed));
+  TEST_ASSERT_EQUAL_MEMORY(&expected, &parsed, sizeof(expected));
+}
+
+void test_view_to_int64_parses_edges(void) {
+  int64_t value = 0;
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, view_to_int64(view_of("0"), &value));
+  TEST_ASSERT_EQUAL_INT64(0, value);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, view_to_int64(view_of("-42"), &value));
+  TEST_ASSERT_EQUAL_INT64(-42, value);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, view_to_int64(view_of("+1234567890123"),
+                                                  &value));
+  TEST_ASSERT_EQUAL_INT64(1234567890123, value);
+  TEST_ASSERT_EQUAL_INT(
+      CSTRING_OK, view_to_int64(view_of("9223372036854775807"), &value));
+  TEST_ASSERT_EQUAL_INT64(INT64_MAX, value);
+  TEST_ASSERT_EQUAL_INT(
+      CSTRING_OK, view_to_int64(view_of("-9223372036854775808"), &value));
+  TEST_ASSERT_EQUAL_INT64(INT64_MIN, value);
+  TEST_ASSERT_EQUAL_INT(
+      CSTRING_OK, view_to_int64(view_of("-0000000000000000000000042"), &value));
+  TEST_ASSERT_EQUAL_INT64(-42, value);
+}
+
+void test_view_to_int64_reports_overflow_and_bad_input(void) {
+  int64_t value = 7;
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_OVERFLOW,
+                        view_to_int64(view_of("9223372036854775808"), &value));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_OVERFLOW,
+                        view_to_int64(view_of("-9223372036854775809"), &value));
+  TEST_ASSERT_EQUAL_INT(
+      CSTRING_ERR_OVERFLOW,
+      view_to_int64(view_of("123456789012345678901234567890"), &value));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        view_to_int64(view_of(""), &value));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        view_to_int64(view_of("-"), &value));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        view_to_int64(view_of(" 12"), &value));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        view_to_int64(view_of("1234567x"), &value));
+  TEST_ASSERT_EQUAL_INT(
+      CSTRING_ERR_INVALID_ARG,
+      view_to_int64(view_of("12345678901234567890x"), &value));
+  TEST_ASSERT_EQUAL_INT64(7, value);
+}
+
+void test_view_to_uint64_matches_strtoull(void) {
+  uint64_t value = 0;
+  char text[32];
+  uint64_t state = UINT64_C(0x2545F4914F6CDD1D);
+
+  TEST_ASSERT_EQUAL_INT(
+      CSTRING_OK, view_to_uint64(view_of("18446744073709551615"), &value));
+  TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, value);
+  TEST_ASSERT_EQUAL_INT(
+      CSTRING_ERR_OVERFLOW,
+      view_to_uint64(view_of("18446744073709551616"), &value));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        view_to_uint64(view_of("-1"), &value));
+
+  for (int i = 0; i < 10000; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    uint64_t expected = state >> (i % 64);
+
+    format_uint64(expected, text);
+    TEST_ASSERT_EQUAL_INT(CSTRING_OK, view_to_uint64(view_of(text), &value));
+    TEST_ASSERT_EQUAL_UINT64(expected, value);
+  }
+}
+
+void test_string_to_int_checks_int_range(void) {
+  int value = 0;
+  CStringResult max = string_from_char("2147483647", 10);
+  CStringResult past = string_from_char("2147483648", 10);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_to_int(max.value, &value));
+  TEST_ASSERT_EQUAL_INT(INT_MAX, value);
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_OVERFLOW,
+                        string_to_int(past.value, &value));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG, string_to_int(NULL, &value));
+
+  destroy_string(max.value);
+  destroy_string(past.value);
+}
+
+void test_view_to_double_parses_without_null_terminator(void) {
+  const char text[] = "3.25e2,rest";
+  c_string_view v = view_of(text);
+  c_string_view number = {0};
+  c_string_view rest = {0};
+  double value = 0.0;
+
+  TEST_ASSERT_TRUE(view_split_once(v, ",", &number, &rest));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, view_to_double(number, &value));
+  TEST_ASSERT_EQUAL_DOUBLE(325.0, value);
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG, view_to_double(v, &value));
+}
+
+void test_view_to_double_matches_strtod(void) {
+  const char* cases[] = {
+      "0",
+      "-0.0",
+      "1",
+      ".5",
+      "5.",
+      "0.1",
+      "3.14159265358979323846",
+      "1e22",
+      "1e23",
+      "12e30",
+      "9007199254740993",
+      "123456789012345678901234567890",
+      "2.2250738585072011e-308",
+      "2.2250738585072014e-308",
+      "4.9e-324",
+      "2.4703282292062328e-324",
+      "1.7976931348623157e308",
+      "0.000000000000000000000000000000000000001",
+      "1e-400",
+      "1E+5",
+      "100000000000000000000000000000000000000000000000000000000000000",
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    assert_double_parses_like_strtod(cases[i]);
+  }
+}
+
+void test_view_to_double_round_trips_random_bit_patterns(void) {
+  char text[CSTRING_DOUBLE_BUFFER_SIZE];
+  uint64_t state = UINT64_C(0x9E3779B97F4A7C15);
+
+  for (int i = 0; i < 100000; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    double expected;
+    memcpy(&expected, &state, sizeof(expected));
+    if (expected != expected || expected - expected != 0.0) {
+      continue;
+    }
+
+    double parsed = 0.0;
+    format_double(expected, text);
+    TEST_ASSERT_EQUAL_INT(CSTRING_OK, view_to_double(view_of(text), &parsed));
+    TEST_ASSERT_EQUAL_MEMORY(&expected, &parsed, sizeof(expected));
+  }
+}
+
+void test_view_to_double_long_mantissa_keeps_halfway_rounding(void) {
+  // Exactly halfway between 1 and the next double, then nudged above it by a
+  // digit far past the 768-digit cut-off.
+  char text[900];
+  const char* halfway =
+      "1.00000000000000011102230246251565404236316680908203125";
+  size_t length = strlen(halfway);
+  memcpy(text, halfway, length);
+  memset(text + length, '0', 800);
+  text[length + 800] = '1';
+  text[length + 801] = '\0';
+
+  assert_double_parses_like_strtod(halfway);
+  assert_double_parses_like_strtod(text);
+}
+
+void test_view_to_double_special_values_and_errors(void) {
+  double value = 1.0;
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        view_to_double(view_of("-Infinity"), &value));
+  TEST_ASSERT_TRUE(isinf(value) && value < 0);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, view_to_double(view_of("NaN"), &value));
+  TEST_ASSERT_TRUE(isnan(value));
+
+  value = 1.0;
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_OVERFLOW,
+                        view_to_double(view_of("1e309"), &value));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_OVERFLOW,
+                        view_to_double(view_of("-1e99999999999"), &value));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        view_to_double(view_of("."), &value));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        view_to_double(view_of("1e"), &value));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        view_to_double(view_of("1.5x"), &value));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        view_to_double(view_of("infinit"), &value));
+  TEST_ASSERT_EQUAL_DOUBLE(1.0, value);
+}
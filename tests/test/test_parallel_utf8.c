@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+// Four chunks of PARALLEL_UTF8_MIN_CHUNK (256 KiB) each
+#define BUFFER_SIZE ((size_t)1024 * 1024)
+#define THREADS 4
+
+static const char* sequences[] = {"a", "é", "€", "🧊", "z", "\xF4\x8F\xBF\xBF"};
+
+static char* buffer;
+static size_t buffer_codepoints;
+
+// Fill the buffer with a mix of 1-4 byte sequences so that the chunk
+// boundaries land in the middle of multi-byte sequences.
+static void fill_buffer(void) {
+  size_t length = 0;
+  size_t index = 0;
+  buffer_codepoints = 0;
+  while (length < BUFFER_SIZE) {
+    const char* sequence = sequences[index++ % 6];
+    size_t size = strlen(sequence);
+    if (length + size > BUFFER_SIZE) {
+      sequence = "a";
+      size = 1;
+    }
+    memcpy(buffer + length, sequence, size);
+    length += size;
+    buffer_codepoints += 1;
+  }
+}
+
+void setUp(void) {
+  buffer = malloc(BUFFER_SIZE);
+  TEST_ASSERT_NOT_NULL(buffer);
+  fill_buffer();
+  cstring_set_parallel_threshold(1);
+  cstring_set_thread_count(THREADS);
+}
+
+void tearDown(void) {
+  free(buffer);
+  cstring_set_parallel_threshold((size_t)8 * 1024 * 1024);
+  cstring_set_thread_count(0);
+}
+
+// Validate the buffer with `threads` threads and return the status.
+static CStringStatus validate(size_t threads, size_t* codepoints,
+                              size_t* error_offset) {
+  cstring_set_thread_count(threads);
+  CStringStatus status =
+      cstring_validate_utf8(buffer, BUFFER_SIZE, codepoints, error_offset);
+  cstring_set_thread_count(THREADS);
+  return status;
+}
+
+static void expect_error_at(size_t expected) {
+  size_t serial_offset = 0;
+  size_t parallel_offset = 0;
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_UTF8,
+                        validate(1, NULL, &serial_offset));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_UTF8,
+                        validate(THREADS, NULL, &parallel_offset));
+  TEST_ASSERT_EQUAL_size_t(expected, serial_offset);
+  TEST_ASSERT_EQUAL_size_t(expected, parallel_offset);
+}
+
+void test_parallel_count_matches_the_serial_count(void) {
+  size_t serial = 0;
+  size_t parallel = 0;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, validate(1, &serial, NULL));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, validate(THREADS, &parallel, NULL));
+  TEST_ASSERT_EQUAL_size_t(buffer_codepoints, serial);
+  TEST_ASSERT_EQUAL_size_t(buffer_codepoints, parallel);
+
+  CStringResult s = string_from_char(buffer, (int)BUFFER_SIZE);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, s.status);
+  TEST_ASSERT_EQUAL_size_t(buffer_codepoints, s.value->codepoint_length);
+  destroy_string(s.value);
+}
+
+void test_parallel_reports_the_first_error(void) {
+  // A stray continuation byte in the third chunk, then another in the first
+  buffer[BUFFER_SIZE / 2 + 100] = '\x80';
+  buffer[BUFFER_SIZE / 2 + 101] = '\x80';
+  buffer[BUFFER_SIZE / 2 + 102] = '\x80';
+  buffer[BUFFER_SIZE / 2 + 103] = '\x80';
+  expect_error_at(BUFFER_SIZE / 2 + 100);
+
+  buffer[1000] = '\xFF';
+  expect_error_at(1000);
+}
+
+void test_parallel_errors_next_to_chunk_boundaries(void) {
+  for (size_t boundary = 1; boundary < THREADS; boundary++) {
+    for (size_t delta = 0; delta < 8; delta++) {
+      fill_buffer();
+      size_t offset = BUFFER_SIZE / THREADS * boundary - 4 + delta;
+      // A lead byte whose continuation bytes are missing
+      buffer[offset] = '\xE2';
+      buffer[offset + 1] = 'x';
+
+      size_t serial_offset = 0;
+      size_t parallel_offset = 0;
+      TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_UTF8,
+                            validate(1, NULL, &serial_offset));
+      TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_UTF8,
+                            validate(THREADS, NULL, &parallel_offset));
+      TEST_ASSERT_EQUAL_size_t(serial_offset, parallel_offset);
+      TEST_ASSERT_TRUE(serial_offset <= offset);
+    }
+  }
+}
+
+void test_parallel_handles_continuation_runs_across_a_boundary(void) {
+  size_t boundary = BUFFER_SIZE / THREADS;
+  memset(buffer + boundary - 4, 'a', 8);
+  memset(buffer + boundary - 2, '\x80', 5);
+  expect_error_at(boundary - 2);
+}
+
+void test_validate_rejects_null_data(void) {
+  size_t codepoints = 7;
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        cstring_validate_utf8(NULL, 3, &codepoints, NULL));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        cstring_validate_utf8(NULL, 0, &codepoints, NULL));
+  TEST_ASSERT_EQUAL_size_t(0, codepoints);
+}
@@ -0,0 +1,292 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+#define NO_MATCH CSTRING_NPOS
+
+typedef struct {
+  const char* pattern;
+  const char* text;
+  size_t start;  // NO_MATCH when the pattern must not match
+  size_t end;
+} find_case;
+
+static c_string_view literal_view(const char* literal) {
+  c_string_view view;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        view_from_char(literal, strlen(literal), &view));
+  return view;
+}
+
+static c_string_regex* compile(const char* pattern) {
+  c_string_regex* re = NULL;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, regex_compile(pattern, &re));
+  TEST_ASSERT_NOT_NULL(re);
+  return re;
+}
+
+static void expect_finds(const find_case* cases, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    c_string_regex* re = compile(cases[i].pattern);
+    c_string_span match;
+    bool found = view_regex_find(re, literal_view(cases[i].text), 0, &match);
+    TEST_ASSERT_EQUAL_INT(cases[i].start != NO_MATCH, found);
+    if (found) {
+      TEST_ASSERT_EQUAL_size_t(cases[i].start, match.offset);
+      TEST_ASSERT_EQUAL_size_t(cases[i].end - cases[i].start, match.length);
+    }
+    regex_destroy(re);
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_regex_matches_basic_syntax(void) {
+  static const find_case cases[] = {
+      {"needle", "haystack with a needle", 16, 22},
+      {"b+", "aabbbc", 2, 5},
+      {"ab*c", "xac", 1, 3},
+      {"colou?r", "the color", 4, 9},
+      {"a{2,3}", "a aa aaaa", 2, 4},
+      {"a{2}", "aaaa", 0, 2},
+      {"a{2,}", "caaaa", 1, 5},
+      {"x{0}y", "xy", 1, 2},
+      {"[0-9]+", "id=4711;", 3, 7},
+      {"[^a-z ]", "all lower but X", 14, 15},
+      {"\\d+\\.\\d+", "pi is 3.14", 6, 10},
+      {"\\w+", "  snake_case1 ", 2, 13},
+      {"\\s", "no_space\there", 8, 9},
+      {"\\W", "abc!", 3, 4},
+      {"\\x41", "zA", 1, 2},
+      {"[]]", "a]", 1, 2},
+      {"[a-]", "x-", 1, 2},
+      {"(?:ab)+", "xababa", 1, 5},
+      {"cat|dog", "hotdog", 3, 6},
+      {"a.c", "a\nc abc", 4, 7},
+      {"", "abc", 0, 0},
+      {"z", "abc", NO_MATCH, 0},
+  };
+  expect_finds(cases, sizeof(cases) / sizeof(cases[0]));
+}
+
+void test_regex_anchors(void) {
+  static const find_case cases[] = {
+      {"^ab", "abab", 0, 2},     {"^b", "ab", NO_MATCH, 0},
+      {"ab$", "abab", 2, 4},     {"a$", "ab", NO_MATCH, 0},
+      {"^$", "", 0, 0},          {"^a*$", "aaa", 0, 3},
+      {"x|^a", "ba", NO_MATCH, 0}, {"(^|,)b", "a,b", 1, 3},
+  };
+  expect_finds(cases, sizeof(cases) / sizeof(cases[0]));
+
+  // ^ is the start of the text, not of the search
+  c_string_regex* re = compile("^a");
+  TEST_ASSERT_FALSE(view_regex_find(re, literal_view("aa"), 1, NULL));
+  regex_destroy(re);
+}
+
+void test_regex_is_leftmost_first(void) {
+  static const find_case cases[] = {
+      {"a|ab", "ab", 0, 1},        {"ab|a", "ab", 0, 2},
+      {"a+?", "aaa", 0, 1},        {"a*?b", "aab", 0, 3},
+      {"<.*>", "<a><b>", 0, 6},    {"<.*?>", "<a><b>", 0, 3},
+      {"(a|ab)(c|bcd)", "abcd", 0, 4}, {"b|abc", "xabc", 1, 4},
+  };
+  expect_finds(cases, sizeof(cases) / sizeof(cases[0]));
+}
+
+void test_regex_matches_code_points(void) {
+  static const find_case cases[] = {
+      {"d.a", "el día", 3, 7},
+      {"[é-ü]+", "caféü!", 3, 7},
+      {"[^a-z]", "abc東", 3, 6},
+      {"😀{2}", "😀 😀😀", 5, 13},
+      {"東京|大阪", "in 大阪", 3, 9},
+      {"\\w+", "naïve", 0, 2},
+  };
+  expect_finds(cases, sizeof(cases) / sizeof(cases[0]));
+}
+
+void test_regex_find_all_and_empty_matches(void) {
+  c_string_regex* re = compile("\\d+");
+  CStringResult s = string_from_char("a1 22 333 x", 11);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, s.status);
+
+  TEST_ASSERT_EQUAL_size_t(3, string_regex_find_all(re, s.value, NULL, 0));
+  c_string_span matches[3];
+  TEST_ASSERT_EQUAL_size_t(3, string_regex_find_all(re, s.value, matches, 3));
+  TEST_ASSERT_EQUAL_size_t(1, matches[0].offset);
+  TEST_ASSERT_EQUAL_size_t(3, matches[1].offset);
+  TEST_ASSERT_EQUAL_size_t(2, matches[1].length);
+  TEST_ASSERT_EQUAL_size_t(6, matches[2].offset);
+  TEST_ASSERT_EQUAL_size_t(3, matches[2].length);
+
+  c_string_span from_five;
+  TEST_ASSERT_TRUE(string_regex_find(re, s.value, 5, &from_five));
+  TEST_ASSERT_EQUAL_size_t(6, from_five.offset);
+  TEST_ASSERT_FALSE(string_regex_find(re, s.value, 12, NULL));
+  destroy_string(s.value);
+  regex_destroy(re);
+
+  // Empty matches advance by whole code points: "" before the first é, then
+  // "aa", then "" before and after the second é
+  re = compile("a*");
+  c_string_span spans[8];
+  TEST_ASSERT_EQUAL_size_t(
+      4, view_regex_find_all(re, literal_view("éaaé"), spans, 8));
+  TEST_ASSERT_EQUAL_size_t(0, spans[0].length);
+  TEST_ASSERT_EQUAL_size_t(2, spans[1].offset);
+  TEST_ASSERT_EQUAL_size_t(2, spans[1].length);
+  TEST_ASSERT_EQUAL_size_t(4, spans[2].offset);
+  TEST_ASSERT_EQUAL_size_t(0, spans[2].length);
+  TEST_ASSERT_EQUAL_size_t(6, spans[3].offset);
+  regex_destroy(re);
+}
+
+void test_regex_split_and_replace(void) {
+  c_string_regex* re = compile("\\s*[,;]\\s*");
+  const char* text = "a , b;c ;; día";
+  CStringResult s = string_from_char(text, (int)strlen(text));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, s.status);
+
+  c_string_split split;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_regex_split(re, s.value, &split));
+  TEST_ASSERT_TRUE(split.data != s.value->string);
+  const char* expected[] = {"a", "b", "c", "", "día"};
+  TEST_ASSERT_EQUAL_size_t(5, split.count);
+  for (size_t i = 0; i < split.count; i++) {
+    c_string_view token = split_get(&split, i);
+    TEST_ASSERT_EQUAL_size_t(strlen(expected[i]), token.length);
+    TEST_ASSERT_EQUAL_MEMORY(expected[i], token.data, token.length);
+    TEST_ASSERT_TRUE(token.utf8_valid);
+  }
+  TEST_ASSERT_EQUAL_size_t(3, split_get(&split, 4).codepoint_length);
+  split_destroy(&split);
+
+  CStringResult replaced = string_regex_replace(re, s.value, "|");
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, replaced.status);
+  TEST_ASSERT_EQUAL_size_t(strlen("a|b|c||día"), replaced.value->length);
+  TEST_ASSERT_EQUAL_MEMORY("a|b|c||día", replaced.value->string,
+                           replaced.value->length);
+  TEST_ASSERT_EQUAL_size_t(10, replaced.value->codepoint_length);
+  destroy_string(replaced.value);
+  destroy_string(s.value);
+  regex_destroy(re);
+
+  // Inserting between every code point, as the empty matches dictate
+  re = compile("x*");
+  replaced = view_regex_replace(re, literal_view("abxé"), "-");
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, replaced.status);
+  TEST_ASSERT_EQUAL_MEMORY("-a-b--é-", replaced.value->string,
+                           replaced.value->length);
+
+  c_string_view v = literal_view("abxé");
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, view_regex_split(re, v, &split));
+  TEST_ASSERT_TRUE(split.data == v.data);
+  // "", "a", "b", "", "é", ""
+  TEST_ASSERT_EQUAL_size_t(6, split.count);
+  TEST_ASSERT_EQUAL_size_t(0, split_get(&split, 3).length);
+  TEST_ASSERT_EQUAL_size_t(2, split_get(&split, 4).length);
+  split_destroy(&split);
+  destroy_string(replaced.value);
+  regex_destroy(re);
+}
+
+void test_regex_survives_dfa_cache_flushes(void) {
+  // The DFA for this pattern has 2^15 states, far more than the cache keeps
+  c_string_regex* re = compile("a[ab]{14}b");
+  static char text[20000];
+  uint32_t seed = 7;
+  for (size_t i = 0; i < sizeof(text); i++) {
+    seed = seed * 1103515245u + 12345u;
+    text[i] = (seed >> 16) & 1 ? 'a' : 'b';
+  }
+  c_string_view v = {text, sizeof(text), sizeof(text), true};
+
+  size_t from = 0;
+  for (int round = 0; round < 50; round++) {
+    size_t expected = from;
+    while (expected + 16 <= sizeof(text) &&
+           !(text[expected] == 'a' && text[expected + 15] == 'b')) {
+      expected += 1;
+    }
+
+    c_string_span match;
+    bool found = view_regex_find(re, v, from, &match);
+    TEST_ASSERT_EQUAL_INT(expected + 16 <= sizeof(text), found);
+    if (!found) {
+      break;
+    }
+    TEST_ASSERT_EQUAL_size_t(expected, match.offset);
+    TEST_ASSERT_EQUAL_size_t(16, match.length);
+    from = expected + 1 + (size_t)round * 37;
+  }
+  regex_destroy(re);
+}
+
+void test_regex_rejects_bad_patterns(void) {
+  static const char* syntax_errors[] = {"a**", "(a",    "a)",   "[a",
+                                        "x{2,1}", "x{,2}", "\\q", "*a",
+                                        "a{1",  "+"};
+  for (size_t i = 0; i < sizeof(syntax_errors) / sizeof(syntax_errors[0]);
+       i++) {
+    c_string_regex* re = NULL;
+    TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                          regex_compile(syntax_errors[i], &re));
+    TEST_ASSERT_NULL(re);
+  }
+
+  c_string_regex* re = NULL;
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_OVERFLOW,
+                        regex_compile("(a{1000}){1000}", &re));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_OVERFLOW, regex_compile("a{1001}", &re));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_UTF8,
+                        regex_compile("a\xC3", &re));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG, regex_compile(NULL, &re));
+}
+
+void test_regex_compiles_long_patterns_without_recursing(void) {
+  // One node per atom: these chains are far deeper than the stack allows
+  // recursing into
+  size_t length = 100000;
+  char* pattern = malloc(4 * length + 2);
+  TEST_ASSERT_NOT_NULL(pattern);
+  memset(pattern, 'a', length);
+  pattern[length] = '\0';
+  c_string_regex* re = NULL;
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_OVERFLOW, regex_compile(pattern, &re));
+  TEST_ASSERT_NULL(re);
+
+  for (size_t i = 0; i < 2 * length; i++) {
+    pattern[2 * i] = 'a';
+    pattern[2 * i + 1] = '|';
+  }
+  pattern[4 * length - 1] = '\0';
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_OVERFLOW, regex_compile(pattern, &re));
+
+  // Long chains under the program limit still compile and match
+  for (size_t i = 0; i < 20000; i++) {
+    pattern[i] = (char)('a' + i % 7);
+  }
+  pattern[20000] = '\0';
+  re = compile(pattern);
+  TEST_ASSERT_TRUE(view_regex_find(re, literal_view(pattern), 0, NULL));
+  regex_destroy(re);
+
+  for (size_t i = 0; i < 10000; i++) {
+    pattern[2 * i] = (char)('a' + i % 26);
+    pattern[2 * i + 1] = '|';
+  }
+  memcpy(pattern + 20000, "9.\0", 3);
+  re = compile(pattern);
+  c_string_span match;
+  TEST_ASSERT_TRUE(view_regex_find(re, literal_view("..9!"), 0, &match));
+  TEST_ASSERT_EQUAL_size_t(2, match.offset);
+  TEST_ASSERT_EQUAL_size_t(2, match.length);
+  regex_destroy(re);
+  free(pattern);
+}
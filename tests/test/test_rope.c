@@ -0,0 +1,222 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+#define EDIT_COUNT 3000
+#define REFERENCE_CAPACITY (64 * 1024)
+
+static c_string_view literal_view(const char* literal) {
+  c_string_view view;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        view_from_char(literal, strlen(literal), &view));
+  return view;
+}
+
+// Byte offset of code point `index` in valid UTF-8 `data`
+static size_t byte_offset(const char* data, size_t length, size_t index) {
+  size_t offset = 0;
+  while (index > 0 && offset < length) {
+    offset += 1;
+    while (offset < length && ((unsigned char)data[offset] & 0xC0) == 0x80) {
+      offset += 1;
+    }
+    index -= 1;
+  }
+  return offset;
+}
+
+static void expect_rope_equals(const c_string_rope* r, const char* expected,
+                               size_t length) {
+  TEST_ASSERT_EQUAL_size_t(length, rope_length(r));
+
+  CStringResult flat = rope_flatten(r);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, flat.status);
+  TEST_ASSERT_EQUAL_size_t(length, flat.value->length);
+  TEST_ASSERT_EQUAL_MEMORY(expected, flat.value->string, length);
+  TEST_ASSERT_TRUE(flat.value->utf8_valid);
+  TEST_ASSERT_EQUAL_size_t(rope_codepoint_length(r),
+                           flat.value->codepoint_length);
+
+  size_t codepoints = 0;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, cstring_validate_utf8(expected, length,
+                                                         &codepoints, NULL));
+  TEST_ASSERT_EQUAL_size_t(codepoints, rope_codepoint_length(r));
+  destroy_string(flat.value);
+
+  // The chunks cover the same bytes in order, none of them empty
+  c_string_rope_iter it;
+  c_string_view chunk;
+  size_t offset = 0;
+  rope_iter_init(&it, r);
+  while (rope_iter_next(&it, &chunk)) {
+    TEST_ASSERT_TRUE(chunk.length > 0);
+    TEST_ASSERT_TRUE(offset + chunk.length <= length);
+    TEST_ASSERT_EQUAL_MEMORY(expected + offset, chunk.data, chunk.length);
+    offset += chunk.length;
+  }
+  TEST_ASSERT_EQUAL_size_t(length, offset);
+}
+
+static size_t count_chunks(const c_string_rope* r) {
+  c_string_rope_iter it;
+  c_string_view chunk;
+  size_t chunks = 0;
+  rope_iter_init(&it, r);
+  while (rope_iter_next(&it, &chunk)) {
+    chunks += 1;
+  }
+  return chunks;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_rope_round_trips_large_text(void) {
+  const char* line = "naïve café, 東京 — 😀 line\n";
+  size_t line_length = strlen(line);
+  size_t length = 0;
+  char* text = malloc(400 * line_length);
+  for (size_t i = 0; i < 400; i++) {
+    memcpy(text + length, line, line_length);
+    length += line_length;
+  }
+
+  c_string_view v = {text, length, 0, false};
+  c_string_rope r;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, rope_from_view(v, &r));
+  TEST_ASSERT_TRUE(count_chunks(&r) > 1);
+  expect_rope_equals(&r, text, length);
+
+  rope_destroy(&r);
+  TEST_ASSERT_EQUAL_size_t(0, rope_length(&r));
+  free(text);
+}
+
+void test_rope_edits_match_a_flat_buffer(void) {
+  static const char* pieces[] = {"a", "xyz", "é", "東京", "😀!", "",
+                                 "a longer piece of text to insert"};
+  static char reference[REFERENCE_CAPACITY];
+  static char scratch[REFERENCE_CAPACITY];
+  size_t length = 0;
+  uint32_t seed = 12345;
+
+  c_string_rope r;
+  rope_init(&r);
+
+  for (size_t step = 0; step < EDIT_COUNT; step++) {
+    seed = seed * 1103515245u + 12345u;
+    size_t codepoints = rope_codepoint_length(&r);
+    size_t at = codepoints > 0 ? (seed >> 8) % (codepoints + 1) : 0;
+
+    if ((seed >> 4) % 3 != 0 || codepoints == 0) {
+      const char* piece = pieces[(seed >> 12) % 7];
+      size_t piece_length = strlen(piece);
+      TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                            rope_insert(&r, at, literal_view(piece)));
+
+      size_t offset = byte_offset(reference, length, at);
+      memmove(reference + offset + piece_length, reference + offset,
+              length - offset);
+      memcpy(reference + offset, piece, piece_length);
+      length += piece_length;
+    } else {
+      size_t count = (seed >> 16) % 5;
+      if (count > codepoints - at) {
+        count = codepoints - at;
+      }
+      TEST_ASSERT_EQUAL_INT(CSTRING_OK, rope_delete(&r, at, count));
+
+      size_t start = byte_offset(reference, length, at);
+      size_t end = start + byte_offset(reference + start, length - start,
+                                       count);
+      memmove(reference + start, reference + end, length - end);
+      length -= end - start;
+    }
+
+    if (step % 250 == 0) {
+      expect_rope_equals(&r, reference, length);
+
+      // Slicing agrees with the same range of the flat buffer
+      size_t start = rope_codepoint_length(&r) / 3;
+      size_t count = rope_codepoint_length(&r) / 2;
+      c_string_rope slice;
+      TEST_ASSERT_EQUAL_INT(CSTRING_OK, rope_slice(&r, start, count, &slice));
+      size_t from = byte_offset(reference, length, start);
+      size_t to = from + byte_offset(reference + from, length - from, count);
+      memcpy(scratch, reference + from, to - from);
+      expect_rope_equals(&slice, scratch, to - from);
+      rope_destroy(&slice);
+    }
+  }
+
+  expect_rope_equals(&r, reference, length);
+  rope_destroy(&r);
+}
+
+void test_small_inserts_share_leaves(void) {
+  c_string_rope r;
+  rope_init(&r);
+  for (size_t i = 0; i < 5000; i++) {
+    size_t middle = rope_codepoint_length(&r) / 2;
+    TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                          rope_insert(&r, middle, literal_view("ñ")));
+  }
+  TEST_ASSERT_EQUAL_size_t(5000, rope_codepoint_length(&r));
+  TEST_ASSERT_EQUAL_size_t(10000, rope_length(&r));
+  // Without merging this would be one leaf per insert
+  TEST_ASSERT_TRUE(count_chunks(&r) < 100);
+  rope_destroy(&r);
+}
+
+void test_slices_and_concat_share_nodes(void) {
+  c_string_rope r;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        rope_from_view(literal_view("héllo wörld"), &r));
+
+  c_string_rope word;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, rope_slice(&r, 6, 5, &word));
+  rope_destroy(&r);
+  expect_rope_equals(&word, "wörld", 6);
+
+  // Appending a rope to itself leaves the shared tail intact
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, rope_concat(&word, &word));
+  expect_rope_equals(&word, "wörldwörld", 12);
+
+  c_string_rope copy;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, rope_slice(&word, 0, 10, &copy));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, rope_delete(&word, 1, 8));
+  expect_rope_equals(&word, "wd", 2);
+  expect_rope_equals(&copy, "wörldwörld", 12);
+
+  c_string_rope empty;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, rope_slice(&copy, 10, 0, &empty));
+  expect_rope_equals(&empty, "", 0);
+
+  rope_destroy(&empty);
+  rope_destroy(&copy);
+  rope_destroy(&word);
+}
+
+void test_rope_rejects_bad_arguments(void) {
+  c_string_rope r;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, rope_from_view(literal_view("día"), &r));
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        rope_insert(&r, 4, literal_view("x")));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG, rope_delete(&r, 2, 2));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG, rope_delete(&r, 4, 0));
+  c_string_rope slice;
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG, rope_slice(&r, 1, 3, &slice));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG, rope_concat(&r, NULL));
+
+  const char bad[] = {'a', (char)0xE6, (char)0x9D};
+  c_string_view invalid = {bad, sizeof(bad), 0, false};
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_UTF8, rope_insert(&r, 0, invalid));
+  expect_rope_equals(&r, "día", 4);
+
+  rope_destroy(&r);
+}
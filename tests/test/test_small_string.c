@@ -0,0 +1,85 @@
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+static c_string* make_string(const char* literal) {
+  CStringResult result = string_from_char(literal, (int)strlen(literal));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_NOT_NULL(result.value);
+  return result.value;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_short_strings_live_inside_the_header(void) {
+  c_string* s = make_string("status");
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_STORAGE_INLINE, s->storage);
+  TEST_ASSERT_TRUE(string_data(s) == s->local.inline_data);
+  TEST_ASSERT_TRUE(s->string == s->local.inline_data);
+  TEST_ASSERT_EQUAL_size_t(CSTRING_INLINE_CAPACITY, s->capacity);
+  TEST_ASSERT_EQUAL_MEMORY("status", string_data(s), 6);
+  TEST_ASSERT_TRUE(s->utf8_valid);
+
+  destroy_string(s);
+}
+
+void test_long_strings_use_a_separate_payload(void) {
+  c_string* s = make_string("a payload longer than the inline buffer");
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_STORAGE_HEAP, s->storage);
+  TEST_ASSERT_TRUE(string_data(s) == s->string);
+  TEST_ASSERT_TRUE(s->string != s->local.inline_data);
+
+  destroy_string(s);
+}
+
+void test_append_moves_inline_payload_to_the_heap(void) {
+  c_string* s = make_string("día");
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        string_concat(s, " and a much longer tail ñ"));
+  TEST_ASSERT_EQUAL_INT(CSTRING_STORAGE_HEAP, s->storage);
+  TEST_ASSERT_EQUAL_size_t(30, s->length);
+  TEST_ASSERT_EQUAL_MEMORY("día and a much longer tail ñ", string_data(s),
+                           30);
+  TEST_ASSERT_EQUAL_size_t(28, s->codepoint_length);
+  TEST_ASSERT_TRUE(s->utf8_valid);
+
+  // Dropping back under the limit moves it inline again.
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_modify(s, "short"));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_shrink_to_fit(s));
+  TEST_ASSERT_EQUAL_INT(CSTRING_STORAGE_INLINE, s->storage);
+  TEST_ASSERT_EQUAL_MEMORY("short", string_data(s), 5);
+
+  destroy_string(s);
+}
+
+void test_string_data_survives_copying_the_header(void) {
+  c_string* s = make_string("copy me");
+  c_string copy = *s;
+  destroy_string(s);
+
+  TEST_ASSERT_EQUAL_MEMORY("copy me", string_data(&copy), 7);
+}
+
+void test_split_and_trim_produce_inline_strings(void) {
+  c_string* s = make_string("a,bb,ccc");
+
+  c_string** parts = string_delim(s, ",");
+  TEST_ASSERT_NOT_NULL(parts);
+  TEST_ASSERT_EQUAL_INT(CSTRING_STORAGE_INLINE, parts[1]->storage);
+  TEST_ASSERT_EQUAL_MEMORY("bb", string_data(parts[1]), 2);
+  destroy_delim_string(parts);
+
+  CStringResult trimmed = trim_char(s, ',');
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, trimmed.status);
+  TEST_ASSERT_EQUAL_INT(CSTRING_STORAGE_INLINE, trimmed.value->storage);
+  TEST_ASSERT_EQUAL_MEMORY("abbccc", string_data(trimmed.value), 6);
+  destroy_string(trimmed.value);
+
+  destroy_string(s);
+}
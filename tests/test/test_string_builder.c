@@ -0,0 +1,80 @@
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+static c_string_builder builder;
+
+void setUp(void) {
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_init(&builder, 8));
+}
+
+void tearDown(void) { builder_destroy(&builder); }
+
+void test_builder_appends_and_finishes_without_copying(void) {
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_append_cstr(&builder, "key"));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_append_char(&builder, '='));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_append_bytes(&builder, "día", 4));
+
+  char* buffer = builder.string->string;
+  CStringResult result = builder_finish(&builder);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_TRUE(result.value->string == buffer);
+  TEST_ASSERT_EQUAL_size_t(8, result.value->length);
+  TEST_ASSERT_EQUAL_MEMORY("key=día", result.value->string, 8);
+  TEST_ASSERT_EQUAL_size_t(7, result.value->codepoint_length);
+  TEST_ASSERT_TRUE(result.value->utf8_valid);
+  TEST_ASSERT_NULL(builder.string);
+
+  destroy_string(result.value);
+}
+
+void test_builder_append_printf_fits_in_spare_capacity(void) {
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_append_printf(&builder, "%d", 42));
+  TEST_ASSERT_EQUAL_size_t(2, builder.string->length);
+  TEST_ASSERT_EQUAL_size_t(CSTRING_INLINE_CAPACITY, builder.string->capacity);
+  TEST_ASSERT_EQUAL_MEMORY("42", builder.string->string, 2);
+}
+
+void test_builder_append_printf_grows_when_output_does_not_fit(void) {
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_append_cstr(&builder, "id:"));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_append_printf(&builder,
+                                                          "%s-%05d/%.2f",
+                                                          "request", 17, 0.5));
+
+  const char* expected = "id:request-00017/0.50";
+  TEST_ASSERT_EQUAL_size_t(strlen(expected), builder.string->length);
+  TEST_ASSERT_EQUAL_MEMORY(expected, builder.string->string, strlen(expected));
+  TEST_ASSERT_EQUAL_size_t(strlen(expected), builder.string->codepoint_length);
+}
+
+void test_string_from_printf_formats_once(void) {
+  CStringResult result = string_from_printf("%s=%u", "mañana", 7u);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_EQUAL_MEMORY("mañana=7", result.value->string, 9);
+  TEST_ASSERT_EQUAL_size_t(8, result.value->codepoint_length);
+
+  destroy_string(result.value);
+}
+
+void test_builder_in_arena(void) {
+  c_string_arena arena;
+  c_string_builder arena_builder;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, arena_init(&arena, 0));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, builder_init_in(&arena_builder, &arena, 4));
+
+  for (int i = 0; i < 100; i++) {
+    TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                          builder_append_printf(&arena_builder, "%d,", i));
+  }
+
+  CStringResult result = builder_finish(&arena_builder);
+  TEST_ASSERT_EQUAL_INT(CSTRING_STORAGE_ARENA, result.value->storage);
+  TEST_ASSERT_EQUAL_MEMORY("0,1,2,", result.value->string, 6);
+  TEST_ASSERT_EQUAL_MEMORY("99,",
+                           result.value->string + result.value->length - 3, 3);
+
+  arena_destroy(&arena);
+}
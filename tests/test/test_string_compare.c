@@ -0,0 +1,117 @@
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+static c_string* make_string(const char* literal) {
+  CStringResult result = string_from_char(literal, (int)strlen(literal));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_NOT_NULL(result.value);
+  return result.value;
+}
+
+static int sign(int value) { return (value > 0) - (value < 0); }
+
+void setUp(void) {}
+
+void tearDown(void) { cstring_set_simd_enabled(true); }
+
+void test_compare_lex_orders_like_strcmp(void) {
+  const char* words[] = {"", "a", "ab", "abc", "abd", "b", "ba", "é", "😀"};
+  size_t count = sizeof(words) / sizeof(words[0]);
+
+  for (size_t i = 0; i < count; i++) {
+    c_string* first = make_string(words[i]);
+    for (size_t j = 0; j < count; j++) {
+      c_string* second = make_string(words[j]);
+      TEST_ASSERT_EQUAL_INT(sign(strcmp(words[i], words[j])),
+                            sign(string_compare_lex(first, second)));
+      TEST_ASSERT_EQUAL_INT(i == j, string_equals(first, second));
+      destroy_string(second);
+    }
+    destroy_string(first);
+  }
+
+  // The length-first order is still available
+  c_string* b = make_string("b");
+  c_string* aa = make_string("aa");
+  TEST_ASSERT_TRUE(string_compare(b, aa) < 0);
+  TEST_ASSERT_TRUE(string_compare_lex(b, aa) > 0);
+  destroy_string(aa);
+  destroy_string(b);
+}
+
+void test_starts_with_and_ends_with(void) {
+  c_string* s = make_string("mañana.log");
+
+  TEST_ASSERT_TRUE(string_starts_with(s, "ma"));
+  TEST_ASSERT_TRUE(string_starts_with(s, "mañana.log"));
+  TEST_ASSERT_TRUE(string_starts_with(s, ""));
+  TEST_ASSERT_FALSE(string_starts_with(s, "mañana.log2"));
+  TEST_ASSERT_FALSE(string_starts_with(s, "an"));
+
+  TEST_ASSERT_TRUE(string_ends_with(s, ".log"));
+  TEST_ASSERT_TRUE(string_ends_with(s, ""));
+  TEST_ASSERT_FALSE(string_ends_with(s, ".txt"));
+  TEST_ASSERT_FALSE(string_ends_with(s, "xmañana.log"));
+
+  destroy_string(s);
+}
+
+void test_compare_ignore_case_folds_ascii_only(void) {
+  c_string* upper = make_string("Content-Type: TEXT/Plain; charset=ÜTF-8");
+  c_string* lower = make_string("content-type: text/plain; charset=ÜTF-8");
+  c_string* accented = make_string("content-type: text/plain; charset=ütf-8");
+
+  TEST_ASSERT_EQUAL_INT(0, string_compare_ignore_case(upper, lower));
+  TEST_ASSERT_TRUE(string_equals_ignore_case(upper, lower));
+  // Ü and ü are different bytes; only ASCII is folded
+  TEST_ASSERT_FALSE(string_equals_ignore_case(upper, accented));
+  TEST_ASSERT_TRUE(string_compare_ignore_case(upper, accented) < 0);
+
+  c_string* a = make_string("ABC");
+  c_string* b = make_string("abd");
+  c_string* prefix = make_string("AB");
+  TEST_ASSERT_TRUE(string_compare_ignore_case(a, b) < 0);
+  TEST_ASSERT_TRUE(string_compare_ignore_case(b, a) > 0);
+  TEST_ASSERT_TRUE(string_compare_ignore_case(prefix, a) < 0);
+  // '_' sits between 'Z' and 'a', so folding changes the order
+  c_string* underscore = make_string("_");
+  TEST_ASSERT_TRUE(string_compare_ignore_case(a, underscore) > 0);
+
+  destroy_string(underscore);
+  destroy_string(prefix);
+  destroy_string(b);
+  destroy_string(a);
+  destroy_string(accented);
+  destroy_string(lower);
+  destroy_string(upper);
+}
+
+void test_compare_ignore_case_vector_paths_match_scalar(void) {
+  char first[100];
+  char second[100];
+  for (size_t i = 0; i < sizeof(first); i++) {
+    first[i] = (char)('A' + i % 26);
+    second[i] = (char)('a' + i % 26);
+  }
+
+  // Put a single difference at every position, so each block size and the
+  // tail see it.
+  for (size_t diff = 0; diff < sizeof(first); diff++) {
+    char saved = second[diff];
+    second[diff] = '@';
+    c_string_view a = {first, sizeof(first), sizeof(first), true};
+    c_string_view b = {second, sizeof(second), sizeof(second), true};
+
+    cstring_set_simd_enabled(false);
+    int scalar = view_compare_ignore_case(a, b);
+    cstring_set_simd_enabled(true);
+    int vector = view_compare_ignore_case(a, b);
+
+    TEST_ASSERT_EQUAL_INT(scalar, vector);
+    TEST_ASSERT_TRUE(vector > 0);
+    TEST_ASSERT_FALSE(view_equals_ignore_case(a, b));
+    second[diff] = saved;
+  }
+}
@@ -0,0 +1,127 @@
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+static c_string* make_string(const char* literal) {
+  CStringResult result = string_from_char(literal, (int)strlen(literal));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_NOT_NULL(result.value);
+  return result.value;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_string_concat_grows_capacity_geometrically(void) {
+  c_string* s = make_string("");
+  size_t reallocations = 0;
+  char* last_buffer = s->string;
+
+  for (int i = 0; i < 1000; i++) {
+    TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_concat(s, "ab"));
+    if (s->string != last_buffer) {
+      reallocations += 1;
+      last_buffer = s->string;
+    }
+  }
+
+  TEST_ASSERT_EQUAL_size_t(2000, s->length);
+  TEST_ASSERT_TRUE(s->capacity >= s->length);
+  // Doubling from 16 bytes reaches 2000 in well under 16 steps.
+  TEST_ASSERT_TRUE(reallocations < 16);
+  TEST_ASSERT_EQUAL_MEMORY("abab", s->string + 1996, 4);
+
+  destroy_string(s);
+}
+
+void test_string_concat_updates_utf8_metadata_incrementally(void) {
+  c_string* s = make_string("mañ");
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_concat(s, "ana 🧊"));
+
+  TEST_ASSERT_EQUAL_size_t(strlen("mañana 🧊"), s->length);
+  TEST_ASSERT_EQUAL_size_t(8, s->codepoint_length);
+  TEST_ASSERT_TRUE(s->utf8_valid);
+
+  destroy_string(s);
+}
+
+void test_string_append_tracks_invalid_and_repaired_utf8(void) {
+  c_string* s = make_string("a");
+  const char lead[] = {(char)0xC3};
+  const char continuation[] = {(char)0xB1};
+
+  // Half a code point leaves the string invalid...
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_append(s, lead, 1));
+  TEST_ASSERT_FALSE(s->utf8_valid);
+
+  // ...and the other half completes it again.
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_append(s, continuation, 1));
+  TEST_ASSERT_TRUE(s->utf8_valid);
+  TEST_ASSERT_EQUAL_size_t(2, s->codepoint_length);
+
+  destroy_string(s);
+}
+
+void test_string_concat_rejects_null_input(void) {
+  c_string* s = make_string("abc");
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG, string_concat(s, NULL));
+  TEST_ASSERT_EQUAL_size_t(3, s->length);
+  destroy_string(s);
+}
+
+void test_string_reserve_and_shrink_to_fit(void) {
+  c_string* s = make_string("abc");
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_reserve(s, 128));
+  TEST_ASSERT_EQUAL_size_t(128, s->capacity);
+  char* reserved = s->string;
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        string_concat(s, "defghijklmnopqrstuvwxyz0123"));
+  TEST_ASSERT_TRUE(s->string == reserved);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_shrink_to_fit(s));
+  TEST_ASSERT_EQUAL_size_t(30, s->capacity);
+  TEST_ASSERT_EQUAL_MEMORY("abcdefghijklmnopqrstuvwxyz0123", s->string, 30);
+
+  destroy_string(s);
+}
+
+void test_string_modify_reuses_capacity_and_refreshes_metadata(void) {
+  c_string* s = make_string("a much longer original value");
+  char* original = s->string;
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_modify(s, "día"));
+  TEST_ASSERT_TRUE(s->string == original);
+  TEST_ASSERT_EQUAL_size_t(4, s->length);
+  TEST_ASSERT_EQUAL_size_t(3, s->codepoint_length);
+  TEST_ASSERT_TRUE(s->utf8_valid);
+
+  destroy_string(s);
+}
+
+void test_string_append_to_itself(void) {
+  // Inline until the append moves it to the heap
+  c_string* s = make_string("día 0123456789 abcdef");
+  TEST_ASSERT_EQUAL_INT(CSTRING_STORAGE_INLINE, s->storage);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        string_append(s, string_data(s), s->length));
+  TEST_ASSERT_EQUAL_size_t(44, s->length);
+  TEST_ASSERT_EQUAL_MEMORY("día 0123456789 abcdefdía 0123456789 abcdef",
+                           s->string, 44);
+  TEST_ASSERT_EQUAL_size_t(42, s->codepoint_length);
+  TEST_ASSERT_TRUE(s->utf8_valid);
+
+  // On the heap, where growing reallocates the bytes being appended
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_shrink_to_fit(s));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        string_append(s, string_data(s) + 22, 22));
+  TEST_ASSERT_EQUAL_size_t(66, s->length);
+  TEST_ASSERT_EQUAL_MEMORY("día 0123456789 abcdefdía 0123456789 abcdef"
+                           "día 0123456789 abcdef",
+                           s->string, 66);
+
+  destroy_string(s);
+}
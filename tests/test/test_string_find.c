@@ -0,0 +1,113 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+static c_string* make_string(const char* data, size_t length) {
+  CStringResult result = string_from_char(data, (int)length);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_NOT_NULL(result.value);
+  return result.value;
+}
+
+static size_t naive_find(const char* haystack, size_t length,
+                         const char* needle, size_t needle_length,
+                         size_t from) {
+  if (needle_length == 0) {
+    return CSTRING_NPOS;
+  }
+  for (size_t i = from; i + needle_length <= length; i++) {
+    if (memcmp(haystack + i, needle, needle_length) == 0) {
+      return i;
+    }
+  }
+  return CSTRING_NPOS;
+}
+
+void setUp(void) { cstring_set_simd_enabled(true); }
+
+void tearDown(void) { cstring_set_simd_enabled(true); }
+
+void test_string_find_locates_each_needle_class(void) {
+  const char* text = "the quick brown fox jumps over the lazy dog; the end";
+  c_string* haystack = make_string(text, strlen(text));
+  c_string_needle needle;
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, needle_compile(&needle, ";", 1));
+  TEST_ASSERT_EQUAL_size_t(43, string_find(haystack, &needle, 0));
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, needle_compile(&needle, "the", 3));
+  TEST_ASSERT_EQUAL_size_t(0, string_find(haystack, &needle, 0));
+  TEST_ASSERT_EQUAL_size_t(31, string_find(haystack, &needle, 1));
+  TEST_ASSERT_EQUAL_size_t(45, string_find(haystack, &needle, 32));
+  TEST_ASSERT_EQUAL_size_t(CSTRING_NPOS, string_find(haystack, &needle, 46));
+
+  const char* long_needle = "fox jumps over the lazy dog; the end";
+  TEST_ASSERT_EQUAL_INT(
+      CSTRING_OK, needle_compile(&needle, long_needle, strlen(long_needle)));
+  TEST_ASSERT_EQUAL_size_t(16, string_find(haystack, &needle, 0));
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, needle_compile(&needle, "", 0));
+  TEST_ASSERT_EQUAL_size_t(CSTRING_NPOS, string_find(haystack, &needle, 0));
+
+  destroy_string(haystack);
+}
+
+void test_string_find_all_counts_non_overlapping_matches(void) {
+  c_string* haystack = make_string("aaaaa,b,,c", 10);
+  c_string_needle needle;
+  size_t positions[8];
+
+  needle_compile(&needle, "aa", 2);
+  TEST_ASSERT_EQUAL_size_t(2,
+                           string_find_all(haystack, &needle, positions, 8));
+  TEST_ASSERT_EQUAL_size_t(0, positions[0]);
+  TEST_ASSERT_EQUAL_size_t(2, positions[1]);
+
+  needle_compile(&needle, ",", 1);
+  TEST_ASSERT_EQUAL_size_t(3, string_find_all(haystack, &needle, NULL, 0));
+  TEST_ASSERT_EQUAL_size_t(3,
+                           string_find_all(haystack, &needle, positions, 1));
+  TEST_ASSERT_EQUAL_size_t(5, positions[0]);
+
+  destroy_string(haystack);
+}
+
+void test_string_find_matches_naive_search_on_random_input(void) {
+  char text[300];
+  char pattern[48];
+  uint32_t seed = 0xC0FFEEu;
+
+  for (int round = 0; round < 3000; round++) {
+    // A three letter alphabet produces plenty of near-misses.
+    size_t length = (size_t)(round % (int)sizeof(text));
+    for (size_t i = 0; i < length; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      text[i] = (char)('a' + (seed >> 24) % 3);
+    }
+    size_t needle_length = 1 + (size_t)round % sizeof(pattern);
+    for (size_t i = 0; i < needle_length; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      pattern[i] = (char)('a' + (seed >> 24) % 3);
+    }
+    // Plant the pattern somewhere so long needles are found as well.
+    if (length > needle_length && round % 2 == 0) {
+      memcpy(text + (seed % (length - needle_length)), pattern, needle_length);
+    }
+
+    c_string_view haystack = {.data = text,
+                              .length = length,
+                              .codepoint_length = length,
+                              .utf8_valid = true};
+    c_string_needle needle;
+    needle_compile(&needle, pattern, needle_length);
+    size_t from = length > 0 ? (size_t)round % (length / 4 + 1) : 0;
+    size_t expected = naive_find(text, length, pattern, needle_length, from);
+
+    cstring_set_simd_enabled(false);
+    TEST_ASSERT_EQUAL_size_t(expected, view_find(haystack, &needle, from));
+    cstring_set_simd_enabled(true);
+    TEST_ASSERT_EQUAL_size_t(expected, view_find(haystack, &needle, from));
+  }
+}
@@ -0,0 +1,166 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+#define KEY_COUNT 5000
+
+static c_string_view literal_view(const char* literal) {
+  c_string_view view;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        view_from_char(literal, strlen(literal), &view));
+  return view;
+}
+
+// "key-<n>" in `buffer`
+static c_string_view numbered_key(char* buffer, size_t n) {
+  memcpy(buffer, "key-", 4);
+  size_t length = 4 + format_uint64(n, buffer + 4);
+  c_string_view view = {buffer, length, length, true};
+  return view;
+}
+
+void setUp(void) {}
+
+void tearDown(void) { cstring_set_simd_enabled(true); }
+
+void test_hash_matches_reference_vectors(void) {
+  // From the wyhash test vectors (seed = index)
+  TEST_ASSERT_EQUAL_UINT64(UINT64_C(0x93228a4de0eec5a2),
+                           cstring_hash("", 0, 0));
+  TEST_ASSERT_EQUAL_UINT64(UINT64_C(0xc5bac3db178713c4),
+                           cstring_hash("a", 1, 1));
+  TEST_ASSERT_EQUAL_UINT64(UINT64_C(0xa97f2f7b1d9b3314),
+                           cstring_hash("abc", 3, 2));
+  TEST_ASSERT_EQUAL_UINT64(UINT64_C(0x786d1f1df3801df4),
+                           cstring_hash("message digest", 14, 3));
+}
+
+void test_hash_depends_on_bytes_and_seed_only(void) {
+  const char* text = "a key long enough to take the 48-byte loop, twice over";
+  CStringResult s = string_from_char(text, (int)strlen(text));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, s.status);
+
+  TEST_ASSERT_EQUAL_UINT64(string_hash(s.value, 7),
+                           view_hash(literal_view(text), 7));
+  TEST_ASSERT_TRUE(string_hash(s.value, 7) != string_hash(s.value, 8));
+
+  c_string_view shorter = literal_view(text);
+  shorter.length -= 1;
+  TEST_ASSERT_TRUE(view_hash(shorter, 7) != string_hash(s.value, 7));
+
+  destroy_string(s.value);
+}
+
+void test_map_put_get_replace_and_remove(void) {
+  c_string_map map;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_map_init(&map, 0));
+
+  int one = 1;
+  int two = 2;
+  void* value = NULL;
+  TEST_ASSERT_FALSE(string_map_get(&map, literal_view("missing"), &value));
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        string_map_put(&map, literal_view("día"), &one));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        string_map_put(&map, literal_view(""), &two));
+  TEST_ASSERT_TRUE(string_map_get(&map, literal_view("día"), &value));
+  TEST_ASSERT_TRUE(value == &one);
+  TEST_ASSERT_TRUE(string_map_get(&map, literal_view(""), &value));
+  TEST_ASSERT_TRUE(value == &two);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        string_map_put(&map, literal_view("día"), &two));
+  TEST_ASSERT_EQUAL_size_t(2, map.count);
+  TEST_ASSERT_TRUE(string_map_get(&map, literal_view("día"), &value));
+  TEST_ASSERT_TRUE(value == &two);
+
+  TEST_ASSERT_TRUE(string_map_remove(&map, literal_view("día"), &value));
+  TEST_ASSERT_TRUE(value == &two);
+  TEST_ASSERT_FALSE(string_map_get(&map, literal_view("día"), NULL));
+  TEST_ASSERT_FALSE(string_map_remove(&map, literal_view("día"), NULL));
+  TEST_ASSERT_EQUAL_size_t(1, map.count);
+
+  string_map_destroy(&map);
+}
+
+void test_map_accepts_binary_keys(void) {
+  c_string_map map;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_map_init(&map, 0));
+
+  const char bytes[] = {'k', (char)0xC3, '\0', (char)0xFF};
+  c_string_view binary = {bytes, sizeof(bytes), 0, false};
+  int one = 1;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_map_put(&map, binary, &one));
+
+  void* value = NULL;
+  TEST_ASSERT_TRUE(string_map_get(&map, binary, &value));
+  TEST_ASSERT_TRUE(value == &one);
+
+  size_t cursor = 0;
+  const c_string* key = NULL;
+  TEST_ASSERT_TRUE(string_map_next(&map, &cursor, &key, NULL));
+  TEST_ASSERT_EQUAL_size_t(sizeof(bytes), key->length);
+  TEST_ASSERT_EQUAL_MEMORY(bytes, string_data(key), sizeof(bytes));
+  TEST_ASSERT_FALSE(key->utf8_valid);
+
+  TEST_ASSERT_TRUE(string_map_remove(&map, binary, NULL));
+  TEST_ASSERT_EQUAL_size_t(0, map.count);
+  string_map_destroy(&map);
+}
+
+void test_map_grows_and_survives_churn(void) {
+  for (int simd = 0; simd <= 1; simd++) {
+    cstring_set_simd_enabled(simd == 1);
+
+    c_string_map map;
+    TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_map_init(&map, 10));
+    char buffer[32];
+
+    for (size_t i = 0; i < KEY_COUNT; i++) {
+      TEST_ASSERT_EQUAL_INT(
+          CSTRING_OK,
+          string_map_put(&map, numbered_key(buffer, i), (void*)(uintptr_t)i));
+    }
+    TEST_ASSERT_EQUAL_size_t(KEY_COUNT, map.count);
+
+    // Remove the odd keys and reinsert half of them, leaving tombstones
+    for (size_t i = 1; i < KEY_COUNT; i += 2) {
+      TEST_ASSERT_TRUE(string_map_remove(&map, numbered_key(buffer, i), NULL));
+    }
+    for (size_t i = 1; i < KEY_COUNT; i += 4) {
+      TEST_ASSERT_EQUAL_INT(
+          CSTRING_OK,
+          string_map_put(&map, numbered_key(buffer, i), (void*)(uintptr_t)i));
+    }
+
+    for (size_t i = 0; i < KEY_COUNT; i++) {
+      void* value = NULL;
+      bool expected = i % 2 == 0 || i % 4 == 1;
+      TEST_ASSERT_EQUAL_INT(
+          expected, string_map_get(&map, numbered_key(buffer, i), &value));
+      if (expected) {
+        TEST_ASSERT_EQUAL_size_t(i, (size_t)(uintptr_t)value);
+      }
+    }
+
+    size_t cursor = 0;
+    size_t visited = 0;
+    const c_string* key = NULL;
+    void* value = NULL;
+    while (string_map_next(&map, &cursor, &key, &value)) {
+      c_string_view digits = string_view(key);
+      digits.data += 4;
+      digits.length -= 4;
+      uint64_t n = 0;
+      TEST_ASSERT_EQUAL_INT(CSTRING_OK, view_to_uint64(digits, &n));
+      TEST_ASSERT_EQUAL_UINT64(n, (uint64_t)(uintptr_t)value);
+      visited += 1;
+    }
+    TEST_ASSERT_EQUAL_size_t(map.count, visited);
+
+    string_map_destroy(&map);
+  }
+}
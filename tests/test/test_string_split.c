@@ -0,0 +1,112 @@
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+static c_string* make_string(const char* literal) {
+  CStringResult result = string_from_char(literal, (int)strlen(literal));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_NOT_NULL(result.value);
+  return result.value;
+}
+
+// string_split must produce the same tokens, with the same metadata, as
+// string_delim.
+static void expect_split_matches_string_delim(const char* input,
+                                              const char* delim) {
+  c_string* s = make_string(input);
+  c_string** pieces = string_delim(s, delim);
+  TEST_ASSERT_NOT_NULL(pieces);
+
+  c_string_split split;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_split(s, delim, &split));
+
+  size_t count = 0;
+  while (pieces[count]) {
+    count += 1;
+  }
+  TEST_ASSERT_EQUAL_size_t(count, split.count);
+
+  for (size_t i = 0; i < split.count; i++) {
+    c_string_view token = split_get(&split, i);
+    TEST_ASSERT_EQUAL_size_t(pieces[i]->length, token.length);
+    TEST_ASSERT_EQUAL_MEMORY(pieces[i]->string, token.data, token.length);
+    TEST_ASSERT_EQUAL_size_t(pieces[i]->codepoint_length,
+                             token.codepoint_length);
+    TEST_ASSERT_TRUE(token.utf8_valid);
+  }
+
+  split_destroy(&split);
+  destroy_delim_string(pieces);
+  destroy_string(s);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_split_matches_string_delim(void) {
+  expect_split_matches_string_delim("Hello,World,UTF-8", ",");
+  expect_split_matches_string_delim(",a,,b,", ",");
+  expect_split_matches_string_delim("mañana::día::", "::");
+  expect_split_matches_string_delim("aaaa", "aa");
+  expect_split_matches_string_delim("aaa", "aa");
+  expect_split_matches_string_delim("abc", "abc");
+  expect_split_matches_string_delim("abc", "abcd");
+  expect_split_matches_string_delim("no delimiter here", ";");
+  expect_split_matches_string_delim("a b", "");
+  expect_split_matches_string_delim("", ",");
+}
+
+void test_split_owns_a_copy_of_the_source(void) {
+  c_string* s = make_string("key=value;other=thing");
+  c_string_split split;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, string_split(s, ";", &split));
+  TEST_ASSERT_TRUE(split.data != s->string);
+  destroy_string(s);
+
+  TEST_ASSERT_EQUAL_size_t(2, split.count);
+  c_string_view second = split_get(&split, 1);
+  TEST_ASSERT_EQUAL_size_t(11, second.length);
+  TEST_ASSERT_EQUAL_MEMORY("other=thing", second.data, second.length);
+  TEST_ASSERT_EQUAL_size_t(10, split.spans[1].offset);
+
+  split_destroy(&split);
+  TEST_ASSERT_NULL(split.spans);
+  TEST_ASSERT_EQUAL_size_t(0, split.count);
+}
+
+void test_view_split_borrows_the_source(void) {
+  const char input[] = "ñ|é|";
+  c_string_view v;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        view_from_char(input, sizeof(input) - 1, &v));
+
+  c_string_split split;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, view_split(v, "|", &split));
+  TEST_ASSERT_TRUE(split.data == input);
+  TEST_ASSERT_TRUE(split.known_valid);
+  TEST_ASSERT_FALSE(split.ascii);
+  TEST_ASSERT_EQUAL_size_t(3, split.count);
+
+  c_string_view token = split_get(&split, 1);
+  TEST_ASSERT_TRUE(token.data == input + 3);
+  TEST_ASSERT_EQUAL_size_t(2, token.length);
+  TEST_ASSERT_EQUAL_size_t(1, token.codepoint_length);
+  TEST_ASSERT_EQUAL_size_t(0, split_get(&split, 2).length);
+
+  // Out of range indices give an empty view
+  TEST_ASSERT_NULL(split_get(&split, 3).data);
+
+  split_destroy(&split);
+}
+
+void test_split_rejects_bad_arguments(void) {
+  c_string* s = make_string("a,b");
+  c_string_split split;
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        string_split(NULL, ",", &split));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG, string_split(s, NULL, &split));
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG, string_split(s, ",", NULL));
+  destroy_string(s);
+}
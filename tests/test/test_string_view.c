@@ -0,0 +1,169 @@
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+static c_string_view make_view(const char* literal) {
+  c_string_view view;
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        view_from_char(literal, strlen(literal), &view));
+  return view;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_string_view_shares_bytes_and_metadata(void) {
+  const char* literal = "héł🧊";
+  CStringResult s = string_from_char(literal, (int)strlen(literal));
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, s.status);
+
+  c_string_view view = string_view(s.value);
+  TEST_ASSERT_TRUE(view.data == s.value->string);
+  TEST_ASSERT_EQUAL_size_t(s.value->length, view.length);
+  TEST_ASSERT_EQUAL_size_t(4, view.codepoint_length);
+  TEST_ASSERT_TRUE(view.utf8_valid);
+
+  destroy_string(s.value);
+}
+
+void test_view_from_char_rejects_invalid_utf8(void) {
+  const char payload[] = {(char)0xC3, (char)0x28};
+  c_string_view view;
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_UTF8,
+                        view_from_char(payload, sizeof(payload), &view));
+}
+
+void test_view_sub_string_checked_points_into_source(void) {
+  const char* literal = "Hello,World";
+  c_string_view source = make_view(literal);
+  c_string_view slice;
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        view_sub_string_checked(source, 6, 10, &slice));
+  TEST_ASSERT_TRUE(slice.data == literal + 6);
+  TEST_ASSERT_EQUAL_size_t(5, slice.length);
+  TEST_ASSERT_EQUAL_size_t(5, slice.codepoint_length);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_ARG,
+                        view_sub_string_checked(source, 3, 11, &slice));
+}
+
+void test_view_sub_string_checked_rejects_split_codepoint(void) {
+  c_string_view source = make_view("añb");
+  c_string_view slice;
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_UTF8,
+                        view_sub_string_checked(source, 0, 1, &slice));
+}
+
+void test_view_sub_string_codepoint_selects_multibyte_range(void) {
+  const char* literal = "héł🧊x";
+  c_string_view source = make_view(literal);
+  c_string_view slice;
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK,
+                        view_sub_string_codepoint(source, 1, 3, &slice));
+  TEST_ASSERT_TRUE(slice.data == literal + 1);
+  TEST_ASSERT_EQUAL_size_t(8, slice.length);
+  TEST_ASSERT_EQUAL_size_t(3, slice.codepoint_length);
+  TEST_ASSERT_EQUAL_MEMORY("éł🧊", slice.data, slice.length);
+}
+
+void test_view_split_once_walks_tokens(void) {
+  c_string_view rest = make_view("añ,,b");
+  c_string_view head;
+
+  TEST_ASSERT_TRUE(view_split_once(rest, ",", &head, &rest));
+  TEST_ASSERT_EQUAL_MEMORY("añ", head.data, 3);
+  TEST_ASSERT_EQUAL_size_t(2, head.codepoint_length);
+
+  TEST_ASSERT_TRUE(view_split_once(rest, ",", &head, &rest));
+  TEST_ASSERT_EQUAL_size_t(0, head.length);
+
+  TEST_ASSERT_FALSE(view_split_once(rest, ",", &head, &rest));
+  TEST_ASSERT_EQUAL_MEMORY("b", head.data, 1);
+  TEST_ASSERT_EQUAL_size_t(0, rest.length);
+}
+
+void test_view_strip_char_trims_both_ends(void) {
+  c_string_view source = make_view("--mañana--");
+  c_string_view stripped = view_strip_char(source, '-');
+
+  TEST_ASSERT_EQUAL_size_t(7, stripped.length);
+  TEST_ASSERT_EQUAL_size_t(6, stripped.codepoint_length);
+  TEST_ASSERT_EQUAL_MEMORY("mañana", stripped.data, stripped.length);
+
+  c_string_view all = view_strip_char(make_view("----"), '-');
+  TEST_ASSERT_EQUAL_size_t(0, all.length);
+}
+
+void test_view_strip_bytes_trims_the_requested_sides(void) {
+  c_string_view source = make_view(" \t;mañana; \n");
+
+  c_string_view both = view_strip_bytes(source, " \t\n;", CSTRING_STRIP_BOTH);
+  TEST_ASSERT_EQUAL_size_t(7, both.length);
+  TEST_ASSERT_EQUAL_size_t(6, both.codepoint_length);
+  TEST_ASSERT_TRUE(both.data == source.data + 3);
+
+  c_string_view left = view_strip_bytes(source, " \t;", CSTRING_STRIP_LEFT);
+  TEST_ASSERT_EQUAL_MEMORY("mañana; \n", left.data, left.length);
+
+  c_string_view right = view_strip_bytes(source, " \n", CSTRING_STRIP_RIGHT);
+  TEST_ASSERT_EQUAL_MEMORY(" \t;mañana;", right.data, right.length);
+  TEST_ASSERT_EQUAL_size_t(source.codepoint_length - 2,
+                           right.codepoint_length);
+
+  c_string_view none = view_strip_bytes(source, "", CSTRING_STRIP_BOTH);
+  TEST_ASSERT_EQUAL_size_t(source.length, none.length);
+}
+
+void test_view_strip_whitespace_removes_unicode_spaces(void) {
+  // U+3000 IDEOGRAPHIC SPACE, U+00A0 NO-BREAK SPACE and U+2009 THIN SPACE
+  c_string_view source = make_view("\xE3\x80\x80 \xC2\xA0"
+                                   "día\xE2\x80\x89\r\n");
+
+  c_string_view both = view_strip_whitespace(source, CSTRING_STRIP_BOTH);
+  TEST_ASSERT_EQUAL_MEMORY("día", both.data, both.length);
+  TEST_ASSERT_EQUAL_size_t(4, both.length);
+  TEST_ASSERT_EQUAL_size_t(3, both.codepoint_length);
+  TEST_ASSERT_TRUE(both.utf8_valid);
+
+  c_string_view right = view_strip_whitespace(source, CSTRING_STRIP_RIGHT);
+  TEST_ASSERT_TRUE(right.data == source.data);
+  TEST_ASSERT_EQUAL_size_t(10, right.length);
+  TEST_ASSERT_EQUAL_size_t(6, right.codepoint_length);
+
+  // Non-whitespace that shares a lead byte with U+2009 is kept
+  c_string_view dash = make_view("\xE2\x80\x94");
+  TEST_ASSERT_EQUAL_size_t(
+      3, view_strip_whitespace(dash, CSTRING_STRIP_BOTH).length);
+
+  c_string_view blank = make_view(" \xC2\x85\t");
+  TEST_ASSERT_EQUAL_size_t(
+      0, view_strip_whitespace(blank, CSTRING_STRIP_BOTH).length);
+}
+
+void test_view_compare_matches_string_compare(void) {
+  c_string_view abc = make_view("abc");
+  c_string_view abd = make_view("abd");
+  c_string_view ab = make_view("ab");
+
+  TEST_ASSERT_TRUE(view_compare(abc, abd) < 0);
+  TEST_ASSERT_TRUE(view_compare(abc, ab) > 0);
+  TEST_ASSERT_TRUE(view_equals(abc, make_view("abc")));
+  TEST_ASSERT_FALSE(view_equals(abc, abd));
+}
+
+void test_string_from_view_copies_without_revalidating(void) {
+  c_string_view source = make_view("mañana");
+  CStringResult copy = string_from_view(source);
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, copy.status);
+  TEST_ASSERT_TRUE(copy.value->string != source.data);
+  TEST_ASSERT_EQUAL_size_t(source.length, copy.value->length);
+  TEST_ASSERT_EQUAL_size_t(6, copy.value->codepoint_length);
+  TEST_ASSERT_TRUE(copy.value->utf8_valid);
+
+  destroy_string(copy.value);
+}
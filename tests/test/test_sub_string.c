@@ -128,3 +128,61 @@ void test_sub_string_codepoint_full_span_returns_original_bytes(void) {
   destroy_string(slice.value);
   destroy_string(source);
 }
+
+void test_sub_string_checked_only_cuts_on_codepoint_boundaries(void) {
+  // "añb€c": ñ is two bytes, € three
+  const char literal[] = "a\xC3\xB1"
+                         "b\xE2\x82\xAC"
+                         "c";
+  c_string* s = make_string(literal, (int)(sizeof(literal) - 1));
+
+  CStringResult slice = sub_string_checked(s, 1, 6);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, slice.status);
+  TEST_ASSERT_TRUE(slice.value->utf8_valid);
+  TEST_ASSERT_EQUAL_size_t(3, slice.value->codepoint_length);
+  destroy_string(slice.value);
+
+  // Starting on a continuation byte or ending before one is rejected
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_UTF8,
+                        sub_string_checked(s, 2, 3).status);
+  TEST_ASSERT_EQUAL_INT(CSTRING_ERR_INVALID_UTF8,
+                        sub_string_checked(s, 0, 4).status);
+
+  destroy_string(s);
+}
+
+void test_derived_strings_count_codepoints_like_a_full_scan(void) {
+  // Long enough for the vector paths, with sequences straddling 16 and 32
+  // byte blocks
+  char literal[200];
+  size_t length = 0;
+  while (length + 3 <= sizeof(literal)) {
+    memcpy(literal + length, length % 7 ? "x" : "\xE2\x82\xAC",
+           length % 7 ? 1 : 3);
+    length += length % 7 ? 1 : 3;
+  }
+  c_string* s = make_string(literal, (int)length);
+
+  for (size_t start = 0; start < 40; start++) {
+    CStringResult slice = sub_string_checked(s, start, length - 1);
+    if (slice.status != CSTRING_OK) {
+      continue;
+    }
+    CStringResult scanned =
+        string_from_char(slice.value->string, (int)slice.value->length);
+    TEST_ASSERT_EQUAL_INT(CSTRING_OK, scanned.status);
+    TEST_ASSERT_EQUAL_size_t(scanned.value->codepoint_length,
+                             slice.value->codepoint_length);
+
+    CStringResult copy = string_new(slice.value);
+    TEST_ASSERT_EQUAL_size_t(scanned.value->codepoint_length,
+                             copy.value->codepoint_length);
+    TEST_ASSERT_TRUE(copy.value->utf8_valid);
+
+    destroy_string(copy.value);
+    destroy_string(scanned.value);
+    destroy_string(slice.value);
+  }
+
+  destroy_string(s);
+}
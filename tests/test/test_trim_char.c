@@ -80,3 +80,48 @@ void test_trim_char_collapsed_runs(void) {
   destroy_string(trimmed.value);
   destroy_string(input);
 }
+
+void test_trim_char_carries_utf8_metadata(void) {
+  c_string* input = make_string("-mañana-día-");
+  CStringResult trimmed = trim_char(input, '-');
+
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, trimmed.status);
+  TEST_ASSERT_TRUE(trimmed.value->utf8_valid);
+  TEST_ASSERT_EQUAL_size_t(input->codepoint_length - 3,
+                           trimmed.value->codepoint_length);
+
+  destroy_string(trimmed.value);
+  destroy_string(input);
+}
+
+void test_trim_char_vector_paths_match_scalar(void) {
+  // Matches scattered across 16 and 32 byte blocks, including whole blocks
+  // of matches and blocks with none
+  char literal[300];
+  for (size_t i = 0; i < sizeof(literal); i++) {
+    bool match = i % 5 == 0 || (i >= 64 && i < 96);
+    literal[i] = match ? '-' : (char)('a' + i % 26);
+  }
+  memset(literal + 160, 'z', 40);
+
+  for (size_t length = 0; length <= sizeof(literal); length += 7) {
+    CStringResult input = string_from_char(literal, (int)length);
+    TEST_ASSERT_EQUAL_INT(CSTRING_OK, input.status);
+
+    cstring_set_simd_enabled(false);
+    CStringResult scalar = trim_char(input.value, '-');
+    cstring_set_simd_enabled(true);
+    CStringResult vector = trim_char(input.value, '-');
+
+    TEST_ASSERT_EQUAL_INT(CSTRING_OK, vector.status);
+    TEST_ASSERT_EQUAL_size_t(scalar.value->length, vector.value->length);
+    TEST_ASSERT_EQUAL_MEMORY(string_data(scalar.value),
+                             string_data(vector.value), vector.value->length);
+    TEST_ASSERT_EQUAL_size_t(vector.value->length,
+                             vector.value->codepoint_length);
+
+    destroy_string(vector.value);
+    destroy_string(scalar.value);
+    destroy_string(input.value);
+  }
+}
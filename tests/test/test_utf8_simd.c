@@ -0,0 +1,124 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "c_string.h"
+#include "unity.h"
+
+// Ceedling runs the suite from tests/, so the corpus sits one level up.
+#define UTF8_CORPUS_DIR "../fuzz/corpus/utf8/"
+
+static const char* corpus_files[] = {
+    "ascii_csv",          "invalid_overlong.bin", "invalid_surrogate.bin",
+    "invalid_truncated.bin", "long_korean.txt",   "mixed_runs.txt",
+    "repeat_emoji.txt",   "valid_boundary.bin",   "valid_mixed.txt",
+    "valid_seed.txt",
+};
+
+void setUp(void) { cstring_set_simd_enabled(true); }
+
+void tearDown(void) { cstring_set_simd_enabled(true); }
+
+static CStringResult analyze(const char* data, size_t length, bool simd) {
+  cstring_set_simd_enabled(simd);
+  CStringResult result = string_from_char(data, (int)length);
+  cstring_set_simd_enabled(true);
+  return result;
+}
+
+// Compare the scalar and vectorized answers for one buffer.
+static void expect_paths_agree(const char* data, size_t length) {
+  CStringResult scalar = analyze(data, length, false);
+  CStringResult simd = analyze(data, length, true);
+
+  TEST_ASSERT_EQUAL_INT(scalar.status, simd.status);
+  if (scalar.status == CSTRING_OK) {
+    TEST_ASSERT_EQUAL_size_t(scalar.value->codepoint_length,
+                             simd.value->codepoint_length);
+    TEST_ASSERT_EQUAL(scalar.value->utf8_valid, simd.value->utf8_valid);
+    destroy_string(scalar.value);
+    destroy_string(simd.value);
+  }
+}
+
+static size_t read_corpus_file(const char* name, char* buffer,
+                               size_t capacity) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s%s", UTF8_CORPUS_DIR, name);
+  FILE* fp = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(fp, path);
+  size_t bytes = fread(buffer, 1, capacity, fp);
+  fclose(fp);
+  return bytes;
+}
+
+void test_simd_matches_scalar_on_utf8_corpus(void) {
+  char buffer[4096];
+  size_t count = sizeof(corpus_files) / sizeof(corpus_files[0]);
+
+  for (size_t f = 0; f < count; f++) {
+    size_t length = read_corpus_file(corpus_files[f], buffer, sizeof(buffer));
+    expect_paths_agree(buffer, length);
+
+    // Every prefix moves the truncation point across the 16 and 32 byte block
+    // boundaries the vector paths use.
+    for (size_t prefix = 0; prefix < length; prefix++) {
+      expect_paths_agree(buffer, prefix);
+    }
+  }
+}
+
+void test_simd_matches_scalar_when_corpus_is_repeated(void) {
+  char buffer[4096];
+  char repeated[8192];
+  size_t count = sizeof(corpus_files) / sizeof(corpus_files[0]);
+
+  for (size_t f = 0; f < count; f++) {
+    size_t length = read_corpus_file(corpus_files[f], buffer, sizeof(buffer));
+    size_t total = 0;
+    // Shift the seed across block boundaries by prefixing ASCII padding.
+    for (size_t pad = 0; pad < 33; pad++) {
+      memset(repeated, 'a', pad);
+      total = pad;
+      while (total + length <= sizeof(repeated) / 4) {
+        memcpy(repeated + total, buffer, length);
+        total += length;
+      }
+      expect_paths_agree(repeated, total);
+    }
+  }
+}
+
+void test_simd_matches_scalar_on_random_bytes(void) {
+  // Bytes drawn from a small alphabet of lead, continuation and ASCII values
+  // hit far more valid multi-byte sequences than uniform noise would.
+  static const unsigned char alphabet[] = {
+      0x41, 0x7F, 0x80, 0x8F, 0x90, 0x9F, 0xA0, 0xBF, 0xC0, 0xC2,
+      0xDF, 0xE0, 0xE1, 0xED, 0xEF, 0xF0, 0xF1, 0xF4, 0xF5, 0xFF};
+  uint32_t seed = 0x12345678u;
+  char buffer[97];
+
+  for (int round = 0; round < 20000; round++) {
+    size_t length = (size_t)(round % (int)sizeof(buffer));
+    for (size_t i = 0; i < length; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      buffer[i] = (char)alphabet[(seed >> 24) % sizeof(alphabet)];
+    }
+    expect_paths_agree(buffer, length);
+  }
+}
+
+void test_simd_counts_long_valid_utf8(void) {
+  const char* unit = "añ€🧊";  // 1 + 2 + 3 + 4 bytes, 4 code points
+  char buffer[1000];
+  size_t length = 0;
+  while (length + 10 <= sizeof(buffer)) {
+    memcpy(buffer + length, unit, 10);
+    length += 10;
+  }
+
+  CStringResult result = string_from_char(buffer, (int)length);
+  TEST_ASSERT_EQUAL_INT(CSTRING_OK, result.status);
+  TEST_ASSERT_EQUAL_size_t(length / 10 * 4, result.value->codepoint_length);
+  destroy_string(result.value);
+}